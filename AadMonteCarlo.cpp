@@ -0,0 +1,245 @@
+#include "FinanceMonteCarlo.h"
+#include "AadTape.h"
+#include "McProfile.h"
+#include "McStatistics.h"
+#include "PathEngine.h"
+#include "VolSurface.h"
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Per-block sums over sampling units of the discounted payoff and of its
+// derivative in each input
+enum AadSum {
+    kValue,
+    kValueSq,
+    kDelta,         // d/dS
+    kDeltaSq,
+    kVega,          // d/dv
+    kVegaSq,
+    kRho,           // d/dr
+    kRhoSq,
+    kDVdT,          // d/dT
+    kDVdTSq,
+    kNumAadSums
+};
+
+typedef std::array<double, kNumAadSums> AadSums;
+
+// The inputs as tape leaves and what the paths need from them, recorded
+// once at the start of each block
+struct AadModel {
+    AadNumber S, v, r, T;
+    AadNumber drift;        // per step, in log-spot
+    AadNumber diffusion;    // per step and unit normal
+    AadNumber df;
+};
+
+AadModel record_model(const OptionParams& p) {
+    AadModel m;
+    m.S = AadNumber::input(p.S);
+    m.v = AadNumber::input(p.v);
+    m.r = AadNumber::input(p.r);
+    m.T = AadNumber::input(p.T);
+    AadNumber dt = m.T / AadNumber(p.numSteps);
+    m.drift = (m.r - 0.5 * m.v * m.v) * dt;
+    m.diffusion = m.v * sqrt(dt);
+    m.df = exp(-(m.r * m.T));
+    return m;
+}
+
+// Records the path driven by z[k * tile], k < steps, with the normals
+// negated for the antithetic mirror, and returns its undiscounted payoff.
+// One node per step for the log-spot and at most one for the accumulator;
+// running extremes just point at the step that set them.
+AadNumber record_path(const PathPayoff& payoff, const AadModel& m, const double* z, size_t tile,
+                      double sign, AadTape& tape) {
+    const double drift = m.drift.value();
+    const double diffusion = m.diffusion.value();
+    double x = 0.0, acc = 0.0;
+    AadNode* xNode = nullptr;
+    AadNode* accNode = nullptr;
+    for (int k = 0; k < payoff.steps; ++k) {
+        double zk = sign * z[static_cast<size_t>(k) * tile];
+        x = (x + drift) + diffusion * zk;
+        xNode = tape.record(xNode, 1.0, m.drift.node(), 1.0, m.diffusion.node(), zk);
+        switch (payoff.accumulator) {
+        case kSumSpot: {
+            double e = std::exp(x);
+            acc += e;
+            accNode = tape.record(accNode, 1.0, xNode, e);
+            break;
+        }
+        case kSumLog:
+            acc += x;
+            accNode = tape.record(accNode, 1.0, xNode, 1.0);
+            break;
+        case kRunningMax:
+            if (x > acc) {
+                acc = x;
+                accNode = xNode;
+            }
+            break;
+        case kRunningMin:
+            if (x < acc) {
+                acc = x;
+                accNode = xNode;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    double dx, dacc, dS;
+    double y = payoff.gradient(x, acc, &dx, &dacc, &dS);
+    return AadNumber(y, tape.record(xNode, dx, accNode, dacc, m.S.node(), dS));
+}
+
+inline void add(AadSums& sums, AadSum slot, double value) {
+    sums[slot] += value;
+    sums[slot + 1] += value * value;
+}
+
+// Sums of units [first, first + units). The tape is cleared for the block;
+// each unit is recorded, swept back to the inputs and rewound, so the tape
+// never holds more than one unit's paths. vol_slope is dv/dT along the
+// vol's source (0 for a flat vol), carried into each unit's dV/dT.
+AadSums aad_block_sums(const OptionParams& p, const PathPayoff& payoff, bool antithetic,
+                       double vol_slope, const CounterRng& rng, long long first, long long units,
+                       size_t tile, std::vector<double>& z, PhaseClock& clock) {
+    AadTape& tape = aad_tape();
+    tape.clear();
+    const AadTape::Mark begin = tape.mark();
+    const AadModel m = record_model(p);
+    const AadTape::Mark paths = tape.mark();
+    AadSums sums{};
+
+    for (long long t = 0; t < units; t += tile) {
+        clock.restart();
+        // Dimension k of unit i uses normal i of stream k, as in the path engine
+        for (int k = 0; k < p.numSteps; ++k) {
+            rng.normals(static_cast<uint32_t>(k), first + t, &z[static_cast<size_t>(k) * tile], tile);
+        }
+        clock.lap(kPhaseRng);
+
+        const long long live = std::min(static_cast<long long>(tile), units - t);
+        for (long long i = 0; i < live; ++i) {
+            AadNumber y = record_path(payoff, m, &z[i], tile, 1.0, tape);
+            if (antithetic) {
+                y = 0.5 * (y + record_path(payoff, m, &z[i], tile, -1.0, tape));
+            }
+            AadNumber value = m.df * y;
+            tape.propagate(value.node(), begin);
+            add(sums, kValue, value.value());
+            add(sums, kDelta, m.S.adjoint());
+            add(sums, kVega, m.v.adjoint());
+            add(sums, kRho, m.r.adjoint());
+            add(sums, kDVdT, m.T.adjoint() + vol_slope * m.v.adjoint());
+            tape.rewind(paths);
+            tape.zero_adjoints(begin);
+        }
+        clock.lap(kPhasePaths);
+    }
+    clock.count_block(units * (antithetic ? 2 : 1));
+    return sums;
+}
+
+McAadResult run_aad(const OptionParams& p, double vol_slope, const McOptions& opts,
+                    const CounterRng& rng, int num_threads) {
+    if (p.numSteps < 1) {
+        throw std::invalid_argument("price_path_aad: numSteps must be at least 1");
+    }
+    if (p.numSamples < 2) {
+        throw std::invalid_argument("price_path_aad: numSamples must be at least 2");
+    }
+    if (opts.sampler != Sampler::PseudoRandom) {
+        throw std::invalid_argument("price_path_aad: only pseudo-random sampling is supported");
+    }
+    const PathPayoff payoff(p, p.v * std::sqrt(p.T / p.numSteps));
+
+    // Barrier payoffs throw here, before any thread starts
+    double dx, dacc, dS;
+    payoff.gradient(0.0, 0.0, &dx, &dacc, &dS);
+
+    const long long perUnit = opts.antithetic ? 2 : 1;
+    const long long units = (p.numSamples + perUnit - 1) / perUnit;
+    const long long blocks = (units + kPathBlock - 1) / kPathBlock;
+    const size_t tile = tile_paths(p.numSteps);
+    std::vector<AadSums> block_sums(blocks);
+    ProfileRegion region;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        PhaseClock clock(region);
+        std::vector<double> z(static_cast<size_t>(p.numSteps) * tile);
+
+        #pragma omp for schedule(dynamic)
+        for (long long b = 0; b < blocks; ++b) {
+            long long first = b * kPathBlock;
+            block_sums[b] = aad_block_sums(p, payoff, opts.antithetic, vol_slope, rng, first,
+                                           std::min(kPathBlock, units - first), tile, z, clock);
+        }
+    }
+    region.finish();
+
+    // Fold in block order so the result does not depend on the thread count
+    PhaseClock clock;
+    AadSums sum{};
+    for (const AadSums& partial : block_sums) {
+        for (int k = 0; k < kNumAadSums; ++k) {
+            sum[k] += partial[k];
+        }
+    }
+    clock.lap(kPhaseReduce);
+
+    const double z_score = inv_norm_cdf(0.5 + 0.5 * opts.confidence);
+    McEstimate e = unit_estimate(1.0, static_cast<double>(units), z_score, sum[kValue], sum[kValueSq],
+                                 nullptr);
+    McAadResult result;
+    result.price.price = e.price;
+    result.price.std_error = e.std_error;
+    result.price.ci_low = e.ci_low;
+    result.price.ci_high = e.ci_high;
+    result.price.samples = units * perUnit;
+    result.delta = greek_estimate(1.0, units, sum[kDelta], sum[kDeltaSq]);
+    result.vega = greek_estimate(0.01, units, sum[kVega], sum[kVegaSq]);
+    result.rho = greek_estimate(0.01, units, sum[kRho], sum[kRhoSq]);
+    result.theta = greek_estimate(-1.0 / 365, units, sum[kDVdT], sum[kDVdTSq]);
+    return result;
+}
+
+} // namespace
+
+McAadResult FinanceMonteCarlo::price_path_aad(const OptionParams& p, const McOptions& opts) {
+    ProfileCall profile("price_path_aad", num_threads_);
+    return run_aad(p, 0.0, opts, rng_, num_threads_);
+}
+
+McAadResult FinanceMonteCarlo::price_path_aad(const OptionParams& p, const VolSurface& surface,
+                                              const McOptions& opts) {
+    ProfileCall profile("price_path_aad", num_threads_);
+    OptionParams smile = p;
+    smile.v = surface.vol(p.K, p.T);
+
+    // Theta moves along the surface, so the smile vol's maturity slope
+    // (central difference; the surface has no analytic T derivative) enters
+    // each path's dV/dT
+    const double h = 1e-4 * p.T;
+    const double vol_slope = (surface.vol(p.K, p.T + h) - surface.vol(p.K, p.T - h)) / (2 * h);
+    McAadResult result = run_aad(smile, vol_slope, opts, rng_, num_threads_);
+
+    // The paths see the surface only through the smile vol, so each node's
+    // vega is the flat vega times that vol's derivative in the node
+    std::vector<double> grad;
+    surface.vol_gradient(p.K, p.T, grad);
+    result.bucket_vega.resize(grad.size());
+    for (size_t n = 0; n < grad.size(); ++n) {
+        result.bucket_vega[n] = McGreekEstimate{result.vega.value * grad[n],
+                                                result.vega.std_error * std::fabs(grad[n])};
+    }
+    return result;
+}
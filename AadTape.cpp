@@ -0,0 +1,143 @@
+#include "AadTape.h"
+#include <cmath>
+
+AadTape::AadTape() : chunk_(0), used_(0) {
+    chunks_.emplace_back(new AadNode[kChunkNodes]);
+}
+
+AadNode* AadTape::next() {
+    if (used_ == kChunkNodes) {
+        ++chunk_;
+        used_ = 0;
+        if (chunk_ == chunks_.size()) {
+            chunks_.emplace_back(new AadNode[kChunkNodes]);
+        }
+    }
+    AadNode* n = &chunks_[chunk_][used_++];
+    n->adjoint = 0.0;
+    n->num_args = 0;
+    return n;
+}
+
+AadNode* AadTape::leaf() {
+    return next();
+}
+
+AadNode* AadTape::record(AadNode* a, double da) {
+    return record(a, da, nullptr, 0.0, nullptr, 0.0);
+}
+
+AadNode* AadTape::record(AadNode* a, double da, AadNode* b, double db) {
+    return record(a, da, b, db, nullptr, 0.0);
+}
+
+AadNode* AadTape::record(AadNode* a, double da, AadNode* b, double db, AadNode* c, double dc) {
+    AadNode* n = next();
+    AadNode* const args[] = {a, b, c};
+    const double partials[] = {da, db, dc};
+    for (int k = 0; k < AadNode::kMaxArgs; ++k) {
+        if (args[k]) {
+            n->arg[n->num_args] = args[k];
+            n->partial[n->num_args] = partials[k];
+            ++n->num_args;
+        }
+    }
+    return n;
+}
+
+void AadTape::rewind(const Mark& m) {
+    chunk_ = m.chunk;
+    used_ = m.used;
+}
+
+void AadTape::propagate(AadNode* result, const Mark& m) {
+    result->adjoint = 1.0;
+    for (size_t c = chunk_ + 1; c-- > m.chunk;) {
+        AadNode* nodes = chunks_[c].get();
+        size_t end = c == chunk_ ? used_ : kChunkNodes;
+        size_t begin = c == m.chunk ? m.used : 0;
+        for (size_t i = end; i-- > begin;) {
+            const AadNode& n = nodes[i];
+            if (n.adjoint == 0.0) {
+                continue;
+            }
+            for (int k = 0; k < n.num_args; ++k) {
+                n.arg[k]->adjoint += n.partial[k] * n.adjoint;
+            }
+        }
+    }
+}
+
+void AadTape::zero_adjoints(const Mark& m) {
+    for (size_t c = m.chunk; c <= chunk_; ++c) {
+        AadNode* nodes = chunks_[c].get();
+        size_t begin = c == m.chunk ? m.used : 0;
+        size_t end = c == chunk_ ? used_ : kChunkNodes;
+        for (size_t i = begin; i < end; ++i) {
+            nodes[i].adjoint = 0.0;
+        }
+    }
+}
+
+AadTape& aad_tape() {
+    thread_local AadTape tape;
+    return tape;
+}
+
+AadNumber operator+(const AadNumber& a, const AadNumber& b) {
+    double v = a.value() + b.value();
+    if (!a.node() && !b.node()) {
+        return AadNumber(v);
+    }
+    return AadNumber(v, aad_tape().record(a.node(), 1.0, b.node(), 1.0));
+}
+
+AadNumber operator-(const AadNumber& a, const AadNumber& b) {
+    double v = a.value() - b.value();
+    if (!a.node() && !b.node()) {
+        return AadNumber(v);
+    }
+    return AadNumber(v, aad_tape().record(a.node(), 1.0, b.node(), -1.0));
+}
+
+AadNumber operator*(const AadNumber& a, const AadNumber& b) {
+    double v = a.value() * b.value();
+    if (!a.node() && !b.node()) {
+        return AadNumber(v);
+    }
+    return AadNumber(v, aad_tape().record(a.node(), b.value(), b.node(), a.value()));
+}
+
+AadNumber operator/(const AadNumber& a, const AadNumber& b) {
+    double v = a.value() / b.value();
+    if (!a.node() && !b.node()) {
+        return AadNumber(v);
+    }
+    return AadNumber(v, aad_tape().record(a.node(), 1.0 / b.value(), b.node(), -v / b.value()));
+}
+
+AadNumber operator-(const AadNumber& a) {
+    if (!a.node()) {
+        return AadNumber(-a.value());
+    }
+    return AadNumber(-a.value(), aad_tape().record(a.node(), -1.0));
+}
+
+AadNumber exp(const AadNumber& a) {
+    double v = std::exp(a.value());
+    return a.node() ? AadNumber(v, aad_tape().record(a.node(), v)) : AadNumber(v);
+}
+
+AadNumber log(const AadNumber& a) {
+    double v = std::log(a.value());
+    return a.node() ? AadNumber(v, aad_tape().record(a.node(), 1.0 / a.value())) : AadNumber(v);
+}
+
+AadNumber sqrt(const AadNumber& a) {
+    double v = std::sqrt(a.value());
+    return a.node() ? AadNumber(v, aad_tape().record(a.node(), 0.5 / v)) : AadNumber(v);
+}
+
+AadNumber max(const AadNumber& a, const AadNumber& b) {
+    return a.value() >= b.value() ? a : b;
+}
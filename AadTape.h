@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Reverse-mode tape for adjoint algorithmic differentiation. Each recorded
+// operation is one node holding the partial derivative of its result in
+// each of its (at most kMaxArgs) arguments; a reverse sweep from a result
+// then yields its derivative in every input at once.
+//
+// Nodes live in an arena of fixed-size chunks. clear() and rewind() only
+// move the write position back, so once a tape has grown to the size of
+// the largest recording, recording never touches the heap. Engines keep
+// one tape per thread (aad_tape()), clear it at the start of each path
+// block and rewind it after each path.
+
+struct AadNode {
+    static const int kMaxArgs = 3;
+
+    double adjoint;
+    int num_args;
+    double partial[kMaxArgs];
+    AadNode* arg[kMaxArgs];
+};
+
+class AadTape {
+public:
+    // A position on the tape, for rewind() and the sweeps
+    struct Mark {
+        size_t chunk;
+        size_t used;
+    };
+
+    AadTape();
+
+    AadTape(const AadTape&) = delete;
+    AadTape& operator=(const AadTape&) = delete;
+
+    // An input: a node without arguments
+    AadNode* leaf();
+
+    // A result with the given partials in its arguments. Null arguments are
+    // constants and are left out.
+    AadNode* record(AadNode* a, double da);
+    AadNode* record(AadNode* a, double da, AadNode* b, double db);
+    AadNode* record(AadNode* a, double da, AadNode* b, double db, AadNode* c, double dc);
+
+    Mark mark() const { return Mark{chunk_, used_}; }
+
+    // Drops every node recorded after m; the memory is kept for reuse
+    void rewind(const Mark& m);
+
+    // Drops every node
+    void clear() { rewind(Mark{0, 0}); }
+
+    // Sets the adjoint of result to one and sweeps back to m, adding each
+    // node's adjoint times its partials into its arguments. Nodes before m
+    // only receive adjoints.
+    void propagate(AadNode* result, const Mark& m);
+
+    // Zeroes the adjoints of the nodes from m to the end of the tape
+    void zero_adjoints(const Mark& m);
+
+    // Nodes on the tape, and nodes the arena can hold without growing
+    size_t size() const { return chunk_ * kChunkNodes + used_; }
+    size_t capacity() const { return chunks_.size() * kChunkNodes; }
+
+private:
+    static const size_t kChunkNodes = 4096;
+
+    AadNode* next();
+
+    std::vector<std::unique_ptr<AadNode[]>> chunks_;
+    size_t chunk_;      // chunk being written
+    size_t used_;       // nodes used in it
+};
+
+// The calling thread's tape, created on first use and kept for the life of
+// the thread
+AadTape& aad_tape();
+
+// A value recorded on the calling thread's tape. A number without a node
+// is a constant: operations on it record nothing.
+class AadNumber {
+public:
+    AadNumber(double value = 0.0) : value_(value), node_(nullptr) {}
+    AadNumber(double value, AadNode* node) : value_(value), node_(node) {}
+
+    // A new input on the calling thread's tape
+    static AadNumber input(double value) { return AadNumber(value, aad_tape().leaf()); }
+
+    double value() const { return value_; }
+    AadNode* node() const { return node_; }
+
+    // Derivative of the last propagated result in this number
+    double adjoint() const { return node_ ? node_->adjoint : 0.0; }
+
+private:
+    double value_;
+    AadNode* node_;
+};
+
+AadNumber operator+(const AadNumber& a, const AadNumber& b);
+AadNumber operator-(const AadNumber& a, const AadNumber& b);
+AadNumber operator*(const AadNumber& a, const AadNumber& b);
+AadNumber operator/(const AadNumber& a, const AadNumber& b);
+AadNumber operator-(const AadNumber& a);
+AadNumber exp(const AadNumber& a);
+AadNumber log(const AadNumber& a);
+AadNumber sqrt(const AadNumber& a);
+
+// The larger argument, passed through with derivative one
+AadNumber max(const AadNumber& a, const AadNumber& b);
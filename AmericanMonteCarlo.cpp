@@ -0,0 +1,318 @@
+#include "FinanceMonteCarlo.h"
+#include "McProfile.h"
+#include "McStatistics.h"
+#include "SimdMath.h"
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Regression basis in moneyness x = S / K: 1, x, x^2, x^3
+const int kBasis = 4;
+const int kNormalTerms = kBasis * (kBasis + 1) / 2;
+
+// Normal equations over the in-the-money paths of one block: the upper
+// triangle of sum(phi phi^T), then sum(phi y)
+typedef std::array<double, kNormalTerms + kBasis> NormalSums;
+
+// Basis functions scaled by _weight, which is 0 or 1 and masks paths out
+inline void basis(vdouble _x, vdouble _weight, vdouble* _phi) {
+    _phi[0] = _weight;
+    for (int j = 1; j < kBasis; ++j) {
+        _phi[j] = vd_mul(_phi[j - 1], _x);
+    }
+}
+
+inline vdouble intrinsic(vdouble _S, vdouble _K, bool is_call) {
+    vdouble _zero = vd_set1(0.0);
+    return is_call ? vd_max(vd_sub(_S, _K), _zero) : vd_max(vd_sub(_K, _S), _zero);
+}
+
+// Solves the normal equations by Cholesky factorization. A ridge relative
+// to the diagonal keeps near-collinear bases (few ITM paths, tiny spread in
+// x) solvable. Returns false if there is nothing to regress on.
+bool solve_normal_equations(const NormalSums& sums, double* beta) {
+    double A[kBasis][kBasis];
+    double b[kBasis];
+    int t = 0;
+    for (int i = 0; i < kBasis; ++i) {
+        for (int j = i; j < kBasis; ++j, ++t) {
+            A[i][j] = A[j][i] = sums[t];
+        }
+        b[i] = sums[kNormalTerms + i];
+    }
+    if (A[0][0] < 2 * kBasis) {
+        return false;
+    }
+    for (int i = 0; i < kBasis; ++i) {
+        A[i][i] *= 1 + 1e-12;
+    }
+
+    double L[kBasis][kBasis] = {};
+    for (int i = 0; i < kBasis; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            double s = A[i][j];
+            for (int k = 0; k < j; ++k) {
+                s -= L[i][k] * L[j][k];
+            }
+            if (i == j) {
+                if (s <= 0) {
+                    return false;
+                }
+                L[i][i] = std::sqrt(s);
+            } else {
+                L[i][j] = s / L[j][j];
+            }
+        }
+    }
+    double y[kBasis];
+    for (int i = 0; i < kBasis; ++i) {
+        double s = b[i];
+        for (int k = 0; k < i; ++k) {
+            s -= L[i][k] * y[k];
+        }
+        y[i] = s / L[i][i];
+    }
+    for (int i = kBasis - 1; i >= 0; --i) {
+        double s = y[i];
+        for (int k = i + 1; k < kBasis; ++k) {
+            s -= L[k][i] * beta[k];
+        }
+        beta[i] = s / L[i][i];
+    }
+    return true;
+}
+
+} // namespace
+
+McPriceResult FinanceMonteCarlo::price_american(const OptionParams& p, bool is_call, const McOptions& opts) {
+    ProfileCall profile("price_american", num_threads_);
+    if (p.numSteps < 1) {
+        throw std::invalid_argument("price_american: numSteps must be at least 1");
+    }
+    if (p.numSamples < 2) {
+        throw std::invalid_argument("price_american: numSamples must be at least 2");
+    }
+    if (opts.sampler != Sampler::PseudoRandom) {
+        throw std::invalid_argument("price_american: only pseudo-random sampling is supported");
+    }
+
+    static const double kLaneIndex[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    const int steps = p.numSteps;
+    const double dt = p.T / steps;
+    const double mu = p.r - 0.5 * p.v * p.v;
+    const int perUnit = opts.antithetic ? 2 : 1;
+    const long long units = (p.numSamples + perUnit - 1) / perUnit;
+    const long long blocks = (units + kPathBlock - 1) / kPathBlock;
+
+    // State per sampling unit: the Brownian motion at the current date (the
+    // antithetic mirror is its negative) and the discounted cash flow of
+    // each leg under the exercise policy found so far. Arrays are padded to
+    // whole vectors; padded lanes are masked out of every sum.
+    const size_t padded = static_cast<size_t>(units + VD_LANES);
+    std::vector<double> w(padded, 0.0);
+    std::vector<double> cash(perUnit * padded, 0.0);
+    std::vector<double> european(opts.control_variate ? padded : 0);
+    std::vector<NormalSums> block_sums(blocks);
+    double beta[kBasis];
+    bool exercise = false;
+
+    const vdouble _S0 = vd_set1(p.S);
+    const vdouble _K = vd_set1(p.K);
+    const vdouble _invK = vd_set1(1.0 / p.K);
+    const vdouble _v = vd_set1(p.v);
+    const vdouble _one = vd_set1(1.0);
+    const vdouble _zero = vd_set1(0.0);
+    const vdouble _lanes = vd_load(kLaneIndex);
+    ProfileRegion region;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        PhaseClock clock(region);
+        std::vector<double> z(kPathBlock);
+
+        // Maturity: W_T from stream 0, cash flows are the terminal payoffs
+        #pragma omp for schedule(static)
+        for (long long b = 0; b < blocks; ++b) {
+            const long long first = b * kPathBlock;
+            const long long count = std::min(kPathBlock, units - first);
+            clock.restart();
+            rng_.normals(0, first, z.data(), count);
+            clock.lap(kPhaseRng);
+            const vdouble _drift = vd_set1(mu * p.T);
+            const vdouble _df = vd_set1(std::exp(-p.r * p.T));
+            for (long long i = 0; i < count; i += VD_LANES) {
+                double* wi = &w[first + i];
+                vdouble _w = vd_mul(vd_set1(std::sqrt(p.T)), vd_load(z.data() + i));
+                vd_store(wi, _w);
+                vdouble _c = vd_mul(_df, intrinsic(vd_mul(_S0, vd_exp(vd_fmadd(_v, _w, _drift))), _K, is_call));
+                vd_store(&cash[first + i], _c);
+                if (perUnit == 2) {
+                    vdouble _c2 = vd_mul(_df, intrinsic(vd_mul(_S0, vd_exp(vd_fnmadd(_v, _w, _drift))), _K, is_call));
+                    vd_store(&cash[padded + first + i], _c2);
+                    _c = vd_mul(vd_add(_c, _c2), vd_set1(0.5));
+                }
+                if (opts.control_variate) {
+                    vd_store(&european[first + i], _c);
+                }
+            }
+            clock.lap(kPhasePayoff);
+            clock.count_block(count * perUnit);
+        }
+
+        // Backward induction. Step k regenerates W(t_k) from W(t_k+1) with
+        // the bridge W_k = k/(k+1) W_k+1 + sqrt(dt k/(k+1)) Z, Z from
+        // stream steps - k, then regresses discounted cash flows of the ITM
+        // paths on the basis and exercises where intrinsic beats the fit.
+        for (int k = steps - 1; k >= 1; --k) {
+            const double t = k * dt;
+            const vdouble _a = vd_set1(static_cast<double>(k) / (k + 1));
+            const vdouble _sd = vd_set1(std::sqrt(dt * k / (k + 1)));
+            const vdouble _drift = vd_set1(mu * t);
+            const vdouble _df = vd_set1(std::exp(-p.r * t));
+
+            #pragma omp for schedule(static)
+            for (long long b = 0; b < blocks; ++b) {
+                const long long first = b * kPathBlock;
+                const long long count = std::min(kPathBlock, units - first);
+                clock.restart();
+                rng_.normals(static_cast<uint32_t>(steps - k), first, z.data(), count);
+                clock.lap(kPhaseRng);
+                vdouble _sum[kNormalTerms + kBasis];
+                for (auto& acc : _sum) {
+                    acc = vd_set1(0.0);
+                }
+                for (long long i = 0; i < count; i += VD_LANES) {
+                    vdouble _z;
+                    if (i + VD_LANES <= count) {
+                        _z = vd_load(z.data() + i);
+                    } else {
+                        double tail[VD_LANES] = {};
+                        std::copy(z.data() + i, z.data() + count, tail);
+                        _z = vd_load(tail);
+                    }
+                    vdouble _w = vd_fmadd(_sd, _z, vd_mul(_a, vd_load(&w[first + i])));
+                    vd_store(&w[first + i], _w);
+                    vmask _live = vd_lt(_lanes, vd_set1(static_cast<double>(count - i)));
+
+                    for (int leg = 0; leg < perUnit; ++leg) {
+                        vdouble _Swt = vd_mul(_S0, vd_exp(leg == 0 ? vd_fmadd(_v, _w, _drift)
+                                                                  : vd_fnmadd(_v, _w, _drift)));
+                        vdouble _h = intrinsic(_Swt, _K, is_call);
+                        vdouble _weight = vd_select(_live, vd_select(vd_gt(_h, _zero), _one, _zero), _zero);
+                        vdouble _phi[kBasis];
+                        basis(vd_mul(_Swt, _invK), _weight, _phi);
+                        vdouble _y = vd_load(&cash[leg * padded + first + i]);
+                        int term = 0;
+                        for (int r = 0; r < kBasis; ++r) {
+                            for (int c = r; c < kBasis; ++c, ++term) {
+                                _sum[term] = vd_fmadd(_phi[r], _phi[c], _sum[term]);
+                            }
+                            _sum[kNormalTerms + r] = vd_fmadd(_phi[r], _y, _sum[kNormalTerms + r]);
+                        }
+                    }
+                }
+                for (int j = 0; j < kNormalTerms + kBasis; ++j) {
+                    block_sums[b][j] = vd_reduce_add(_sum[j]);
+                }
+                clock.lap(kPhasePaths);
+            }
+
+            // Blocks fold in order, so the fit is identical at any thread count
+            #pragma omp single
+            {
+                clock.restart();
+                NormalSums total{};
+                for (const NormalSums& partial : block_sums) {
+                    for (int j = 0; j < kNormalTerms + kBasis; ++j) {
+                        total[j] += partial[j];
+                    }
+                }
+                exercise = solve_normal_equations(total, beta);
+                clock.lap(kPhaseReduce);
+            }
+
+            if (exercise) {
+                vdouble _beta[kBasis];
+                for (int j = 0; j < kBasis; ++j) {
+                    _beta[j] = vd_set1(beta[j]);
+                }
+                #pragma omp for schedule(static)
+                for (long long b = 0; b < blocks; ++b) {
+                    const long long first = b * kPathBlock;
+                    const long long count = std::min(kPathBlock, units - first);
+                    clock.restart();
+                    for (long long i = 0; i < count; i += VD_LANES) {
+                        vdouble _w = vd_load(&w[first + i]);
+                        for (int leg = 0; leg < perUnit; ++leg) {
+                            double* ci = &cash[leg * padded + first + i];
+                            vdouble _Swt = vd_mul(_S0, vd_exp(leg == 0 ? vd_fmadd(_v, _w, _drift)
+                                                                      : vd_fnmadd(_v, _w, _drift)));
+                            vdouble _h = intrinsic(_Swt, _K, is_call);
+                            vdouble _phi[kBasis];
+                            basis(vd_mul(_Swt, _invK), _one, _phi);
+                            vdouble _continuation = vd_mul(_beta[0], _phi[0]);
+                            for (int j = 1; j < kBasis; ++j) {
+                                _continuation = vd_fmadd(_beta[j], _phi[j], _continuation);
+                            }
+                            // Out-of-the-money paths never exercise
+                            vdouble _exercise = vd_select(vd_gt(_h, _zero), vd_mul(_df, _h),
+                                                          vd_set1(-std::numeric_limits<double>::infinity()));
+                            vd_store(ci, vd_select(vd_gt(_exercise, _continuation), _exercise, vd_load(ci)));
+                        }
+                    }
+                    clock.lap(kPhasePayoff);
+                }
+            }
+        }
+    }
+
+    region.finish();
+
+    // Unit payoffs, summed in block order
+    PhaseClock clock;
+    std::array<double, 5> sum{};
+    for (long long b = 0; b < blocks; ++b) {
+        std::array<double, 5> partial{};
+        const long long first = b * kPathBlock;
+        const long long end = std::min(first + kPathBlock, units);
+        for (long long i = first; i < end; ++i) {
+            double y = perUnit == 2 ? 0.5 * (cash[i] + cash[padded + i]) : cash[i];
+            double x = opts.control_variate ? european[i] : 0.0;
+            partial[0] += y;
+            partial[1] += y * y;
+            partial[2] += x;
+            partial[3] += x * x;
+            partial[4] += x * y;
+        }
+        for (int j = 0; j < 5; ++j) {
+            sum[j] += partial[j];
+        }
+    }
+    clock.lap(kPhaseReduce);
+
+    // Cash flows are already discounted to t = 0, as is the European mean
+    const double z_score = inv_norm_cdf(0.5 + 0.5 * opts.confidence);
+    double control[] = {sum[2], sum[3], sum[4], opts.control_variate ? black_scholes_price(p, is_call) : 0.0};
+    McEstimate e = unit_estimate(1.0, static_cast<double>(units), z_score, sum[0], sum[1],
+                                 opts.control_variate ? control : nullptr);
+
+    McPriceResult result;
+    result.price = e.price;
+    result.std_error = e.std_error;
+    result.ci_low = e.ci_low;
+    result.ci_high = e.ci_high;
+    result.samples = units * perUnit;
+
+    // Exercising immediately is always available
+    double now = is_call ? std::max(p.S - p.K, 0.0) : std::max(p.K - p.S, 0.0);
+    if (now > result.price) {
+        result.price = result.ci_low = result.ci_high = now;
+        result.std_error = 0.0;
+    }
+    return result;
+}
@@ -0,0 +1,319 @@
+#include "BasketMonteCarlo.h"
+#include "FinanceMonteCarlo.h"
+#include "McProfile.h"
+#include "McStatistics.h"
+#include "PathEngine.h"
+#include "SimdMath.h"
+#include "SobolSequence.h"
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Per-block accumulators over sampling units: payoff y and the weighted
+// terminal basket x, whose mean is known, as control variate
+enum BasketSum {
+    kY,
+    kYY,
+    kX,
+    kXX,
+    kXY,
+    kNumBasketSums
+};
+
+typedef std::array<double, kNumBasketSums> BasketSums;
+
+struct BasketModel {
+    int n;
+    std::vector<double> L;          // Cholesky factor of the correlation
+    std::vector<double> S;
+    std::vector<double> drift;      // (r - q - v^2 / 2) T per asset
+    std::vector<double> diffusion;  // v sqrt(T) per asset
+    std::vector<double> weights;    // effective weights; Spread becomes (1, -1)
+    BasketPayoff payoff;
+    bool is_call;
+    double K;
+};
+
+// Turns the iid normals z (assets x tile) into correlated ones in place.
+// Row i of L z only needs rows j <= i, so going from the last row up never
+// reads an overwritten row; each update is a vectorized axpy over the tile.
+void correlate_tile(const BasketModel& m, double* z, size_t tile) {
+    for (int i = m.n - 1; i >= 0; --i) {
+        double* zi = z + static_cast<size_t>(i) * tile;
+        const double* Li = &m.L[static_cast<size_t>(i) * m.n];
+        const vdouble _Lii = vd_set1(Li[i]);
+        for (size_t p = 0; p < tile; p += VD_LANES) {
+            vd_store(zi + p, vd_mul(_Lii, vd_load(zi + p)));
+        }
+        for (int j = 0; j < i; ++j) {
+            if (Li[j] == 0.0) {
+                continue;
+            }
+            const double* zj = z + static_cast<size_t>(j) * tile;
+            const vdouble _Lij = vd_set1(Li[j]);
+            for (size_t p = 0; p < tile; p += VD_LANES) {
+                vd_store(zi + p, vd_fmadd(_Lij, vd_load(zj + p), vd_load(zi + p)));
+            }
+        }
+    }
+}
+
+// Aggregates the terminal spots of one leg (sign +1, or -1 for the
+// antithetic mirror) into agg, the quantity the payoff is struck on, and
+// ctrl, the weighted basket
+void aggregate_tile(const BasketModel& m, const double* y, size_t tile, double sign,
+                    double* agg, double* ctrl) {
+    double init = m.payoff == BasketPayoff::BestOf ? -std::numeric_limits<double>::infinity()
+                : m.payoff == BasketPayoff::WorstOf ? std::numeric_limits<double>::infinity()
+                : 0.0;
+    std::fill(agg, agg + tile, init);
+    std::fill(ctrl, ctrl + tile, 0.0);
+    for (int i = 0; i < m.n; ++i) {
+        const double* yi = y + static_cast<size_t>(i) * tile;
+        const vdouble _S = vd_set1(m.S[i] * m.weights[i]);
+        const vdouble _drift = vd_set1(m.drift[i]);
+        const vdouble _diffusion = vd_set1(sign * m.diffusion[i]);
+        for (size_t p = 0; p < tile; p += VD_LANES) {
+            vdouble _wS = vd_mul(_S, vd_exp(vd_fmadd(_diffusion, vd_load(yi + p), _drift)));
+            vdouble _agg = vd_load(agg + p);
+            switch (m.payoff) {
+            case BasketPayoff::BestOf:
+                _agg = vd_max(_agg, _wS);
+                break;
+            case BasketPayoff::WorstOf:
+                _agg = vd_min(_agg, _wS);
+                break;
+            default:
+                _agg = vd_add(_agg, _wS);
+                break;
+            }
+            vd_store(agg + p, _agg);
+            vd_store(ctrl + p, vd_add(vd_load(ctrl + p), _wS));
+        }
+    }
+}
+
+inline double vanilla(double A, double K, bool is_call) {
+    return is_call ? std::max(A - K, 0.0) : std::max(K - A, 0.0);
+}
+
+// draw(first, z) fills z with the assets x tile iid normals of the tile
+// units [first, first + tile)
+typedef std::function<void(long long, double*)> TileDraw;
+
+BasketSums basket_block_sums(const BasketModel& m, bool antithetic, long long first, long long units,
+                             size_t tile, const TileDraw& draw, std::vector<double>& z,
+                             std::vector<double>& state, PhaseClock& clock) {
+    double* agg = state.data();
+    double* ctrl = agg + tile;
+    double* agg2 = ctrl + tile;
+    double* ctrl2 = agg2 + tile;
+    BasketSums sums{};
+
+    for (long long t = 0; t < units; t += tile) {
+        clock.restart();
+        draw(first + t, z.data());
+        clock.lap(kPhaseRng);
+        correlate_tile(m, z.data(), tile);
+        aggregate_tile(m, z.data(), tile, 1.0, agg, ctrl);
+        if (antithetic) {
+            aggregate_tile(m, z.data(), tile, -1.0, agg2, ctrl2);
+        }
+        clock.lap(kPhasePaths);
+
+        long long live = std::min(static_cast<long long>(tile), units - t);
+        for (long long i = 0; i < live; ++i) {
+            double y = vanilla(agg[i], m.K, m.is_call);
+            double c = ctrl[i];
+            if (antithetic) {
+                y = 0.5 * (y + vanilla(agg2[i], m.K, m.is_call));
+                c = 0.5 * (c + ctrl2[i]);
+            }
+            sums[kY] += y;
+            sums[kYY] += y * y;
+            sums[kX] += c;
+            sums[kXX] += c * c;
+            sums[kXY] += c * y;
+        }
+        clock.lap(kPhasePayoff);
+    }
+    clock.count_block(units * (antithetic ? 2 : 1));
+    return sums;
+}
+
+// Runs blocks [first_block, end_block) over max_units sampling units and
+// folds their sums into sum in block order
+void sweep_basket(const BasketModel& m, bool antithetic, int num_threads,
+                  long long first_block, long long end_block, long long max_units,
+                  const TileDraw& draw, BasketSums& sum) {
+    const size_t tile = tile_paths(m.n);
+    std::vector<BasketSums> block_sums(end_block - first_block);
+    ProfileRegion region;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        PhaseClock clock(region);
+        std::vector<double> z(static_cast<size_t>(m.n) * tile);
+        std::vector<double> state(4 * tile);
+
+        #pragma omp for schedule(dynamic)
+        for (long long b = first_block; b < end_block; ++b) {
+            long long first = b * kPathBlock;
+            long long count = std::min(kPathBlock, max_units - first);
+            block_sums[b - first_block] = basket_block_sums(m, antithetic, first, count, tile,
+                                                            draw, z, state, clock);
+        }
+    }
+    region.finish();
+
+    PhaseClock clock;
+    for (const BasketSums& partial : block_sums) {
+        for (int k = 0; k < kNumBasketSums; ++k) {
+            sum[k] += partial[k];
+        }
+    }
+    clock.lap(kPhaseReduce);
+}
+
+McPriceResult basket_result(const BasketParams& b, const McOptions& opts, const BasketSums& sum,
+                            long long units, double controlMean) {
+    double df = std::exp(-b.r * b.T);
+    double z_score = inv_norm_cdf(0.5 + 0.5 * opts.confidence);
+    double control[] = {sum[kX], sum[kXX], sum[kXY], controlMean};
+    McEstimate e = unit_estimate(df, units, z_score, sum[kY], sum[kYY],
+                                 opts.control_variate ? control : nullptr);
+    McPriceResult result;
+    result.price = e.price;
+    result.std_error = e.std_error;
+    result.ci_low = e.ci_low;
+    result.ci_high = e.ci_high;
+    result.samples = units * (opts.antithetic ? 2 : 1);
+    return result;
+}
+
+BasketModel basket_model(const BasketParams& b) {
+    const int n = static_cast<int>(b.size());
+    if (n < 1) {
+        throw std::invalid_argument("price_basket: at least one asset is required");
+    }
+    if (b.v.size() != b.size() || (!b.q.empty() && b.q.size() != b.size()) ||
+        (!b.weights.empty() && b.weights.size() != b.size())) {
+        throw std::invalid_argument("price_basket: per-asset columns must have one entry per asset");
+    }
+    if (b.correlation.size() != static_cast<size_t>(n) * n) {
+        throw std::invalid_argument("price_basket: correlation must be n x n");
+    }
+    if (b.payoff == BasketPayoff::Spread && n != 2) {
+        throw std::invalid_argument("price_basket: a spread needs exactly two assets");
+    }
+    if (b.numSamples < 2) {
+        throw std::invalid_argument("price_basket: numSamples must be at least 2");
+    }
+    for (int i = 0; i < n; ++i) {
+        if (std::abs(b.correlation[static_cast<size_t>(i) * n + i] - 1.0) > 1e-12) {
+            throw std::invalid_argument("price_basket: correlation must have a unit diagonal");
+        }
+    }
+
+    BasketModel m;
+    m.n = n;
+    m.L = cholesky_factor(b.correlation, n);
+    m.S = b.S;
+    m.payoff = b.payoff;
+    m.is_call = b.is_call;
+    m.K = b.K;
+    for (int i = 0; i < n; ++i) {
+        double q = b.q.empty() ? 0.0 : b.q[i];
+        m.drift.push_back((b.r - q - 0.5 * b.v[i] * b.v[i]) * b.T);
+        m.diffusion.push_back(b.v[i] * std::sqrt(b.T));
+        double w = b.weights.empty() ? 1.0 : b.weights[i];
+        if (b.payoff == BasketPayoff::Spread) {
+            w = i == 0 ? 1.0 : -1.0;
+        }
+        m.weights.push_back(w);
+    }
+    return m;
+}
+
+} // namespace
+
+std::vector<double> cholesky_factor(const std::vector<double>& a, int n) {
+    if (a.size() != static_cast<size_t>(n) * n) {
+        throw std::invalid_argument("cholesky_factor: matrix must be n x n");
+    }
+    std::vector<double> L(a.size(), 0.0);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            if (std::abs(a[static_cast<size_t>(i) * n + j] - a[static_cast<size_t>(j) * n + i]) > 1e-12) {
+                throw std::invalid_argument("cholesky_factor: matrix is not symmetric");
+            }
+            double s = a[static_cast<size_t>(i) * n + j];
+            for (int k = 0; k < j; ++k) {
+                s -= L[static_cast<size_t>(i) * n + k] * L[static_cast<size_t>(j) * n + k];
+            }
+            if (i == j) {
+                if (s <= 0) {
+                    throw std::invalid_argument("cholesky_factor: matrix is not positive definite");
+                }
+                L[static_cast<size_t>(i) * n + i] = std::sqrt(s);
+            } else {
+                L[static_cast<size_t>(i) * n + j] = s / L[static_cast<size_t>(j) * n + j];
+            }
+        }
+    }
+    return L;
+}
+
+McPriceResult FinanceMonteCarlo::price_basket(const BasketParams& b, const McOptions& opts) {
+    ProfileCall profile("price_basket", num_threads_);
+    // The correlation is factored once per call, outside the path loop
+    const BasketModel m = basket_model(b);
+
+    const long long perUnit = opts.antithetic ? 2 : 1;
+    const long long max_units = (b.numSamples + perUnit - 1) / perUnit;
+    const size_t tile = tile_paths(m.n);
+
+    // Forward of the weighted basket, the control variate's known mean
+    double controlMean = 0.0;
+    for (int i = 0; i < m.n; ++i) {
+        controlMean += m.weights[i] * m.S[i] * std::exp(m.drift[i] + 0.5 * m.diffusion[i] * m.diffusion[i]);
+    }
+
+    auto result = [&](const BasketSums& sum, long long units) {
+        return basket_result(b, opts, sum, units, controlMean);
+    };
+
+    if (opts.sampler == Sampler::Sobol) {
+        // One Sobol dimension per asset; the spread of independently
+        // scrambled replicates gives the error estimate
+        SobolSequence sobol(m.n);
+        auto sweep = [&](uint64_t scramble, long long first_block, long long end_block,
+                         long long units, BasketSums& sum) {
+            TileDraw draw = [&sobol, scramble, tile](long long first, double* z) {
+                sobol.normals(scramble, static_cast<uint32_t>(first), tile, z);
+            };
+            sweep_basket(m, opts.antithetic, num_threads_, first_block, end_block, units, draw, sum);
+        };
+        return run_sampling<BasketSums>(opts, max_units, rng_.seed(), sweep, result);
+    }
+
+    // Asset i of unit j uses normal j of stream i
+    const CounterRng& rng = rng_;
+    const int n = m.n;
+    TileDraw draw = [&rng, n, tile](long long first, double* z) {
+        for (int i = 0; i < n; ++i) {
+            rng.normals(static_cast<uint32_t>(i), first, z + static_cast<size_t>(i) * tile, tile);
+        }
+    };
+    auto sweep = [&](uint64_t, long long first_block, long long end_block, long long units,
+                     BasketSums& sum) {
+        sweep_basket(m, opts.antithetic, num_threads_, first_block, end_block, units, draw, sum);
+    };
+    return run_sampling<BasketSums>(opts, max_units, rng_.seed(), sweep, result);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+enum class BasketPayoff {
+    Basket,     // sum_i w_i S_i vs K
+    Spread,     // S_0 - S_1 vs K, exactly two assets, weights ignored
+    BestOf,     // max_i w_i S_i vs K (rainbow)
+    WorstOf     // min_i w_i S_i vs K (rainbow)
+};
+
+// European option on several correlated GBM underlyings. Per-asset columns
+// have one entry per asset; correlation is n x n, row-major.
+struct BasketParams {
+    std::vector<double> S;              // Spot prices
+    std::vector<double> v;              // Volatilities
+    std::vector<double> q;              // Dividend yields, empty for none
+    std::vector<double> weights;        // Payoff weights, empty for all 1
+    std::vector<double> correlation;    // Symmetric positive definite, unit diagonal
+    double K;                           // Strike price
+    double T;                           // Time to maturity
+    double r;                           // Risk-free rate
+    long long numSamples;               // Number of Monte Carlo samples
+    BasketPayoff payoff = BasketPayoff::Basket;
+    bool is_call = true;
+
+    size_t size() const { return S.size(); }
+};
+
+// Lower-triangular Cholesky factor of a row-major n x n matrix, row-major
+// with zeros above the diagonal. Throws std::invalid_argument if the matrix
+// is not symmetric positive definite.
+std::vector<double> cholesky_factor(const std::vector<double>& a, int n);
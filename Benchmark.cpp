@@ -0,0 +1,800 @@
+// Throughput benchmarks for the pricing kernels.
+//
+//   mc_bench [--quick] [--reps N] [--threads 1,2,4] [--kernels a,b]
+//            [--out results.csv] [--baseline old.csv] [--profile calls.json]
+//   mc_bench --validate-f32 [--threads N]
+//   mc_bench --validate-aad [--threads N]
+//   mc_bench --validate-pde
+//
+// Every kernel runs at each size and thread count, once to warm up and
+// then --reps timed times. Results go to stdout as a table and, with
+// --out, as CSV (one row per kernel, size and thread count, stable order)
+// so runs from two commits can be diffed or passed back as --baseline,
+// which adds the ratio of median throughputs. In MC_INSTRUMENT builds,
+// --profile writes every engine call's phase timings (McProfile.h).
+//
+// --validate-f32 prices a set of options with the single-precision sweep
+// (McOptions::single_precision) and the double one, and fails unless every
+// price and pathwise delta agrees to within kValidateSigmas combined
+// standard errors.
+//
+// --validate-aad checks price_path_aad against price_ladder, which runs on
+// the same normals: prices must match to rounding, and delta and vega
+// must agree to within kValidateSigmas combined standard errors. It also
+// checks VolSurface::vol_gradient against central differences of vol().
+//
+// --validate-pde checks the Crank-Nicolson engine on a grid of vanillas
+// against Black-Scholes, its second-order convergence under grid
+// refinement, agreement between every kernel build the CPU can run, and
+// American puts against a fine binomial tree.
+#include "BasketMonteCarlo.h"
+#include "BlackScholesBatch.h"
+#include "CrankNicolson.h"
+#include "FinanceMonteCarlo.h"
+#include "HestonMonteCarlo.h"
+#include "McProfile.h"
+#include "PricingService.h"
+#include "ScenarioEngine.h"
+#include "SimdKernels.h"
+#include "SimdMath.h"
+#include "VolSurface.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+namespace {
+
+const uint64_t kBenchSeed = 20240601;
+
+// One kernel: run(mc, size) does size units of work (paths or options)
+struct Kernel {
+    std::string name;
+    std::string unit;
+    std::vector<long long> sizes;
+    std::vector<long long> quick_sizes;
+    std::function<void(FinanceMonteCarlo&, long long)> run;
+};
+
+struct Measurement {
+    std::string kernel;
+    std::string unit;
+    long long size;
+    int threads;
+    int reps;
+    double median;      // units per second
+    double mean;
+    double stddev;
+    double efficiency;  // median / (threads x median at one thread)
+};
+
+OptionParams atm(long long samples, int steps = 1) {
+    OptionParams p{100.0, 100.0, 1.0, 0.05, 0.2, samples, steps};
+    return p;
+}
+
+// A chain of n options spread over strikes, maturities and vols
+OptionChain make_chain(long long n) {
+    OptionChain chain;
+    chain.reserve(n);
+    for (long long i = 0; i < n; ++i) {
+        OptionParams p{100.0, 60.0 + (i % 81), 0.1 + (i % 29) * 0.1, 0.03, 0.1 + (i % 7) * 0.05, 0};
+        chain.push_back(p, i % 2 == 0);
+    }
+    return chain;
+}
+
+std::vector<PricingJob> make_portfolio(long long paths) {
+    const long long kSmall = 4096;
+    std::vector<PricingJob> jobs;
+    for (long long i = 0; i < paths / 2 / kSmall; ++i) {
+        PricingJob job;
+        job.params = OptionParams{100.0, 80.0 + i % 41, 0.25 + (i % 8) * 0.25, 0.03, 0.2, kSmall};
+        job.is_call = i % 2 == 0;
+        jobs.push_back(job);
+    }
+    for (int i = 0; i < 4; ++i) {
+        PricingJob job;
+        job.params = atm(paths / 8);
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+std::vector<Kernel> make_kernels() {
+    std::vector<Kernel> kernels;
+
+    kernels.push_back({"bs_chain", "options", {1 << 16, 1 << 20, 1 << 23}, {1 << 16, 1 << 20},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           static std::map<long long, OptionChain> chains;
+                           auto it = chains.find(n);
+                           if (it == chains.end()) {
+                               it = chains.emplace(n, make_chain(n)).first;
+                           }
+                           // Reused so the timing excludes first-touch page faults
+                           static GreeksChain out;
+                           mc.black_scholes_chain(it->second, out);
+                       }});
+
+    kernels.push_back({"implied_vol", "options", {1 << 14, 1 << 18}, {1 << 14},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           static std::map<long long, std::pair<OptionChain, std::vector<double>>> quotes;
+                           auto it = quotes.find(n);
+                           if (it == quotes.end()) {
+                               OptionChain chain = make_chain(n);
+                               GreeksChain g;
+                               black_scholes_batch(chain, g);
+                               it = quotes.emplace(n, std::make_pair(chain, g.price)).first;
+                           }
+                           static std::vector<double> vols;
+                           mc.implied_volatility_chain(it->second.first, it->second.second, vols);
+                       }});
+
+    // Crank-Nicolson on the default 200 x 100 grid, kPdeLanes options per solve
+    kernels.push_back({"pde_chain", "options", {1 << 12, 1 << 15}, {1 << 12},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           static std::map<long long, OptionChain> chains;
+                           auto it = chains.find(n);
+                           if (it == chains.end()) {
+                               it = chains.emplace(n, make_chain(n)).first;
+                           }
+                           static GreeksChain out;
+                           mc.pde_chain(it->second, PdeOptions(), out);
+                       }});
+
+    // A 21 x 21 spot/vol grid; the unit is one position under one scenario
+    kernels.push_back({"scenario_grid", "revals", {1 << 22, 1 << 25}, {1 << 22},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           static std::vector<double> spot, vol;
+                           if (spot.empty()) {
+                               for (int k = -10; k <= 10; ++k) {
+                                   spot.push_back(0.02 * k);
+                                   vol.push_back(0.01 * k);
+                               }
+                           }
+                           const std::vector<Scenario> grid = ScenarioEngine::grid(spot, vol);
+                           static std::map<long long, OptionChain> chains;
+                           long long positions = n / static_cast<long long>(grid.size());
+                           auto it = chains.find(positions);
+                           if (it == chains.end()) {
+                               it = chains.emplace(positions, make_chain(positions)).first;
+                           }
+                           ScenarioEngine engine(grid, mc.num_threads());
+                           engine.add(it->second);
+                           engine.result(0.99);
+                       }});
+
+    kernels.push_back({"european", "paths", {1 << 20, 1 << 24}, {1 << 20},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           mc.price_european(atm(n));
+                       }});
+
+    kernels.push_back({"european_f32", "paths", {1 << 20, 1 << 24}, {1 << 20},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           McOptions opts;
+                           opts.single_precision = true;
+                           mc.price_european(atm(n), opts);
+                       }});
+
+    kernels.push_back({"european_sobol", "paths", {1 << 20, 1 << 24}, {1 << 20},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           McOptions opts;
+                           opts.sampler = Sampler::Sobol;
+                           mc.price_european(atm(n), opts);
+                       }});
+
+    // A portfolio of n paths: half in small 4096-path jobs, half in four
+    // large ones, through one call per option or through a PricingService
+    kernels.push_back({"portfolio_loop", "paths", {1 << 22, 1 << 24}, {1 << 22},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           for (const PricingJob& job : make_portfolio(n)) {
+                               mc.price_european(job.params, job.options);
+                           }
+                       }});
+
+    kernels.push_back({"portfolio_svc", "paths", {1 << 22, 1 << 24}, {1 << 22},
+                       [](FinanceMonteCarlo& mc, long long n) {
+                           static std::map<int, std::unique_ptr<PricingService>> services;
+                           std::unique_ptr<PricingService>& service = services[mc.num_threads()];
+                           if (!service) {
+                               service.reset(new PricingService(mc.num_threads(), kBenchSeed));
+                           }
+                           for (auto& f : service->submit(make_portfolio(n))) {
+                               f.get();
+                           }
+                       }});
+
+    // Path kernels count path-steps, so sizes are comparable across step counts
+    const int kSteps = 64;
+    kernels.push_back({"asian_64", "path-steps", {1 << 22, 1 << 26}, {1 << 22},
+                       [=](FinanceMonteCarlo& mc, long long n) {
+                           OptionParams p = atm(n / kSteps, kSteps);
+                           p.payoff.type = PayoffType::AsianArithmetic;
+                           mc.price_path_option(p);
+                       }});
+
+    // The same paths with delta, vega, rho and theta by adjoints
+    kernels.push_back({"asian_64_aad", "path-steps", {1 << 22, 1 << 25}, {1 << 22},
+                       [=](FinanceMonteCarlo& mc, long long n) {
+                           OptionParams p = atm(n / kSteps, kSteps);
+                           p.payoff.type = PayoffType::AsianArithmetic;
+                           mc.price_path_aad(p);
+                       }});
+
+    kernels.push_back({"american_64", "path-steps", {1 << 22, 1 << 24}, {1 << 22},
+                       [=](FinanceMonteCarlo& mc, long long n) {
+                           mc.price_american(atm(n / kSteps, kSteps), false);
+                       }});
+
+    kernels.push_back({"heston_64", "path-steps", {1 << 22, 1 << 25}, {1 << 22},
+                       [=](FinanceMonteCarlo& mc, long long n) {
+                           HestonParams h{2.0, 0.04, 0.5, -0.7, 0.04};
+                           mc.price_heston(atm(n / kSteps, kSteps), h);
+                       }});
+
+    kernels.push_back({"local_vol_64", "path-steps", {1 << 22, 1 << 25}, {1 << 22},
+                       [=](FinanceMonteCarlo& mc, long long n) {
+                           static const VolSurface surface = [] {
+                               std::vector<double> K, T, V;
+                               for (int i = 0; i < 15; ++i) {
+                                   K.push_back(50.0 + 7.5 * i);
+                               }
+                               for (int j = 0; j < 6; ++j) {
+                                   T.push_back(0.25 * (j + 1));
+                               }
+                               for (double t : T) {
+                                   for (double k : K) {
+                                       double x = std::log(k / 100.0);
+                                       V.push_back(0.2 - 0.05 * x / std::sqrt(t) + 0.1 * x * x);
+                                   }
+                               }
+                               return VolSurface(K, T, V, VolSurface::Interpolation::Cubic);
+                           }();
+                           mc.price_local_vol(atm(n / kSteps, kSteps), surface);
+                       }});
+
+    // Basket kernel counts asset-paths
+    const int kAssets = 16;
+    kernels.push_back({"basket_16", "asset-paths", {1 << 22, 1 << 25}, {1 << 22},
+                       [=](FinanceMonteCarlo& mc, long long n) {
+                           BasketParams b;
+                           b.S.assign(kAssets, 100.0);
+                           b.v.assign(kAssets, 0.25);
+                           b.correlation.assign(kAssets * kAssets, 0.3);
+                           for (int i = 0; i < kAssets; ++i) {
+                               b.correlation[i * kAssets + i] = 1.0;
+                           }
+                           b.weights.assign(kAssets, 1.0 / kAssets);
+                           b.K = 100.0;
+                           b.T = 1.0;
+                           b.r = 0.05;
+                           b.numSamples = n / kAssets;
+                           mc.price_basket(b);
+                       }});
+
+    return kernels;
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, sep)) {
+        if (!item.empty()) {
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+std::string key(const std::string& kernel, long long size, int threads) {
+    return kernel + "/" + std::to_string(size) + "/" + std::to_string(threads);
+}
+
+// kernel/size/threads -> median throughput from an earlier --out file
+std::map<std::string, double> read_baseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("cannot read baseline " + path);
+    }
+    std::map<std::string, double> base;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#' || line.compare(0, 7, "kernel,") == 0) {
+            continue;
+        }
+        std::vector<std::string> f = split(line, ',');
+        if (f.size() >= 6) {
+            base[key(f[0], std::stoll(f[2]), std::stoi(f[3]))] = std::stod(f[5]);
+        }
+    }
+    return base;
+}
+
+Measurement measure(const Kernel& k, long long size, int threads, int reps) {
+    FinanceMonteCarlo mc(threads, kBenchSeed);
+    k.run(mc, size);
+
+    std::vector<double> rates;
+    for (int rep = 0; rep < reps; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        k.run(mc, size);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rates.push_back(size / seconds);
+    }
+    std::sort(rates.begin(), rates.end());
+    double mean = 0.0;
+    for (double r : rates) {
+        mean += r;
+    }
+    mean /= reps;
+    double var = 0.0;
+    for (double r : rates) {
+        var += (r - mean) * (r - mean);
+    }
+
+    Measurement m;
+    m.kernel = k.name;
+    m.unit = k.unit;
+    m.size = size;
+    m.threads = threads;
+    m.reps = reps;
+    m.median = reps % 2 ? rates[reps / 2] : 0.5 * (rates[reps / 2 - 1] + rates[reps / 2]);
+    m.mean = mean;
+    m.stddev = reps > 1 ? std::sqrt(var / (reps - 1)) : 0.0;
+    m.efficiency = 1.0;
+    return m;
+}
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: mc_bench [--quick] [--reps N] [--threads 1,2,4] [--kernels a,b]\n"
+                 "                [--out results.csv] [--baseline old.csv] [--profile calls.json]\n"
+                 "       mc_bench --validate-f32 [--threads N]\n"
+                 "       mc_bench --validate-aad [--threads N]\n"
+                 "       mc_bench --validate-pde\n");
+}
+
+const double kValidateSigmas = 4.0;
+const long long kValidatePaths = 1 << 22;
+
+// Single-precision against double sweeps over moneyness, vol and maturity,
+// plain and antithetic. The two runs use independent normals, so the
+// difference is compared with the combined standard error; the pathwise
+// delta has no error estimate of its own and is held to the call's
+// relative error. Returns the process exit code.
+int validate_single_precision(int threads) {
+    const OptionParams cases[] = {
+        {100.0, 100.0, 1.0, 0.05, 0.2, kValidatePaths, 1},
+        {100.0, 130.0, 0.5, 0.03, 0.3, kValidatePaths, 1},
+        {100.0, 70.0, 2.0, 0.01, 0.5, kValidatePaths, 1},
+        {50.0, 55.0, 0.25, 0.0, 0.15, kValidatePaths, 1},
+        {2000.0, 1900.0, 5.0, 0.04, 0.8, kValidatePaths, 1},
+    };
+    FinanceMonteCarlo mc(threads, kBenchSeed);
+    int failures = 0;
+    std::printf("%-28s %4s %12s %12s %7s %12s %12s %7s %7s %7s\n", "option (S/K/T/r/v)", "anti",
+                "call f64", "call f32", "z", "put f64", "put f32", "z", "delta z", "speedup");
+    for (const OptionParams& p : cases) {
+        for (int antithetic = 0; antithetic < 2; ++antithetic) {
+            McOptions opts;
+            opts.antithetic = antithetic != 0;
+            auto t0 = std::chrono::steady_clock::now();
+            MonteCarloResult f64 = mc.price_european(p, opts);
+            auto t1 = std::chrono::steady_clock::now();
+            opts.single_precision = true;
+            MonteCarloResult f32 = mc.price_european(p, opts);
+            auto t2 = std::chrono::steady_clock::now();
+
+            auto z = [](const McLegResult& a, const McLegResult& b) {
+                return (b.price - a.price) / std::hypot(a.std_error, b.std_error);
+            };
+            double callZ = z(f64.call, f32.call);
+            double putZ = z(f64.put, f32.put);
+            double deltaScale = std::fabs(f64.call.pathwise.delta) * f64.call.std_error /
+                                std::max(f64.call.price, 1e-12);
+            double deltaZ = (f32.call.pathwise.delta - f64.call.pathwise.delta) /
+                            (std::sqrt(2.0) * std::max(deltaScale, 1e-12));
+            bool ok = std::fabs(callZ) <= kValidateSigmas && std::fabs(putZ) <= kValidateSigmas &&
+                      std::fabs(deltaZ) <= kValidateSigmas;
+            failures += ok ? 0 : 1;
+
+            // Five %g fields of at most 13 characters, four slashes
+            char label[5 * 13 + 4 + 1];
+            std::snprintf(label, sizeof(label), "%g/%g/%g/%g/%g", p.S, p.K, p.T, p.r, p.v);
+            std::printf("%-28s %4d %12.6f %12.6f %7.2f %12.6f %12.6f %7.2f %7.2f %6.2fx%s\n", label,
+                        antithetic, f64.call.price, f32.call.price, callZ, f64.put.price, f32.put.price,
+                        putZ, deltaZ,
+                        std::chrono::duration<double>(t1 - t0).count() /
+                            std::chrono::duration<double>(t2 - t1).count(),
+                        ok ? "" : "  FAIL");
+        }
+    }
+    std::printf("%s: %d of %d cases outside %g standard errors\n", failures ? "FAILED" : "passed",
+                failures, static_cast<int>(2 * (sizeof(cases) / sizeof(cases[0]))), kValidateSigmas);
+    return failures ? 1 : 0;
+}
+
+// Adjoint greeks against common-random-number bumps for each payoff with
+// a pathwise derivative, plain and antithetic, then the surface gradient
+// the bucketed vegas are built from against bumped node vols. Returns the
+// process exit code.
+int validate_aad(int threads) {
+    const struct {
+        const char* name;
+        PayoffSpec payoff;
+    } cases[] = {
+        {"european call", {PayoffType::European, true}},
+        {"european put", {PayoffType::European, false}},
+        {"asian call", {PayoffType::AsianArithmetic, true}},
+        {"geometric put", {PayoffType::AsianGeometric, false}},
+        {"lookback call", {PayoffType::LookbackFixed, true}},
+        {"floating put", {PayoffType::LookbackFloating, false}},
+    };
+    FinanceMonteCarlo mc(threads, kBenchSeed);
+    int failures = 0;
+    int checks = 0;
+    std::printf("%-18s %4s %12s %9s %10s %10s %7s %10s %10s %7s\n", "payoff", "anti", "price",
+                "price dif", "delta aad", "delta bump", "z", "vega aad", "vega bump", "z");
+    for (const auto& c : cases) {
+        OptionParams p{100.0, 95.0, 1.0, 0.03, 0.25, kValidatePaths / 4, 16};
+        p.payoff = c.payoff;
+        for (int antithetic = 0; antithetic < 2; ++antithetic) {
+            McOptions opts;
+            opts.antithetic = antithetic != 0;
+            McAadResult aad = mc.price_path_aad(p, opts);
+            LadderRung bump = mc.price_ladder(p, BumpLadder(), opts)[0];
+
+            auto z = [](const McGreekEstimate& a, const McGreekEstimate& b) {
+                return (a.value - b.value) / std::hypot(a.std_error, b.std_error);
+            };
+            double priceDiff = std::fabs(aad.price.price - bump.price.price);
+            double deltaZ = z(aad.delta, bump.delta);
+            double vegaZ = z(aad.vega, bump.vega);
+            bool ok = priceDiff <= 1e-9 * std::max(1.0, bump.price.price) &&
+                      std::fabs(deltaZ) <= kValidateSigmas && std::fabs(vegaZ) <= kValidateSigmas;
+            failures += ok ? 0 : 1;
+            ++checks;
+
+            std::printf("%-18s %4d %12.6f %9.1e %10.6f %10.6f %7.2f %10.6f %10.6f %7.2f%s\n", c.name,
+                        antithetic, aad.price.price, priceDiff, aad.delta.value, bump.delta.value,
+                        deltaZ, aad.vega.value, bump.vega.value, vegaZ, ok ? "" : "  FAIL");
+        }
+    }
+
+    // Every node of a smile, both interpolations, at queries inside the
+    // grid and in each flat extrapolation region. Queries avoid the nodes,
+    // where bilinear vols have a kink.
+    const std::vector<double> strikes = {70, 85, 100, 115, 130};
+    const std::vector<double> maturities = {0.25, 0.5, 1.0, 2.0};
+    std::vector<double> vols;
+    for (double T : maturities) {
+        for (double K : strikes) {
+            vols.push_back(0.2 + 0.3 * std::pow(std::log(K / 100), 2) + 0.02 * T);
+        }
+    }
+    const double queryK[] = {60, 77, 101, 123, 140};
+    const double queryT[] = {0.1, 0.4, 1.3, 3.0};
+    const double h = 1e-5;
+    for (VolSurface::Interpolation interpolation :
+         {VolSurface::Interpolation::Bilinear, VolSurface::Interpolation::Cubic}) {
+        VolSurface surface(strikes, maturities, vols, interpolation);
+        double maxError = 0.0;
+        std::vector<double> grad;
+        for (double K : queryK) {
+            for (double T : queryT) {
+                surface.vol_gradient(K, T, grad);
+                for (size_t n = 0; n < vols.size(); ++n) {
+                    const size_t j = n / strikes.size();
+                    const size_t i = n % strikes.size();
+                    VolSurface bumped = surface;
+                    double v = vols[n] + h;
+                    bumped.update(j, i, 1, 1, &v);
+                    double up = bumped.vol(K, T);
+                    v = vols[n] - h;
+                    bumped.update(j, i, 1, 1, &v);
+                    double down = bumped.vol(K, T);
+                    maxError = std::max(maxError, std::fabs((up - down) / (2 * h) - grad[n]));
+                }
+            }
+        }
+        bool ok = maxError <= 1e-7;
+        failures += ok ? 0 : 1;
+        ++checks;
+        std::printf("vol_gradient %-8s max error against bumped vol() %.1e%s\n",
+                    interpolation == VolSurface::Interpolation::Cubic ? "cubic" : "bilinear", maxError,
+                    ok ? "" : "  FAIL");
+    }
+    std::printf("%s: %d of %d checks failed\n", failures ? "FAILED" : "passed", failures, checks);
+    return failures ? 1 : 0;
+}
+
+// Cox-Ross-Rubinstein tree with early exercise at every step
+double binomial_american(double S, double K, double T, double r, double v, bool is_call, int steps) {
+    const double dt = T / steps;
+    const double u = std::exp(v * std::sqrt(dt));
+    const double d = 1 / u;
+    const double p = (std::exp(r * dt) - d) / (u - d);
+    const double df = std::exp(-r * dt);
+    std::vector<double> V(steps + 1);
+    for (int i = 0; i <= steps; ++i) {
+        double s = S * std::pow(u, steps - 2 * i);
+        V[i] = std::max(is_call ? s - K : K - s, 0.0);
+    }
+    for (int k = steps - 1; k >= 0; --k) {
+        double s = S * std::pow(u, k);
+        for (int i = 0; i <= k; ++i, s *= d * d) {
+            V[i] = std::max(df * (p * V[i] + (1 - p) * V[i + 1]), std::max(is_call ? s - K : K - s, 0.0));
+        }
+    }
+    return V[0];
+}
+
+// Largest absolute difference between two greeks chains, per column:
+// price, delta, gamma, theta, vega
+std::array<double, 5> max_difference(const GreeksChain& a, const GreeksChain& b) {
+    std::array<double, 5> worst{};
+    for (size_t i = 0; i < a.size(); ++i) {
+        const double diff[5] = {a.price[i] - b.price[i], a.delta[i] - b.delta[i],
+                                a.gamma[i] - b.gamma[i], a.theta[i] - b.theta[i],
+                                a.vega[i] - b.vega[i]};
+        for (int k = 0; k < 5; ++k) {
+            worst[k] = std::max(worst[k], std::fabs(diff[k]));
+        }
+    }
+    return worst;
+}
+
+// Tolerances are a few times the errors of the default grid. Returns the
+// process exit code.
+int validate_pde() {
+    int failures = 0;
+    int checks = 0;
+    auto report = [&](bool ok) {
+        failures += ok ? 0 : 1;
+        ++checks;
+        return ok ? "" : "  FAIL";
+    };
+
+    // Strikes from deep in to deep out of the money, short to long dated,
+    // low to high vol, calls and puts
+    OptionChain chain;
+    for (double K : {60.0, 80.0, 95.0, 100.0, 105.0, 120.0, 150.0}) {
+        for (double T : {0.05, 0.25, 1.0, 3.0}) {
+            for (double v : {0.1, 0.2, 0.5}) {
+                for (int is_call = 0; is_call < 2; ++is_call) {
+                    chain.push_back(OptionParams{100.0, K, T, 0.05, v, 0, 1}, is_call != 0);
+                }
+            }
+        }
+    }
+    PdeOptions opts;
+    opts.vega = true;
+    GreeksChain pde, exact;
+    pde_batch(chain, opts, pde);
+    black_scholes_batch(chain, exact);
+    const std::array<double, 5> error = max_difference(pde, exact);
+    const std::array<double, 5> tolerance = {1e-2, 5e-4, 3e-3, 1e-3, 3e-3};
+    const char* names[] = {"price", "delta", "gamma", "theta", "vega"};
+    std::printf("%zu vanillas against Black-Scholes, %d x %d grid:\n", chain.size(), opts.space_nodes,
+                opts.time_steps);
+    for (int k = 0; k < 5; ++k) {
+        std::printf("  %-6s max error %.1e (tolerance %.0e)%s\n", names[k], error[k], tolerance[k],
+                    report(error[k] <= tolerance[k]));
+    }
+
+    // Halving both steps should cut the error about four times
+    std::printf("convergence, at-the-money 1y call:\n");
+    OptionParams atm{100.0, 100.0, 1.0, 0.05, 0.2, 0, 1};
+    FinanceMonteCarlo mc(1, kBenchSeed);
+    const double atmExact = mc.black_scholes_price(atm, true);
+    double previous = 0.0;
+    for (int n = 50; n <= 800; n *= 2) {
+        PdeOptions grid;
+        grid.space_nodes = 2 * n;
+        grid.time_steps = n;
+        double e = std::fabs(mc.price_pde(atm, true, grid).price - atmExact);
+        if (previous > 0) {
+            double ratio = previous / e;
+            std::printf("  %4d x %-4d error %.2e  ratio %.2f%s\n", grid.space_nodes, grid.time_steps, e,
+                        ratio, report(ratio >= 3.5 && ratio <= 4.5));
+        } else {
+            std::printf("  %4d x %-4d error %.2e\n", grid.space_nodes, grid.time_steps, e);
+        }
+        previous = e;
+    }
+
+    // Builds differ only by FMA contraction and rounding
+    std::printf("kernel builds against %s:\n", simd_kernels().name);
+    for (SimdIsa isa : {SimdIsa::Scalar, SimdIsa::Sse2, SimdIsa::Avx2, SimdIsa::Avx512}) {
+        const SimdKernels* kernels = simd_kernels(isa);
+        if (kernels == nullptr) {
+            continue;
+        }
+        GreeksChain other;
+        pde_batch(chain, opts, other, *kernels);
+        const std::array<double, 5> diff = max_difference(other, pde);
+        double worst = *std::max_element(diff.begin(), diff.end());
+        std::printf("  %-7s max difference %.1e%s\n", kernels->name, worst, report(worst <= 1e-9));
+    }
+
+    // Early exercise: puts, where it is worth something with r > 0
+    std::printf("American puts against a 4000-step binomial tree:\n");
+    PdeOptions american;
+    american.american = true;
+    for (double K : {80.0, 100.0, 120.0}) {
+        for (double T : {0.25, 1.0, 2.0}) {
+            OptionParams p{100.0, K, T, 0.05, 0.3, 0, 1};
+            double tree = binomial_american(p.S, p.K, p.T, p.r, p.v, false, 4000);
+            double price = mc.price_pde(p, false, american).price;
+            std::printf("  K %5.1f T %4.2f  pde %9.5f  tree %9.5f  error %8.1e%s\n", K, T, price, tree,
+                        price - tree, report(std::fabs(price - tree) <= 1e-2));
+        }
+    }
+    std::printf("%s: %d of %d checks failed\n", failures ? "FAILED" : "passed", failures, checks);
+    return failures ? 1 : 0;
+}
+
+int run(int argc, char** argv) {
+    bool quick = false;
+    int reps = 5;
+    std::vector<int> threads;
+    std::vector<std::string> only;
+    std::string out_path;
+    std::string baseline_path;
+    std::string profile_path;
+    bool validate_f32 = false;
+    bool validate_aad_greeks = false;
+    bool validate_crank_nicolson = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(arg + " needs a value");
+            }
+            return argv[++i];
+        };
+        if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--reps") {
+            reps = std::max(1, std::stoi(value()));
+        } else if (arg == "--threads") {
+            for (const std::string& t : split(value(), ',')) {
+                threads.push_back(std::max(1, std::stoi(t)));
+            }
+        } else if (arg == "--kernels") {
+            only = split(value(), ',');
+        } else if (arg == "--out") {
+            out_path = value();
+        } else if (arg == "--baseline") {
+            baseline_path = value();
+        } else if (arg == "--profile") {
+            profile_path = value();
+            if (!profiling_enabled()) {
+                throw std::invalid_argument("--profile needs a build with MC_INSTRUMENT");
+            }
+        } else if (arg == "--validate-f32") {
+            validate_f32 = true;
+        } else if (arg == "--validate-aad") {
+            validate_aad_greeks = true;
+        } else if (arg == "--validate-pde") {
+            validate_crank_nicolson = true;
+        } else {
+            throw std::invalid_argument("unknown option " + arg);
+        }
+    }
+    if (validate_f32) {
+        return validate_single_precision(threads.empty() ? omp_get_max_threads() : threads.back());
+    }
+    if (validate_aad_greeks) {
+        return validate_aad(threads.empty() ? omp_get_max_threads() : threads.back());
+    }
+    if (validate_crank_nicolson) {
+        return validate_pde();
+    }
+
+    // Default thread counts: powers of two up to the core count, plus it
+    if (threads.empty()) {
+        int max_threads = omp_get_max_threads();
+        for (int t = 1; t < max_threads; t *= 2) {
+            threads.push_back(t);
+        }
+        threads.push_back(max_threads);
+    }
+    std::sort(threads.begin(), threads.end());
+    threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+
+    std::map<std::string, double> baseline;
+    if (!baseline_path.empty()) {
+        baseline = read_baseline(baseline_path);
+    }
+
+    std::vector<Measurement> results;
+    std::vector<McProfile> profiles;
+    take_profiles();
+    std::printf("kernels: %s (%d lanes), path engines: %d lanes\n", simd_kernels().name,
+                simd_kernels().lanes, VD_LANES);
+    std::printf("%-16s %-12s %10s %7s %14s %8s %7s%s\n", "kernel", "unit", "size", "threads",
+                "median/s", "cv%", "eff", baseline.empty() ? "" : "   vs base");
+    for (const Kernel& k : make_kernels()) {
+        if (!only.empty() && std::find(only.begin(), only.end(), k.name) == only.end()) {
+            continue;
+        }
+        for (long long size : quick ? k.quick_sizes : k.sizes) {
+            // Efficiency is relative to the per-thread rate at the lowest
+            // thread count measured (normally one)
+            double per_thread = 0.0;
+            for (int t : threads) {
+                Measurement m = measure(k, size, t, reps);
+                if (!profile_path.empty()) {
+                    std::vector<McProfile> calls = take_profiles();
+                    profiles.insert(profiles.end(), calls.begin(), calls.end());
+                }
+                if (t == threads.front()) {
+                    per_thread = m.median / t;
+                }
+                m.efficiency = m.median / (t * per_thread);
+                results.push_back(m);
+
+                std::printf("%-16s %-12s %10lld %7d %14.4g %8.2f %7.2f", m.kernel.c_str(), m.unit.c_str(),
+                            m.size, m.threads, m.median, 100.0 * m.stddev / m.mean, m.efficiency);
+                auto base = baseline.find(key(m.kernel, m.size, m.threads));
+                if (base != baseline.end()) {
+                    std::printf("   %8.3fx", m.median / base->second);
+                }
+                std::printf("\n");
+                std::fflush(stdout);
+            }
+        }
+    }
+
+    if (!out_path.empty()) {
+        std::FILE* out = std::fopen(out_path.c_str(), "w");
+        if (!out) {
+            throw std::runtime_error("cannot write " + out_path);
+        }
+        std::fprintf(out, "# simd=%s vector_lanes=%d max_threads=%d reps=%d\n", simd_kernels().name,
+                     VD_LANES, omp_get_max_threads(), reps);
+        std::fprintf(out, "kernel,unit,size,threads,reps,median_per_s,mean_per_s,stddev_per_s,efficiency\n");
+        for (const Measurement& m : results) {
+            std::fprintf(out, "%s,%s,%lld,%d,%d,%.6g,%.6g,%.6g,%.4f\n", m.kernel.c_str(), m.unit.c_str(),
+                         m.size, m.threads, m.reps, m.median, m.mean, m.stddev, m.efficiency);
+        }
+        std::fclose(out);
+    }
+    if (!profile_path.empty()) {
+        std::ofstream out(profile_path);
+        out << profiles_json(profiles);
+        if (!out) {
+            throw std::runtime_error("cannot write " + profile_path);
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    }
+    catch (const std::invalid_argument& e) {
+        std::fprintf(stderr, "mc_bench: %s\n", e.what());
+        usage();
+        return 2;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "mc_bench: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,49 @@
+#include "BlackScholesBatch.h"
+#include "FinanceMonteCarlo.h"
+#include "SimdKernels.h"
+
+void OptionChain::reserve(size_t n) {
+    S.reserve(n);
+    K.reserve(n);
+    T.reserve(n);
+    r.reserve(n);
+    v.reserve(n);
+    is_call.reserve(n);
+}
+
+void OptionChain::push_back(const OptionParams& p, bool call) {
+    S.push_back(p.S);
+    K.push_back(p.K);
+    T.push_back(p.T);
+    r.push_back(p.r);
+    v.push_back(p.v);
+    is_call.push_back(call ? 1 : 0);
+}
+
+void GreeksChain::resize(size_t n) {
+    price.resize(n);
+    delta.resize(n);
+    gamma.resize(n);
+    theta.resize(n);
+    vega.resize(n);
+}
+
+void black_scholes_batch(const OptionChain& in, GreeksChain& out, size_t begin, size_t end) {
+    black_scholes_batch(in, in.v.data(), out, begin, end);
+}
+
+void black_scholes_batch(const OptionChain& in, const double* vols, GreeksChain& out,
+                         size_t begin, size_t end) {
+    if (begin == end) {
+        return;
+    }
+    simd_kernels().black_scholes(&in.S[begin], &in.K[begin], &in.T[begin], &in.r[begin],
+                                 vols + begin, &in.is_call[begin], end - begin,
+                                 &out.price[begin], &out.delta[begin], &out.gamma[begin],
+                                 &out.theta[begin], &out.vega[begin]);
+}
+
+void black_scholes_batch(const OptionChain& in, GreeksChain& out) {
+    out.resize(in.size());
+    black_scholes_batch(in, out, 0, in.size());
+}
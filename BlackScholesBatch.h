@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+struct OptionParams;
+
+// Structure-of-arrays option chain. Every column has one entry per option.
+struct OptionChain {
+    std::vector<double> S;                // Spot price
+    std::vector<double> K;                // Strike price
+    std::vector<double> T;                // Time to maturity
+    std::vector<double> r;                // Risk-free rate
+    std::vector<double> v;                // Volatility
+    std::vector<unsigned char> is_call;   // 1 for calls, 0 for puts
+
+    size_t size() const { return S.size(); }
+    void reserve(size_t n);
+    void push_back(const OptionParams& p, bool call);
+};
+
+// Structure-of-arrays results, same units as the scalar black_scholes_*
+// functions (theta per calendar day, vega per vol point).
+struct GreeksChain {
+    std::vector<double> price;
+    std::vector<double> delta;
+    std::vector<double> gamma;
+    std::vector<double> theta;
+    std::vector<double> vega;
+
+    size_t size() const { return price.size(); }
+    void resize(size_t n);
+};
+
+// Prices options [begin, end) of the chain into the same slots of out, which
+// must already be sized. d1/d2 and the normal CDFs are computed once per
+// option and shared by all outputs. Holds no state, so disjoint (or even
+// overlapping read-only) ranges can be priced from any number of threads.
+void black_scholes_batch(const OptionChain& in, GreeksChain& out, size_t begin, size_t end);
+
+// As above with vols[i] in place of in.v[i], e.g. looked up from a surface
+void black_scholes_batch(const OptionChain& in, const double* vols, GreeksChain& out,
+                         size_t begin, size_t end);
+
+// Sizes out to match the chain and prices all of it on the calling thread
+void black_scholes_batch(const OptionChain& in, GreeksChain& out);
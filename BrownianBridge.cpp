@@ -0,0 +1,83 @@
+#include "BrownianBridge.h"
+#include <cmath>
+#include <stdexcept>
+
+BrownianBridge::BrownianBridge(int steps)
+    : steps_(steps), bridge_index_(steps), left_index_(steps), right_index_(steps),
+      left_weight_(steps), right_weight_(steps), std_dev_(steps) {
+    if (steps < 1) {
+        throw std::invalid_argument("BrownianBridge: needs at least one step");
+    }
+
+    // Jaeckel's construction on times t_k = k + 1, so each step has unit
+    // variance. map[k] != 0 once point k has been assigned a dimension.
+    std::vector<int> map(steps, 0);
+    map[steps - 1] = 1;
+    bridge_index_[0] = steps - 1;
+    std_dev_[0] = std::sqrt(static_cast<double>(steps));
+
+    int j = 0;
+    for (int i = 1; i < steps; ++i) {
+        while (map[j]) {
+            ++j;
+        }
+        int k = j;
+        while (!map[k]) {
+            ++k;
+        }
+        int l = j + ((k - 1 - j) >> 1);
+        map[l] = i;
+        bridge_index_[i] = l;
+        left_index_[i] = j;
+        right_index_[i] = k;
+
+        double tl = l + 1.0;
+        double tk = k + 1.0;
+        double tj = j;          // time of the left neighbour, 0 at the origin
+        left_weight_[i] = (tk - tl) / (tk - tj);
+        right_weight_[i] = (tl - tj) / (tk - tj);
+        std_dev_[i] = std::sqrt((tl - tj) * (tk - tl) / (tk - tj));
+
+        j = k + 1;
+        if (j >= steps) {
+            j = 0;
+        }
+    }
+}
+
+void BrownianBridge::build(const double* z, size_t count, double* increments) const {
+    // Build the Brownian path in place, one dimension at a time across the
+    // whole block so the inner loops run over contiguous paths
+    double* w = increments;
+    double* last = w + static_cast<size_t>(steps_ - 1) * count;
+    for (size_t p = 0; p < count; ++p) {
+        last[p] = std_dev_[0] * z[p];
+    }
+    for (int i = 1; i < steps_; ++i) {
+        const double* zi = z + static_cast<size_t>(i) * count;
+        double* wl = w + static_cast<size_t>(bridge_index_[i]) * count;
+        const double* wr = w + static_cast<size_t>(right_index_[i]) * count;
+        double lw = left_weight_[i];
+        double rw = right_weight_[i];
+        double sd = std_dev_[i];
+        if (left_index_[i] > 0) {
+            const double* wj = w + static_cast<size_t>(left_index_[i] - 1) * count;
+            for (size_t p = 0; p < count; ++p) {
+                wl[p] = lw * wj[p] + rw * wr[p] + sd * zi[p];
+            }
+        } else {
+            for (size_t p = 0; p < count; ++p) {
+                wl[p] = rw * wr[p] + sd * zi[p];
+            }
+        }
+    }
+
+    // Differences of the unit-step path are standard normal increments
+    for (int k = steps_ - 1; k > 0; --k) {
+        double* wk = w + static_cast<size_t>(k) * count;
+        const double* wprev = wk - count;
+        for (size_t p = 0; p < count; ++p) {
+            wk[p] -= wprev[p];
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Brownian-bridge construction over equally spaced steps. The first normal
+// fixes the terminal point, the next the midpoint, and so on, so the leading
+// (best-distributed) quasi-random dimensions carry most of the path's
+// variance. Output increments are standard normals in step order and can be
+// used wherever iid per-step normals would be.
+class BrownianBridge {
+public:
+    explicit BrownianBridge(int steps);
+
+    int steps() const { return steps_; }
+
+    // z and increments are steps x count, row-major: z[d * count + j] is
+    // dimension d of path j, increments[k * count + j] the normalized
+    // increment of step k of path j. The two may not alias.
+    void build(const double* z, size_t count, double* increments) const;
+
+private:
+    int steps_;
+    std::vector<int> bridge_index_;
+    std::vector<int> left_index_;
+    std::vector<int> right_index_;
+    std::vector<double> left_weight_;
+    std::vector<double> right_weight_;
+    std::vector<double> std_dev_;
+};
@@ -0,0 +1,260 @@
+#include "FinanceMonteCarlo.h"
+#include "McProfile.h"
+#include "McStatistics.h"
+#include "PathEngine.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Per-rung accumulators over sampling units. The greeks accumulate raw
+// per-unit differences of undiscounted payoffs and are scaled at the end.
+enum LadderSum {
+    kY,             // payoff at the rung's spot and the base vol
+    kYY,
+    kX,             // terminal vanilla, the control variate
+    kXX,
+    kXY,
+    kDelta,         // up - down
+    kDeltaSq,
+    kGamma,         // up - 2 mid + down
+    kGammaSq,
+    kVega,          // high vol - low vol
+    kVegaSq,
+    kNumLadderSums
+};
+
+// Spots revalued per rung at the base vol
+enum LadderLevel {
+    kMid,
+    kDown,
+    kUp,
+    kNumLevels
+};
+
+// One vol of the ladder: its GBM step and the payoffs priced off its paths
+struct VolScenario {
+    double drift;
+    double diffusion;
+    std::vector<PathPayoff> payoffs;
+};
+
+struct LadderBuffers {
+    std::vector<double> z;
+    std::vector<double> state;
+    std::vector<double> low;    // per rung and path, payoff at the low vol
+};
+
+// Undiscounted payoff of unit i; with antithetic sampling the mirror path
+// is averaged in, as in the path engine
+inline double unit_payoff(const PathPayoff& payoff, bool antithetic, const double* x,
+                          const double* acc, const double* x2, const double* acc2, size_t i,
+                          double* control) {
+    double y = payoff(x[i], acc[i], control);
+    if (antithetic) {
+        double c2;
+        y = 0.5 * (y + payoff(x2[i], acc2[i], &c2));
+        *control = 0.5 * (*control + c2);
+    }
+    return y;
+}
+
+// Adds the ladder sums of units [first, first + units) to sums, rung by
+// rung. Each tile's normals are drawn once and reused by all three vols.
+void ladder_block_sums(const VolScenario& base, const VolScenario& low, const VolScenario& high,
+                       int steps, PathAccumulator kind, bool antithetic, const CounterRng& rng,
+                       long long first, long long units, size_t tile, LadderBuffers& buf,
+                       double* sums, PhaseClock& clock) {
+    const size_t rungs = low.payoffs.size();
+    double* x = buf.state.data();
+    double* acc = x + tile;
+    double* x2 = acc + tile;
+    double* acc2 = x2 + tile;
+    double c;
+
+    for (long long t = 0; t < units; t += tile) {
+        // Dimension k of unit i uses normal i of stream k, as in the path
+        // engine, so the unshifted rung sees price_path_option's paths
+        clock.restart();
+        for (int k = 0; k < steps; ++k) {
+            rng.normals(static_cast<uint32_t>(k), first + t, &buf.z[static_cast<size_t>(k) * tile], tile);
+        }
+        clock.lap(kPhaseRng);
+        const size_t live = static_cast<size_t>(std::min(static_cast<long long>(tile), units - t));
+
+        simulate_gbm_tile(low.drift, low.diffusion, steps, kind, buf.z.data(), tile, antithetic,
+                          x, acc, x2, acc2);
+        clock.lap(kPhasePaths);
+        for (size_t r = 0; r < rungs; ++r) {
+            for (size_t i = 0; i < live; ++i) {
+                buf.low[r * tile + i] = unit_payoff(low.payoffs[r], antithetic, x, acc, x2, acc2, i, &c);
+            }
+        }
+        clock.lap(kPhasePayoff);
+
+        simulate_gbm_tile(high.drift, high.diffusion, steps, kind, buf.z.data(), tile, antithetic,
+                          x, acc, x2, acc2);
+        clock.lap(kPhasePaths);
+        for (size_t r = 0; r < rungs; ++r) {
+            double* s = sums + r * kNumLadderSums;
+            for (size_t i = 0; i < live; ++i) {
+                double d = unit_payoff(high.payoffs[r], antithetic, x, acc, x2, acc2, i, &c)
+                           - buf.low[r * tile + i];
+                s[kVega] += d;
+                s[kVegaSq] += d * d;
+            }
+        }
+        clock.lap(kPhasePayoff);
+
+        simulate_gbm_tile(base.drift, base.diffusion, steps, kind, buf.z.data(), tile, antithetic,
+                          x, acc, x2, acc2);
+        clock.lap(kPhasePaths);
+        for (size_t r = 0; r < rungs; ++r) {
+            double* s = sums + r * kNumLadderSums;
+            const PathPayoff* payoff = &base.payoffs[r * kNumLevels];
+            for (size_t i = 0; i < live; ++i) {
+                double cm, cd, cu;
+                double y = unit_payoff(payoff[kMid], antithetic, x, acc, x2, acc2, i, &cm);
+                double down = unit_payoff(payoff[kDown], antithetic, x, acc, x2, acc2, i, &cd);
+                double up = unit_payoff(payoff[kUp], antithetic, x, acc, x2, acc2, i, &cu);
+                double d = up - down;
+                double g = up - 2 * y + down;
+                s[kY] += y;
+                s[kYY] += y * y;
+                s[kX] += cm;
+                s[kXX] += cm * cm;
+                s[kXY] += cm * y;
+                s[kDelta] += d;
+                s[kDeltaSq] += d * d;
+                s[kGamma] += g;
+                s[kGammaSq] += g * g;
+            }
+        }
+        clock.lap(kPhasePayoff);
+    }
+    clock.count_block(units * (antithetic ? 2 : 1));
+}
+
+} // namespace
+
+std::vector<LadderRung> FinanceMonteCarlo::price_ladder(const OptionParams& p, const BumpLadder& ladder,
+                                                        const McOptions& opts) {
+    ProfileCall profile("price_ladder", num_threads_);
+    if (p.numSteps < 1) {
+        throw std::invalid_argument("price_ladder: numSteps must be at least 1");
+    }
+    if (p.numSamples < 2) {
+        throw std::invalid_argument("price_ladder: numSamples must be at least 2");
+    }
+    if (opts.sampler != Sampler::PseudoRandom) {
+        throw std::invalid_argument("price_ladder: only pseudo-random sampling is supported");
+    }
+    if (ladder.spot_shifts.empty()) {
+        throw std::invalid_argument("price_ladder: the ladder needs at least one rung");
+    }
+    if (!(ladder.spot_bump > 0 && ladder.spot_bump < 1) || !(ladder.vol_bump > 0 && ladder.vol_bump < p.v)) {
+        throw std::invalid_argument("price_ladder: need 0 < spot bump < 1 and 0 < vol bump < v");
+    }
+    for (double shift : ladder.spot_shifts) {
+        if (!(shift > -1)) {
+            throw std::invalid_argument("price_ladder: spot shifts must be above -1");
+        }
+    }
+
+    const size_t rungs = ladder.spot_shifts.size();
+    const int steps = p.numSteps;
+    const double dt = p.T / steps;
+    auto scenario = [&](double v) {
+        VolScenario s;
+        s.drift = (p.r - 0.5 * v * v) * dt;
+        s.diffusion = v * std::sqrt(dt);
+        return s;
+    };
+    VolScenario base = scenario(p.v);
+    VolScenario low = scenario(p.v - ladder.vol_bump);
+    VolScenario high = scenario(p.v + ladder.vol_bump);
+
+    // Payoffs carry the spot (and the barrier relative to it), so every
+    // bumped spot is just another payoff on the same log-return paths
+    std::vector<double> spots(rungs), bumps(rungs), controlMeans(rungs, 0.0);
+    for (size_t r = 0; r < rungs; ++r) {
+        spots[r] = p.S * (1 + ladder.spot_shifts[r]);
+        bumps[r] = ladder.spot_bump * spots[r];
+        OptionParams q = p;
+        q.S = spots[r];
+        base.payoffs.emplace_back(q, base.diffusion);
+        q.S = spots[r] - bumps[r];
+        base.payoffs.emplace_back(q, base.diffusion);
+        q.S = spots[r] + bumps[r];
+        base.payoffs.emplace_back(q, base.diffusion);
+        q.S = spots[r];
+        low.payoffs.emplace_back(q, low.diffusion);
+        high.payoffs.emplace_back(q, high.diffusion);
+        if (opts.control_variate) {
+            controlMeans[r] = black_scholes_price(q, p.payoff.is_call) * std::exp(p.r * p.T);
+        }
+    }
+
+    const long long perUnit = opts.antithetic ? 2 : 1;
+    const long long units = (p.numSamples + perUnit - 1) / perUnit;
+    const long long blocks = (units + kPathBlock - 1) / kPathBlock;
+    const size_t tile = tile_paths(steps);
+    const PathAccumulator kind = base.payoffs[0].accumulator;
+    std::vector<double> block_sums(static_cast<size_t>(blocks) * rungs * kNumLadderSums, 0.0);
+    ProfileRegion region;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        PhaseClock clock(region);
+        LadderBuffers buf;
+        buf.z.resize(static_cast<size_t>(steps) * tile);
+        buf.state.resize(4 * tile);
+        buf.low.resize(rungs * tile);
+
+        #pragma omp for schedule(dynamic)
+        for (long long b = 0; b < blocks; ++b) {
+            long long first = b * kPathBlock;
+            ladder_block_sums(base, low, high, steps, kind, opts.antithetic, rng_, first,
+                              std::min(kPathBlock, units - first), tile, buf,
+                              &block_sums[static_cast<size_t>(b) * rungs * kNumLadderSums], clock);
+        }
+    }
+    region.finish();
+
+    // Fold in block order so the ladder does not depend on the thread count
+    PhaseClock clock;
+    std::vector<double> sum(rungs * kNumLadderSums, 0.0);
+    for (long long b = 0; b < blocks; ++b) {
+        const double* partial = &block_sums[static_cast<size_t>(b) * rungs * kNumLadderSums];
+        for (size_t k = 0; k < sum.size(); ++k) {
+            sum[k] += partial[k];
+        }
+    }
+    clock.lap(kPhaseReduce);
+
+    const double df = std::exp(-p.r * p.T);
+    const double z_score = inv_norm_cdf(0.5 + 0.5 * opts.confidence);
+    std::vector<LadderRung> result(rungs);
+    for (size_t r = 0; r < rungs; ++r) {
+        const double* s = &sum[r * kNumLadderSums];
+        LadderRung& rung = result[r];
+        rung.spot = spots[r];
+
+        double control[] = {s[kX], s[kXX], s[kXY], controlMeans[r]};
+        McEstimate e = unit_estimate(df, static_cast<double>(units), z_score, s[kY], s[kYY],
+                                     opts.control_variate ? control : nullptr);
+        rung.price.price = e.price;
+        rung.price.std_error = e.std_error;
+        rung.price.ci_low = e.ci_low;
+        rung.price.ci_high = e.ci_high;
+        rung.price.samples = units * perUnit;
+
+        double h = bumps[r];
+        rung.delta = greek_estimate(df / (2 * h), units, s[kDelta], s[kDeltaSq]);
+        rung.gamma = greek_estimate(df / (h * h), units, s[kGamma], s[kGammaSq]);
+        rung.vega = greek_estimate(df / (2 * ladder.vol_bump * 100), units, s[kVega], s[kVegaSq]);
+    }
+    return result;
+}
@@ -0,0 +1,54 @@
+#include "CounterRng.h"
+#include "SimdKernels.h"
+#include <algorithm>
+
+namespace {
+
+// Writes values [first, first + count) of a stream that kernel produces
+// Block at a time, calling it once for every whole block in the range
+template <int Block, class Real, class Kernel>
+void fill_blocks(const Kernel& kernel, uint64_t first, Real* out, size_t count) {
+    uint64_t block = first / Block;
+    size_t skip = static_cast<size_t>(first % Block);
+    alignas(64) Real buffer[Block];
+
+    while (count > 0) {
+        if (skip == 0 && count >= static_cast<size_t>(Block)) {
+            // Every whole block in one call
+            size_t blocks = count / Block;
+            kernel(block, blocks, out);
+            out += blocks * Block;
+            count -= blocks * Block;
+            block += blocks;
+        } else {
+            // Partial block at either end of the range
+            kernel(block, 1, buffer);
+            size_t take = std::min(count, static_cast<size_t>(Block) - skip);
+            std::copy_n(buffer + skip, take, out);
+            out += take;
+            count -= take;
+            skip = 0;
+            ++block;
+        }
+    }
+}
+
+} // namespace
+
+CounterRng::CounterRng(uint64_t seed) : seed_(seed) {}
+
+void CounterRng::normals(uint32_t stream, uint64_t first, double* out, size_t count) const {
+    const SimdKernels& kernels = simd_kernels();
+    auto kernel = [&](uint64_t block, size_t blocks, double* dst) {
+        kernels.normal_blocks(seed_, stream, block, blocks, dst);
+    };
+    fill_blocks<kBlock>(kernel, first, out, count);
+}
+
+void CounterRng::normals_f32(uint32_t stream, uint64_t first, float* out, size_t count) const {
+    const SimdKernels& kernels = simd_kernels();
+    auto kernel = [&](uint64_t block, size_t blocks, float* dst) {
+        kernels.normal_blocks_f32(seed_, stream, block, blocks, dst);
+    };
+    fill_blocks<kFloatBlock>(kernel, first, out, count);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "SimdKernels.h"
+#include <cstddef>
+#include <cstdint>
+
+// Counter-based normal generator built on Philox4x32-10. Every variate is a
+// pure function of (seed, stream, index): there is no engine state to carry
+// between calls, so any thread can produce any slice of any stream and the
+// results never depend on how work was split up.
+//
+// Each Philox block yields two 53-bit uniforms which Box-Muller turns into
+// normals 2b and 2b+1 of the stream. Normals are generated kBlock at a time
+// with vectorized log/sqrt/sincos, using the SimdKernels build for this CPU.
+//
+// Single-precision normals come from the same counters in a separate
+// domain: they are independent of the double stream, not a rounding of it,
+// and each 32-bit word is a 24-bit uniform, so a block gives kFloatBlock.
+class CounterRng {
+public:
+    static constexpr int kBlock = kNormalBlock;
+    static constexpr int kFloatBlock = kFloatNormalBlock;
+
+    explicit CounterRng(uint64_t seed);
+
+    uint64_t seed() const { return seed_; }
+
+    // Writes normals [first, first + count) of the given stream to out
+    void normals(uint32_t stream, uint64_t first, double* out, size_t count) const;
+
+    // Writes single-precision normals [first, first + count) of the given
+    // stream to out
+    void normals_f32(uint32_t stream, uint64_t first, float* out, size_t count) const;
+
+private:
+    uint64_t seed_;
+};
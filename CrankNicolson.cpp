@@ -0,0 +1,271 @@
+#include "CrankNicolson.h"
+#include "BlackScholesBatch.h"
+#include "FinanceMonteCarlo.h"
+#include "SimdKernels.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Node arrays of one batch in the kernel's interleaved layout, plus the
+// per-option scalars; reused from batch to batch
+struct PdeBatch {
+    explicit PdeBatch(int nodes)
+        : n(static_cast<size_t>(nodes)), x(n * kPdeLanes), lower(n * kPdeLanes), diag(n * kPdeLanes),
+          upper(n * kPdeLanes), exercise(n * kPdeLanes), value(n * kPdeLanes), previous(n * kPdeLanes),
+          work(4 * n * kPdeLanes) {}
+
+    size_t n;
+    std::vector<double> x;          // log-spot of each node
+    std::vector<double> lower, diag, upper, exercise, value, previous, work;
+    double dt[kPdeLanes], r[kPdeLanes];
+    double lo_const[kPdeLanes], lo_df[kPdeLanes], hi_const[kPdeLanes], hi_df[kPdeLanes];
+};
+
+void validate(const PdeOptions& o) {
+    if (o.space_nodes < 5) {
+        throw std::invalid_argument("pde: space_nodes must be at least 5");
+    }
+    if (o.rannacher_steps < 0 || o.time_steps <= o.rannacher_steps) {
+        throw std::invalid_argument("pde: time_steps must exceed rannacher_steps >= 0");
+    }
+    if (!(o.width > 0) || !(o.concentration > 0)) {
+        throw std::invalid_argument("pde: width and concentration must be positive");
+    }
+}
+
+void validate(double S, double K, double T, double v) {
+    if (!(S > 0) || !(K > 0) || !(T > 0) || !(v > 0)) {
+        throw std::invalid_argument("pde: S, K, T and v must be positive");
+    }
+}
+
+// Vol bump of the vega re-solves: one vol point, or half of a smaller vol
+double vega_bump(double v) {
+    return std::min(0.01, 0.5 * v);
+}
+
+// Lays out one option on lane l: the grid is built for grid_vol and the
+// operator for vol, so bumped re-solves share the base grid. Put grids run
+// from high spot to low so that, as the kernel needs, the exercise region
+// is at the high-index end for every option.
+void setup_lane(PdeBatch& b, int l, const PdeOptions& o, double S, double K, double T, double r,
+                double grid_vol, double vol, bool is_call) {
+    const size_t n = b.n;
+    const double x0 = std::log(S);
+    const double xK = std::log(K);
+    const double sd = grid_vol * std::sqrt(T);
+    const double lo = std::min(x0, xK) - o.width * sd;
+    const double hi = std::max(x0, xK) + o.width * sd;
+
+    // x = xK + scale sinh(u) over equally spaced u: nodes are densest at
+    // the strike, where the payoff has its kink
+    const double scale = o.concentration * sd;
+    const double u0 = std::asinh((lo - xK) / scale);
+    const double u1 = std::asinh((hi - xK) / scale);
+    for (size_t i = 0; i < n; ++i) {
+        double u = u0 + (u1 - u0) * static_cast<double>(i) / static_cast<double>(n - 1);
+        const size_t node = is_call ? i : n - 1 - i;
+        b.x[node * kPdeLanes + l] = i == 0 ? lo : i == n - 1 ? hi : xK + scale * std::sinh(u);
+    }
+
+    // V_tau = s2 V_xx + mu V_x - r V with three-point differences on the
+    // uneven grid; the signed spacings make them hold in either direction
+    const double s2 = 0.5 * vol * vol;
+    const double mu = r - s2;
+    for (size_t i = 1; i + 1 < n; ++i) {
+        const size_t k = i * kPdeLanes + l;
+        const double hm = b.x[k] - b.x[k - kPdeLanes];
+        const double hp = b.x[k + kPdeLanes] - b.x[k];
+        b.lower[k] = (2 * s2 - mu * hp) / (hm * (hm + hp));
+        b.upper[k] = (2 * s2 + mu * hm) / (hp * (hm + hp));
+        b.diag[k] = -b.lower[k] - b.upper[k] - r;
+    }
+    for (size_t i : {size_t(0), n - 1}) {
+        const size_t k = i * kPdeLanes + l;
+        b.lower[k] = b.diag[k] = b.upper[k] = 0.0;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        const size_t k = i * kPdeLanes + l;
+        const double spot = std::exp(b.x[k]);
+        const double payoff = std::max(is_call ? spot - K : K - spot, 0.0);
+        b.value[k] = payoff;
+        b.exercise[k] = o.american ? payoff : -std::numeric_limits<double>::infinity();
+    }
+
+    // Far boundaries: zero on the out-of-the-money side at node 0 and the
+    // discounted forward payoff on the deep in-the-money side at the last
+    b.lo_const[l] = 0.0;
+    b.lo_df[l] = 0.0;
+    b.hi_const[l] = is_call ? std::exp(hi) : -std::exp(lo);
+    b.hi_df[l] = is_call ? -K : K;
+    b.dt[l] = T / o.time_steps;
+    b.r[l] = r;
+}
+
+// Pads lane to with a copy of lane from
+void copy_lane(PdeBatch& b, int from, int to) {
+    for (std::vector<double>* column : {&b.x, &b.lower, &b.diag, &b.upper, &b.exercise, &b.value}) {
+        for (size_t k = 0; k < b.n * kPdeLanes; k += kPdeLanes) {
+            (*column)[k + to] = (*column)[k + from];
+        }
+    }
+    for (double* column : {b.dt, b.r, b.lo_const, b.lo_df, b.hi_const, b.hi_df}) {
+        column[to] = column[from];
+    }
+}
+
+void solve(PdeBatch& b, const PdeOptions& o, const SimdKernels& kernels) {
+    PdeKernelArgs a;
+    a.nodes = static_cast<int>(b.n);
+    a.steps = o.time_steps;
+    a.rannacher_steps = o.rannacher_steps;
+    a.lower = b.lower.data();
+    a.diag = b.diag.data();
+    a.upper = b.upper.data();
+    a.exercise = b.exercise.data();
+    a.dt = b.dt;
+    a.r = b.r;
+    a.lo_const = b.lo_const;
+    a.lo_df = b.lo_df;
+    a.hi_const = b.hi_const;
+    a.hi_df = b.hi_df;
+    kernels.crank_nicolson(a, b.value.data(), b.previous.data(), b.work.data());
+}
+
+// Value and first two log-spot derivatives at x of the quadratic through
+// the three nodes of lane l around it
+void interpolate(const PdeBatch& b, int l, const std::vector<double>& values, double x, double* v,
+                 double* vx, double* vxx) {
+    const bool ascending = b.x[l] < b.x[(b.n - 1) * kPdeLanes + l];
+    size_t lo = 0, hi = b.n - 1;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if ((b.x[mid * kPdeLanes + l] <= x) == ascending) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t j = std::fabs(x - b.x[lo * kPdeLanes + l]) < std::fabs(b.x[hi * kPdeLanes + l] - x) ? lo : hi;
+    j = std::min(std::max(j, size_t(1)), b.n - 2);
+
+    const double xs[3] = {b.x[(j - 1) * kPdeLanes + l], b.x[j * kPdeLanes + l], b.x[(j + 1) * kPdeLanes + l]};
+    *v = *vx = *vxx = 0.0;
+    for (int m = 0; m < 3; ++m) {
+        const double p = xs[(m + 1) % 3];
+        const double q = xs[(m + 2) % 3];
+        const double w = values[(j - 1 + m) * kPdeLanes + l] / ((xs[m] - p) * (xs[m] - q));
+        *v += w * (x - p) * (x - q);
+        *vx += w * ((x - p) + (x - q));
+        *vxx += 2 * w;
+    }
+}
+
+// pde_batch over [begin, end) on the given kernel table
+void price_range(const OptionChain& in, const PdeOptions& opts, GreeksChain& out, size_t begin,
+                 size_t end, const SimdKernels& kernels) {
+    if (begin == end) {
+        return;
+    }
+    validate(opts);
+    for (size_t i = begin; i < end; ++i) {
+        validate(in.S[i], in.K[i], in.T[i], in.v[i]);
+    }
+    PdeBatch b(opts.space_nodes);
+
+    for (size_t first = begin; first < end; first += kPdeLanes) {
+        const int live = static_cast<int>(std::min(end - first, static_cast<size_t>(kPdeLanes)));
+        // Solves the batch with each vol moved by bumps times its vega bump
+        auto solve_at = [&](double bumps) {
+            for (int l = 0; l < live; ++l) {
+                const size_t i = first + l;
+                setup_lane(b, l, opts, in.S[i], in.K[i], in.T[i], in.r[i], in.v[i],
+                           in.v[i] + bumps * vega_bump(in.v[i]), in.is_call[i] != 0);
+            }
+            for (int l = live; l < kPdeLanes; ++l) {
+                copy_lane(b, 0, l);
+            }
+            solve(b, opts, kernels);
+        };
+
+        solve_at(0.0);
+        for (int l = 0; l < live; ++l) {
+            const size_t i = first + l;
+            const double S = in.S[i];
+            double v, vx, vxx, prev, unused;
+            interpolate(b, l, b.value, std::log(S), &v, &vx, &vxx);
+            interpolate(b, l, b.previous, std::log(S), &prev, &unused, &unused);
+            out.price[i] = v;
+            out.delta[i] = vx / S;
+            out.gamma[i] = (vxx - vx) / (S * S);
+            out.theta[i] = (prev - v) / b.dt[l] / 365.0;
+            out.vega[i] = std::numeric_limits<double>::quiet_NaN();
+        }
+        if (!opts.vega) {
+            continue;
+        }
+
+        // Central difference over the bump either side, per vol point
+        double up[kPdeLanes];
+        solve_at(1.0);
+        for (int l = 0; l < live; ++l) {
+            double vx, vxx;
+            interpolate(b, l, b.value, std::log(in.S[first + l]), &up[l], &vx, &vxx);
+        }
+        solve_at(-1.0);
+        for (int l = 0; l < live; ++l) {
+            const size_t i = first + l;
+            double down, vx, vxx;
+            interpolate(b, l, b.value, std::log(in.S[i]), &down, &vx, &vxx);
+            out.vega[i] = (up[l] - down) / (2 * vega_bump(in.v[i])) * 0.01;
+        }
+    }
+}
+
+} // namespace
+
+void pde_batch(const OptionChain& in, const PdeOptions& opts, GreeksChain& out, size_t begin, size_t end) {
+    price_range(in, opts, out, begin, end, simd_kernels());
+}
+
+void pde_batch(const OptionChain& in, const PdeOptions& opts, GreeksChain& out) {
+    out.resize(in.size());
+    price_range(in, opts, out, 0, in.size(), simd_kernels());
+}
+
+void pde_batch(const OptionChain& in, const PdeOptions& opts, GreeksChain& out,
+               const SimdKernels& kernels) {
+    out.resize(in.size());
+    price_range(in, opts, out, 0, in.size(), kernels);
+}
+
+PdeResult FinanceMonteCarlo::price_pde(const OptionParams& p, bool is_call, const PdeOptions& opts) {
+    OptionChain chain;
+    chain.push_back(p, is_call);
+    GreeksChain out;
+    pde_batch(chain, opts, out);
+    return PdeResult{out.price[0], McGreeks{out.delta[0], out.gamma[0], out.theta[0], out.vega[0]}};
+}
+
+void FinanceMonteCarlo::pde_chain(const OptionChain& chain, const PdeOptions& opts, GreeksChain& out) {
+    // Everything is checked up front: nothing may throw inside the
+    // parallel loop
+    validate(opts);
+    for (size_t i = 0; i < chain.size(); ++i) {
+        validate(chain.S[i], chain.K[i], chain.T[i], chain.v[i]);
+    }
+    const long long n = static_cast<long long>(chain.size());
+    out.resize(chain.size());
+
+    // 64 options per chunk: whole kernel batches, and few enough that the
+    // buffers are set up once per chunk rather than per batch
+    #pragma omp parallel for num_threads(num_threads_) schedule(static)
+    for (long long begin = 0; begin < n; begin += 64) {
+        pde_batch(chain, opts, out, begin, std::min(begin + 64, n));
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+struct OptionChain;
+struct GreeksChain;
+struct PdeOptions;
+struct SimdKernels;
+
+// Crank-Nicolson prices and greeks (see FinanceMonteCarlo::price_pde) of
+// options [begin, end) of the chain into the same slots of out, which must
+// already be sized. Each option is laid out on its own grid and the
+// options are stepped kPdeLanes at a time by the SIMD kernel, one lane
+// each, so every tridiagonal solve is vectorized across options; a short
+// last batch is padded with copies of its first option. Holds no state, so
+// disjoint ranges can be priced from any number of threads. Throws
+// std::invalid_argument as price_pde.
+void pde_batch(const OptionChain& in, const PdeOptions& opts, GreeksChain& out, size_t begin, size_t end);
+
+// Sizes out to match the chain and prices all of it on the calling thread
+void pde_batch(const OptionChain& in, const PdeOptions& opts, GreeksChain& out);
+
+// As above on the given kernel table instead of simd_kernels(), to check
+// the instruction sets against each other (mc_bench --validate-pde)
+void pde_batch(const OptionChain& in, const PdeOptions& opts, GreeksChain& out,
+               const SimdKernels& kernels);
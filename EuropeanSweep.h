@@ -0,0 +1,35 @@
+#pragma once
+#include "FinanceMonteCarlo.h"
+#include "SimdKernels.h"
+#include <array>
+
+// Pieces of the European sweep (FinanceMonteCarlo.cpp) shared with callers
+// that schedule its path blocks themselves (PricingService.cpp,
+// ShardedMonteCarlo.cpp). A sweep
+// draws normal i of stream 0 for sampling unit i, sums each kPathBlock of
+// units apart and folds the block sums in block order, so any split of the
+// blocks gives the same result.
+
+typedef std::array<double, kNumEuropeanSums> EuropeanSums;
+
+// Sums of sampling units [0, units) driven by the normals z
+EuropeanSums european_block_sums(const double* z, long long units, const OptionParams& p,
+                                 bool antithetic);
+
+// The same from single-precision normals (McOptions::single_precision)
+EuropeanSums european_block_sums(const float* z, long long units, const OptionParams& p,
+                                 bool antithetic);
+
+// Prices and greeks from the folded sums of the first units sampling
+// units. callBS and putBS are the control-variate means, used only when
+// opts.control_variate is set.
+MonteCarloResult european_result(const OptionParams& p, const McOptions& opts,
+                                 const EuropeanSums& sum, long long units,
+                                 double callBS, double putBS);
+
+// Sums of each block [first_block, end_block) of the pseudo-random sweep
+// over p.numSamples paths, into block_sums[b - first_block], on
+// num_threads threads
+void european_block_range(const OptionParams& p, bool antithetic, const CounterRng& rng,
+                          int num_threads, long long first_block, long long end_block,
+                          EuropeanSums* block_sums);
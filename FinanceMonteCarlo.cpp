@@ -1,124 +1,363 @@
 #define _USE_MATH_DEFINES
 #include "FinanceMonteCarlo.h"
+#include "BlackScholesBatch.h"
+#include "ImpliedVolatility.h"
+#include "EuropeanSweep.h"
+#include "McProfile.h"
+#include "McStatistics.h"
+#include "SimdKernels.h"
+#include "SobolSequence.h"
+#include "VolSurface.h"
 #include <cmath>
 #include <algorithm>
-#include <numeric>
+#include <functional>
+#include <random>
+#include <stdexcept>
 #include <vector>
-#include <thread>
 
-FinanceMonteCarlo::FinanceMonteCarlo(int num_threads) 
-    : num_threads_(num_threads) {
-    // Initialize thread-local random number generators
-    random_engines_.resize(num_threads_);
+namespace {
+
+uint64_t random_seed() {
     std::random_device rd;
-    for (auto& engine : random_engines_) {
-        engine.seed(rd());
+    return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+void set_estimate(McLegResult& leg, const McEstimate& e) {
+    leg.price = e.price;
+    leg.std_error = e.std_error;
+    leg.ci_low = e.ci_low;
+    leg.ci_high = e.ci_high;
+}
+
+// Likelihood-ratio greeks from the payoff moments sum(f), sum(f Z), sum(f Z^2)
+McGreeks likelihood_ratio_greeks(const OptionParams& p, double n, double price, double df,
+                                 double F0, double F1, double F2) {
+    double sqrtT = std::sqrt(p.T);
+    double mu = p.r - 0.5 * p.v * p.v;
+    McGreeks g;
+    g.delta = df * F1 / (p.S * p.v * sqrtT * n);
+    g.gamma = df * ((F2 - F0) / (p.S * p.S * p.v * p.v * p.T) - F1 / (p.S * p.S * p.v * sqrtT)) / n;
+    double dVdT = -p.r * price + df * ((F2 - F0) / (2 * p.T) + mu * F1 / (p.v * sqrtT)) / n;
+    g.theta = -dVdT / 365;
+    g.vega = df * ((F2 - F0) / p.v - sqrtT * F1) / (100 * n);
+    return g;
+}
+
+EuropeanKernelArgs european_args(const OptionParams& p) {
+    EuropeanKernelArgs args;
+    args.drift = (p.r - 0.5 * p.v * p.v) * p.T;
+    args.diffusion = p.v * std::sqrt(p.T);
+    args.S = p.S;
+    args.K = p.K;
+    return args;
+}
+
+} // namespace
+
+EuropeanSums european_block_sums(const double* z, long long units, const OptionParams& p,
+                                 bool antithetic) {
+    EuropeanSums sums{};
+    simd_kernels().european_sums(z, units, european_args(p), antithetic, sums.data());
+    return sums;
+}
+
+EuropeanSums european_block_sums(const float* z, long long units, const OptionParams& p,
+                                 bool antithetic) {
+    EuropeanSums sums{};
+    simd_kernels().european_sums_f32(z, units, european_args(p), antithetic, sums.data());
+    return sums;
+}
+
+MonteCarloResult european_result(const OptionParams& p, const McOptions& opts,
+                                 const EuropeanSums& sum, long long units,
+                                 double callBS, double putBS) {
+    const double perUnit = opts.antithetic ? 2.0 : 1.0;
+    double n = units * perUnit;
+    double df = std::exp(-p.r * p.T);
+    double sqrtT = std::sqrt(p.T);
+    double mu = p.r - 0.5 * p.v * p.v;
+
+    MonteCarloResult result;
+    result.samples = static_cast<long long>(n);
+
+    // Plain estimates feed the greeks so they stay consistent with the paths
+    double callPlain = df * sum[kCall] / n;
+    double putPlain = df * sum[kPut] / n;
+
+    // Each leg uses the other as its control variate, with the Black-Scholes
+    // price as the known mean. By put-call parity this is equivalent to
+    // controlling on the terminal spot.
+    double z_score = inv_norm_cdf(0.5 + 0.5 * opts.confidence);
+    double callY = sum[kCall] / perUnit;
+    double putY = sum[kPut] / perUnit;
+    double callControl[] = {putY, sum[kPutSq], sum[kCallPut], putBS / df};
+    double putControl[] = {callY, sum[kCallSq], sum[kCallPut], callBS / df};
+    set_estimate(result.call, unit_estimate(df, units, z_score, callY, sum[kCallSq],
+                                            opts.control_variate ? callControl : nullptr));
+    set_estimate(result.put, unit_estimate(df, units, z_score, putY, sum[kPutSq],
+                                           opts.control_variate ? putControl : nullptr));
+
+    // Pathwise: dST/dS = ST/S, dST/dv = ST (sqrt(T) Z - v T),
+    // dST/dT = ST (mu + v Z / (2 sqrt(T))). Gamma differentiates the
+    // pathwise delta's indicator with a likelihood-ratio weight.
+    McGreeks& cpw = result.call.pathwise;
+    cpw.delta = df * sum[kCallItmS] / (p.S * n);
+    cpw.gamma = df * p.K * sum[kCallItmZ] / (p.S * p.S * p.v * sqrtT * n);
+    cpw.vega = df * (sqrtT * sum[kCallItmSZ] - p.v * p.T * sum[kCallItmS]) / (100 * n);
+    double callDVdT = -p.r * callPlain
+                      + df * (mu * sum[kCallItmS] + p.v / (2 * sqrtT) * sum[kCallItmSZ]) / n;
+    cpw.theta = -callDVdT / 365;
+
+    McGreeks& ppw = result.put.pathwise;
+    ppw.delta = -df * sum[kPutItmS] / (p.S * n);
+    ppw.gamma = -df * p.K * sum[kPutItmZ] / (p.S * p.S * p.v * sqrtT * n);
+    ppw.vega = -df * (sqrtT * sum[kPutItmSZ] - p.v * p.T * sum[kPutItmS]) / (100 * n);
+    double putDVdT = -p.r * putPlain
+                     - df * (mu * sum[kPutItmS] + p.v / (2 * sqrtT) * sum[kPutItmSZ]) / n;
+    ppw.theta = -putDVdT / 365;
+
+    result.call.likelihood_ratio = likelihood_ratio_greeks(p, n, callPlain, df,
+                                                           sum[kCall], sum[kCallZ], sum[kCallZ2]);
+    result.put.likelihood_ratio = likelihood_ratio_greeks(p, n, putPlain, df,
+                                                          sum[kPut], sum[kPutZ], sum[kPutZ2]);
+    return result;
+}
+
+namespace {
+
+// draw(first, count, z) fills the normals of units [first, first + count),
+// in double or, for the single-precision sweep, in float
+template <class Real>
+using NormalDraw = std::function<void(long long, long long, Real*)>;
+
+// Sums of each block [first_block, end_block) of a sweep over max_units
+// sampling units, into block_sums[b - first_block]
+template <class Real>
+void european_blocks(const OptionParams& p, bool antithetic, int num_threads,
+                     long long first_block, long long end_block, long long max_units,
+                     const NormalDraw<Real>& draw, EuropeanSums* block_sums) {
+    const long long perUnit = antithetic ? 2 : 1;
+    ProfileRegion region;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        std::vector<Real> z(kPathBlock);
+        PhaseClock clock(region);
+
+        #pragma omp for schedule(dynamic)
+        for (long long b = first_block; b < end_block; ++b) {
+            long long first = b * kPathBlock;
+            long long count = std::min(kPathBlock, max_units - first);
+            clock.restart();
+            draw(first, count, z.data());
+            clock.lap(kPhaseRng);
+            block_sums[b - first_block] = european_block_sums(z.data(), count, p, antithetic);
+            clock.lap(kPhasePayoff);
+            clock.count_block(count * perUnit);
+        }
     }
 }
 
+// Runs blocks [first_block, end_block) of a sweep over max_units sampling
+// units and folds their sums into sum in block order
+template <class Real>
+void sweep_european(const OptionParams& p, bool antithetic, int num_threads,
+                    long long first_block, long long end_block, long long max_units,
+                    const NormalDraw<Real>& draw, EuropeanSums& sum) {
+    std::vector<EuropeanSums> block_sums(end_block - first_block);
+    european_blocks(p, antithetic, num_threads, first_block, end_block, max_units, draw,
+                    block_sums.data());
+    PhaseClock clock;
+    for (const EuropeanSums& partial : block_sums) {
+        for (int k = 0; k < kNumEuropeanSums; ++k) {
+            sum[k] += partial[k];
+        }
+    }
+    clock.lap(kPhaseReduce);
+}
+
+} // namespace
+
+void european_block_range(const OptionParams& p, bool antithetic, const CounterRng& rng,
+                          int num_threads, long long first_block, long long end_block,
+                          EuropeanSums* block_sums) {
+    const long long perUnit = antithetic ? 2 : 1;
+    const long long max_units = (p.numSamples + perUnit - 1) / perUnit;
+    if (first_block < 0 || end_block > (max_units + kPathBlock - 1) / kPathBlock) {
+        throw std::invalid_argument("price_european: block range outside the sweep");
+    }
+    NormalDraw<double> draw = [&rng](long long first, long long count, double* z) {
+        rng.normals(0, first, z, count);
+    };
+    european_blocks(p, antithetic, num_threads, first_block, end_block, max_units, draw, block_sums);
+}
+
+FinanceMonteCarlo::FinanceMonteCarlo(int num_threads)
+    : FinanceMonteCarlo(num_threads, random_seed()) {}
+
+FinanceMonteCarlo::FinanceMonteCarlo(int num_threads, uint64_t seed)
+    : num_threads_(num_threads), rng_(seed) {}
+
 double FinanceMonteCarlo::price_european_option(const OptionParams& p, bool is_call) {
-    double drift = (p.r - 0.5 * p.v * p.v) * p.T;
-    double diffusion = p.v * std::sqrt(p.T);
-    
-    // Load constants into SIMD registers
-    __m256d _drift = _mm256_set1_pd(drift);
-    __m256d _diffusion = _mm256_set1_pd(diffusion);
-    __m256d _S = _mm256_set1_pd(p.S);
-    __m256d _K = _mm256_set1_pd(p.K);
-    __m256d _zero = _mm256_set1_pd(0.0);
-    
-    double total_sum = 0.0;
-    
-    #pragma omp parallel num_threads(num_threads_) reduction(+:total_sum)
-    {
-        std::normal_distribution<double> normal(0.0, 1.0);
-        auto& engine = random_engines_[omp_get_thread_num()];
-        
-        // Pre-allocate arrays for SIMD operations
-        std::vector<double> z_values(4);
-        std::vector<double> payoffs(4);
-        
-        #pragma omp for schedule(dynamic, 1000)
-        for (long long i = 0; i < p.numSamples; i += 4) {
-            // Generate 4 random numbers
-            for (int j = 0; j < 4; ++j) {
-                double Z = normal(engine);
-                z_values[j] = Z;
-            }
-            
-            // Load random numbers into SIMD register
-            __m256d _Z = _mm256_loadu_pd(z_values.data());
-            
-            // Calculate stock prices using SIMD
-            __m256d _diffusionZ = _mm256_mul_pd(_diffusion, _Z);
-            __m256d _total = _mm256_add_pd(_drift, _diffusionZ);
-            __m256d _SForward = _mm256_mul_pd(_S, _mm256_exp_pd(_total));
-            
-            // Calculate payoffs
-            __m256d _payoff;
-            if (is_call) {
-                _payoff = _mm256_max_pd(_mm256_sub_pd(_SForward, _K), _zero);
-            } else {
-                _payoff = _mm256_max_pd(_mm256_sub_pd(_K, _SForward), _zero);
+    ProfileCall profile("price_european_option", num_threads_);
+    MonteCarloResult result = price_european(p);
+    return is_call ? result.call.price : result.put.price;
+}
+
+MonteCarloResult FinanceMonteCarlo::price_european(const OptionParams& p, const McOptions& opts) {
+    ProfileCall profile("price_european", num_threads_);
+    // A sampling unit is one path, or an antithetic pair sharing normal i
+    const long long perUnit = opts.antithetic ? 2 : 1;
+    const long long max_units = (p.numSamples + perUnit - 1) / perUnit;
+    const double callBS = opts.control_variate ? black_scholes_price(p, true) : 0.0;
+    const double putBS = opts.control_variate ? black_scholes_price(p, false) : 0.0;
+
+    if (opts.sampler == Sampler::Sobol) {
+        return price_european_qmc(p, opts, max_units, callBS, putBS);
+    }
+
+    const long long max_blocks = (max_units + kPathBlock - 1) / kPathBlock;
+    const bool adaptive = opts.target_std_error > 0;
+    const bool batched = adaptive || opts.progress || opts.cancel;
+    const long long batch_blocks = batched
+        ? std::max(1LL, opts.batch_size / (perUnit * kPathBlock))
+        : max_blocks;
+
+    // Unit i always uses normal i of stream 0, and block sums are folded in
+    // block order, so the result depends neither on the thread count nor on
+    // where batches end. The single-precision sweep reads the float stream.
+    NormalDraw<double> draw = [this](long long first, long long count, double* z) {
+        rng_.normals(0, first, z, count);
+    };
+    NormalDraw<float> draw_f32 = [this](long long first, long long count, float* z) {
+        rng_.normals_f32(0, first, z, count);
+    };
+    EuropeanSums sum{};
+    MonteCarloResult result{};
+    for (long long batch = 0; batch < max_blocks; batch += batch_blocks) {
+        const long long batch_end = std::min(batch + batch_blocks, max_blocks);
+        if (opts.single_precision) {
+            sweep_european(p, opts.antithetic, num_threads_, batch, batch_end, max_units, draw_f32, sum);
+        } else {
+            sweep_european(p, opts.antithetic, num_threads_, batch, batch_end, max_units, draw, sum);
+        }
+
+        long long units = std::min(batch_end * kPathBlock, max_units);
+        result = european_result(p, opts, sum, units, callBS, putBS);
+        if (opts.progress) {
+            opts.progress(result);
+        }
+        if (adaptive && std::max(result.call.std_error, result.put.std_error) <= opts.target_std_error) {
+            break;
+        }
+        if (opts.cancel && opts.cancel->load(std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    return result;
+}
+
+MonteCarloResult FinanceMonteCarlo::price_european_qmc(const OptionParams& p, const McOptions& opts,
+                                                       long long units, double callBS, double putBS) {
+    // The point budget is split over independently scrambled replicates;
+    // their spread gives the error estimate, the pooled sums the greeks
+    const int replicates = std::max(1, opts.qmc_replicates);
+    const long long units_per_rep = (units + replicates - 1) / replicates;
+    const long long blocks = (units_per_rep + kPathBlock - 1) / kPathBlock;
+    SobolSequence sobol(1);
+
+    EuropeanSums pooled{};
+    double callSum = 0, callSq = 0, putSum = 0, putSq = 0;
+    const double z_score = inv_norm_cdf(0.5 + 0.5 * opts.confidence);
+    auto pooled_result = [&](int done) {
+        MonteCarloResult result = european_result(p, opts, pooled, units_per_rep * done, callBS, putBS);
+        set_estimate(result.call, replicate_estimate(done, z_score, callSum, callSq));
+        set_estimate(result.put, replicate_estimate(done, z_score, putSum, putSq));
+        return result;
+    };
+
+    // The spread needs two replicates, so a cancelled run still finishes
+    // its second
+    int done = 0;
+    for (int rep = 0; rep < replicates; ++rep) {
+        uint64_t scramble = rng_.seed() + 0x9E3779B97F4A7C15ull * (rep + 1);
+        NormalDraw<double> draw = [&sobol, scramble](long long first, long long count, double* z) {
+            sobol.normals(scramble, static_cast<uint32_t>(first), count, z);
+        };
+        EuropeanSums sum{};
+        sweep_european(p, opts.antithetic, num_threads_, 0, blocks, units_per_rep, draw, sum);
+
+        MonteCarloResult estimate = european_result(p, opts, sum, units_per_rep, callBS, putBS);
+        callSum += estimate.call.price;
+        callSq += estimate.call.price * estimate.call.price;
+        putSum += estimate.put.price;
+        putSq += estimate.put.price * estimate.put.price;
+        for (int k = 0; k < kNumEuropeanSums; ++k) {
+            pooled[k] += sum[k];
+        }
+        done = rep + 1;
+        if (done >= 2 && done < replicates) {
+            if (opts.cancel && opts.cancel->load(std::memory_order_relaxed)) {
+                break;
             }
-            
-            // Store results and accumulate sum
-            _mm256_storeu_pd(payoffs.data(), _payoff);
-            for (int j = 0; j < 4; ++j) {
-                total_sum += payoffs[j];
+            if (opts.progress) {
+                opts.progress(pooled_result(done));
             }
         }
     }
-    
-    return std::exp(-p.r * p.T) * total_sum / p.numSamples;
-}
 
-// Global variables for Black-Scholes calculations
-double d1, d2, Nd1, Nd2;
+    MonteCarloResult result = pooled_result(done);
+    if (opts.progress) {
+        opts.progress(result);
+    }
+    return result;
+}
 
-void FinanceMonteCarlo::calculate_d1_d2(const OptionParams& p) {
+FinanceMonteCarlo::D1D2 FinanceMonteCarlo::calculate_d1_d2(const OptionParams& p) {
+    D1D2 d;
     //probability factor (D1) and a second probability factor (D2)
-    d1 = (std::log(p.S / p.K) + (p.r + 0.5 * p.v * p.v) * p.T) / (p.v * std::sqrt(p.T));
-    d2 = d1 - p.v * std::sqrt(p.T);
+    d.d1 = (std::log(p.S / p.K) + (p.r + 0.5 * p.v * p.v) * p.T) / (p.v * std::sqrt(p.T));
+    d.d2 = d.d1 - p.v * std::sqrt(p.T);
 
     // Calculate the cumulative normal distribution of d1 and d2
-    Nd1 = 0.5 * (1 + std::erf(d1 / std::sqrt(2)));
-    Nd2 = 0.5 * (1 + std::erf(d2 / std::sqrt(2)));
+    d.Nd1 = 0.5 * (1 + std::erf(d.d1 / std::sqrt(2)));
+    d.Nd2 = 0.5 * (1 + std::erf(d.d2 / std::sqrt(2)));
+    return d;
 }
 
 double FinanceMonteCarlo::black_scholes_price(const OptionParams& p, bool is_call) {
     //black-scholes formula price
-    calculate_d1_d2(p);
+    D1D2 d = calculate_d1_d2(p);
       
     if (is_call) {
-        return p.S * Nd1 - p.K * std::exp(-p.r * p.T) * Nd2;
+        return p.S * d.Nd1 - p.K * std::exp(-p.r * p.T) * d.Nd2;
     } else {
-        return p.K * std::exp(-p.r * p.T) * (1 - Nd2) - p.S * (1 - Nd1);
+        return p.K * std::exp(-p.r * p.T) * (1 - d.Nd2) - p.S * (1 - d.Nd1);
     }
 }
 
 double FinanceMonteCarlo::black_scholes_delta(const OptionParams& p, bool is_call) {
     //Delta is first derivative of options price with respect to underlying price
-    calculate_d1_d2(p);
-    return is_call ? Nd1 : Nd1 - 1;
+    D1D2 d = calculate_d1_d2(p);
+    return is_call ? d.Nd1 : d.Nd1 - 1;
 }
 
 double FinanceMonteCarlo::black_scholes_gamma(const OptionParams& p) {
     //Gamma is second derivative of options price with respect to underlying price
-    calculate_d1_d2(p);
-    return std::exp(-0.5 * d1 * d1) / (p.S * p.v * std::sqrt(2 * M_PI * p.T));
+    D1D2 d = calculate_d1_d2(p);
+    return std::exp(-0.5 * d.d1 * d.d1) / (p.S * p.v * std::sqrt(2 * M_PI * p.T));
 }
 
 double FinanceMonteCarlo::black_scholes_theta(const OptionParams& p, bool is_call) {
     //Theta is derivative of options price with respect to time 
-    calculate_d1_d2(p);
+    D1D2 d = calculate_d1_d2(p);
     
-    double theta = -p.S * p.v * std::exp(-0.5 * d1 * d1) / (2 * std::sqrt(2 * M_PI * p.T));
+    double theta = -p.S * p.v * std::exp(-0.5 * d.d1 * d.d1) / (2 * std::sqrt(2 * M_PI * p.T));
     
     if (is_call) {
-        theta -= p.r * p.K * std::exp(-p.r * p.T) * Nd2;
+        theta -= p.r * p.K * std::exp(-p.r * p.T) * d.Nd2;
     } else {
-        theta += p.r * p.K * std::exp(-p.r * p.T) * (1 - Nd2);
+        theta += p.r * p.K * std::exp(-p.r * p.T) * (1 - d.Nd2);
     }
     //Get daily theta
     return theta/365;
@@ -126,26 +365,49 @@ double FinanceMonteCarlo::black_scholes_theta(const OptionParams& p, bool is_cal
 
 double FinanceMonteCarlo::black_scholes_vega(const OptionParams& p) {
     //Vega is derivative of options price with respect to volatility
-    calculate_d1_d2(p);
+    D1D2 d = calculate_d1_d2(p);
     //calculate vega and divide by 100 to account for decimal input
-    return p.S * std::sqrt(p.T) * std::exp(-0.5 * d1 * d1) / (100 * std::sqrt(2 * M_PI));
-}
-
-double FinanceMonteCarlo::run_simulation_thread(std::function<double(std::mt19937&)> sim_func, long long samples_per_thread) {
-    std::vector<std::thread> threads;
-    std::vector<double> results(num_threads_);
-    for (int i = 0; i < num_threads_; ++i) {
-        //run simulations on different threads
-        threads.emplace_back([&, i]() {
-            double sum = 0.0;
-            for (long long j = 0; j < samples_per_thread; ++j) {
-                sum += sim_func(random_engines_[i]);
-            }
-            results[i] = sum;
-        });
+    return p.S * std::sqrt(p.T) * std::exp(-0.5 * d.d1 * d.d1) / (100 * std::sqrt(2 * M_PI));
+}
+
+void FinanceMonteCarlo::black_scholes_chain(const OptionChain& chain, GreeksChain& out) {
+    const long long n = static_cast<long long>(chain.size());
+    out.resize(chain.size());
+
+    // Contiguous slices keep each thread streaming through its own columns;
+    // 64 options per chunk is a multiple of every vector width
+    #pragma omp parallel for num_threads(num_threads_) schedule(static)
+    for (long long begin = 0; begin < n; begin += 64) {
+        black_scholes_batch(chain, out, begin, std::min(begin + 64, n));
+    }
+}
+
+void FinanceMonteCarlo::black_scholes_chain(const OptionChain& chain, const VolSurface& surface,
+                                            GreeksChain& out) {
+    const long long n = static_cast<long long>(chain.size());
+    out.resize(chain.size());
+    std::vector<double> vols(chain.size());
+
+    // Each chunk looks up its own vols just before pricing them
+    #pragma omp parallel for num_threads(num_threads_) schedule(static)
+    for (long long begin = 0; begin < n; begin += 64) {
+        long long end = std::min(begin + 64, n);
+        surface.vol(&chain.K[begin], &chain.T[begin], &vols[begin], end - begin);
+        black_scholes_batch(chain, vols.data(), out, begin, end);
     }
-    for (auto& thread : threads) {
-        thread.join();
+}
+
+void FinanceMonteCarlo::implied_volatility_chain(const OptionChain& chain, const std::vector<double>& prices,
+                                                 std::vector<double>& vols) {
+    if (prices.size() != chain.size()) {
+        throw std::invalid_argument("implied_volatility_chain: need one price per option");
+    }
+    const long long n = static_cast<long long>(chain.size());
+    vols.resize(chain.size());
+
+    // Quotes converge at different rates, so chunks are handed out dynamically
+    #pragma omp parallel for num_threads(num_threads_) schedule(dynamic)
+    for (long long begin = 0; begin < n; begin += 256) {
+        implied_volatility_batch(chain, prices.data(), vols.data(), begin, std::min(begin + 256, n));
     }
-    return std::accumulate(results.begin(), results.end(), 0.0);
 }
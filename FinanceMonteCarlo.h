@@ -1,8 +1,37 @@
 #pragma once
-#include <random>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <vector>
-#include <immintrin.h>
 #include <omp.h>
+#include "CounterRng.h"
+
+struct OptionChain;
+struct GreeksChain;
+struct BasketParams;
+struct HestonParams;
+class VolSurface;
+
+enum class PayoffType {
+    European,           // terminal vanilla
+    AsianArithmetic,    // arithmetic average of the monitored prices vs K
+    AsianGeometric,     // geometric average of the monitored prices vs K
+    UpAndOut,           // vanilla that dies if the path touches the barrier from below
+    UpAndIn,            // vanilla that only exists once the barrier is touched from below
+    DownAndOut,
+    DownAndIn,
+    LookbackFixed,      // call: max(Smax - K, 0), put: max(K - Smin, 0)
+    LookbackFloating    // call: ST - Smin, put: Smax - ST
+};
+
+// What the multi-step engine pays. Prices are monitored at each of the
+// numSteps equally spaced dates; lookbacks and barriers also see S at t = 0.
+struct PayoffSpec {
+    PayoffType type = PayoffType::European;
+    bool is_call = true;
+    double barrier = 0.0;
+    bool continuity_correction = false;   // shift the barrier to mimic continuous monitoring
+};
 
 struct OptionParams {
     double S;          // Spot price
@@ -11,14 +40,235 @@ struct OptionParams {
     double r;          // Risk-free rate
     double v;          // Volatility
     long long numSamples;  // Number of Monte Carlo samples
+    int numSteps = 1;      // Monitoring dates for path-dependent payoffs
+    PayoffSpec payoff{};   // Payoff for price_path_option
+};
+
+// Monte Carlo sensitivities, in the same units as the black_scholes_* methods
+struct McGreeks {
+    double delta;
+    double gamma;
+    double theta;
+    double vega;
+};
+
+struct McLegResult {
+    double price;
+    double std_error;           // standard error of price
+    double ci_low;              // confidence interval at McOptions::confidence
+    double ci_high;
+    McGreeks pathwise;          // gamma uses the mixed pathwise/likelihood-ratio form
+    McGreeks likelihood_ratio;
+};
+
+struct MonteCarloResult {
+    McLegResult call;
+    McLegResult put;
+    long long samples;          // paths actually simulated
+};
+
+enum class Sampler {
+    PseudoRandom,   // Philox normals
+    Sobol           // Owen-scrambled Sobol points through the inverse normal CDF
+};
+
+struct McPriceResult {
+    double price;
+    double std_error;
+    double ci_low;
+    double ci_high;
+    long long samples;          // paths actually simulated
+};
+
+// Spot ladder for bump-and-revalue greeks (price_ladder)
+struct BumpLadder {
+    std::vector<double> spot_shifts{0.0};   // relative spot shift of each rung
+    double spot_bump = 0.01;                // relative spot bump for delta and gamma
+    double vol_bump = 0.01;                 // absolute vol bump for vega
+};
+
+struct McGreekEstimate {
+    double value;
+    double std_error;
+};
+
+// Adjoint greeks of price_path_aad, in the units of black_scholes_*; rho
+// is per 1% of rate
+struct McAadResult {
+    McPriceResult price;
+    McGreekEstimate delta;
+    McGreekEstimate vega;
+    McGreekEstimate rho;
+    McGreekEstimate theta;
+
+    // With a surface: vega to each node vol, per vol point, in the layout
+    // of the surface's vols (maturities x strikes); empty otherwise
+    std::vector<McGreekEstimate> bucket_vega;
+};
+
+struct LadderRung {
+    double spot;
+    McPriceResult price;
+    McGreekEstimate delta;      // central differences, in the units of black_scholes_*
+    McGreekEstimate gamma;
+    McGreekEstimate vega;
+};
+
+struct McOptions {
+    bool antithetic = false;        // pair every path with its mirror -Z
+    bool control_variate = false;   // regress on the other leg's Black-Scholes price
+    double confidence = 0.95;       // two-sided level of ci_low/ci_high
+
+    // Adaptive mode: when > 0, paths run in batches of batch_size and the
+    // sweep stops once both legs reach this standard error (numSamples
+    // becomes the cap)
+    double target_std_error = 0.0;
+    long long batch_size = 1 << 16;
+
+    // Quasi-Monte Carlo: numSamples is split across qmc_replicates
+    // independently scrambled copies of the point set, and the standard
+    // error comes from their spread. Adaptive stopping is pseudo-random only.
+    Sampler sampler = Sampler::PseudoRandom;
+    int qmc_replicates = 16;
+
+    // Single-precision European sweep (price_european, pseudo-random only;
+    // ignored for Sobol and the other engines): normals, paths and payoffs
+    // run in float at twice the SIMD width, from the generator's float
+    // stream, while the sums are still carried in double. Prices agree with
+    // the double sweep to within the Monte Carlo error, not bit for bit.
+    bool single_precision = false;
+
+    // Progressive runs (price_european): when progress or cancel is set,
+    // paths run in batches of batch_size even without a target (Sobol runs
+    // go replicate by replicate). progress is called on the pricing thread
+    // with the running estimate after each batch; once *cancel is true the
+    // sweep stops at the next batch boundary and returns what it has.
+    std::function<void(const MonteCarloResult&)> progress;
+    const std::atomic<bool>* cancel = nullptr;
+};
+
+// Grid of the Crank-Nicolson engine (price_pde, pde_chain). Each option
+// gets its own log-spot grid spanning width standard deviations v sqrt(T)
+// beyond both the spot and the strike, with nodes packed around the strike
+// by a sinh stretch of scale concentration standard deviations (smaller is
+// tighter; large values tend to a uniform grid).
+struct PdeOptions {
+    int space_nodes = 200;      // boundaries included
+    int time_steps = 100;
+    int rannacher_steps = 2;    // leading steps split into two implicit half steps to damp the payoff kink
+    double width = 5.0;
+    double concentration = 1.0;
+    bool american = false;      // floor the value at the payoff within every step
+    bool vega = false;          // re-solve at v +/- 1 vol point (v / 2 if smaller) on the same grid
+};
+
+// Crank-Nicolson price with greeks in the units of black_scholes_*. Delta,
+// gamma and theta are read off the grid; vega is NaN unless
+// PdeOptions::vega is set.
+struct PdeResult {
+    double price;
+    McGreeks greeks;
 };
 
 class FinanceMonteCarlo {
 public:
+    // Seeds from std::random_device; pass a seed for reproducible runs
     FinanceMonteCarlo(int num_threads);
-    
-    // Monte Carlo method with OpenMP and SIMD optimizations
+    FinanceMonteCarlo(int num_threads, uint64_t seed);
+
+    uint64_t seed() const { return rng_.seed(); }
+    int num_threads() const { return num_threads_; }
+
+    // Monte Carlo method with OpenMP and SIMD optimizations. Paths are cut
+    // into fixed blocks whose sums are reduced in order, so for a given seed
+    // the price is bit-identical at any thread count.
     double price_european_option(const OptionParams& p, bool is_call);
+
+    // One sweep over the paths prices the call and the put and accumulates
+    // pathwise and likelihood-ratio estimators for all four greeks. Prices
+    // carry standard errors; see McOptions for variance reduction and
+    // adaptive stopping.
+    MonteCarloResult price_european(const OptionParams& p, const McOptions& opts = McOptions());
+
+    // Time-stepping GBM engine for p.payoff over p.numSteps dates. Paths are
+    // advanced in small structure-of-arrays blocks and payoffs accumulate on
+    // the fly, so paths are never stored. McOptions apply as for
+    // price_european; the control variate is the vanilla on the same
+    // terminal spot, with black_scholes_price as its mean. Defined in
+    // PathMonteCarlo.cpp.
+    McPriceResult price_path_option(const OptionParams& p, const McOptions& opts = McOptions());
+
+    // Longstaff-Schwartz least-squares Monte Carlo for an option exercisable
+    // at each of the p.numSteps equally spaced dates (Bermudan; use many
+    // steps to approximate American exercise). Paths are rebuilt backwards
+    // through a Brownian bridge from the counter RNG, so memory is a few
+    // doubles per path rather than a stored path grid. Supports antithetic
+    // sampling and the European as control variate; Sobol sampling and
+    // adaptive stopping are not available. Defined in AmericanMonteCarlo.cpp.
+    McPriceResult price_american(const OptionParams& p, bool is_call, const McOptions& opts = McOptions());
+
+    // European basket, spread and rainbow options on correlated GBM assets.
+    // The correlation is factored once; each tile of paths is correlated
+    // with one triangular matrix product. The control variate is the
+    // weighted basket itself. Defined in BasketMonteCarlo.cpp.
+    McPriceResult price_basket(const BasketParams& b, const McOptions& opts = McOptions());
+
+    // As price_path_option with Heston stochastic volatility (p.v is
+    // ignored), stepped with Andersen's quadratic-exponential scheme. The
+    // control variate's mean is the semi-analytic heston_price. Defined in
+    // HestonMonteCarlo.cpp.
+    McPriceResult price_heston(const OptionParams& p, const HestonParams& h,
+                               const McOptions& opts = McOptions());
+
+    // As price_path_option under the Dupire local volatility implied by the
+    // surface (p.v is ignored). Local vols are tabulated once per step on a
+    // log-spot grid. The control variate's mean is Black-Scholes at the
+    // surface's vol for (K, T). Defined in LocalVolMonteCarlo.cpp.
+    McPriceResult price_local_vol(const OptionParams& p, const VolSurface& surface,
+                                  const McOptions& opts = McOptions());
+
+    // Bump-and-revalue greeks of the price_path_option payoff at every rung
+    // of a spot ladder, from one pass over common random numbers. Each tile
+    // of normals is drawn once and simulated at v - dv, v and v + dv; all
+    // bumped spots are revalued off the same paths, since GBM log-returns
+    // do not depend on the spot. Each greek's standard error comes from its
+    // per-path differences. A rung with no shift prices exactly as
+    // price_path_option. Pseudo-random sampling only; adaptive stopping is
+    // ignored. Defined in BumpMonteCarlo.cpp.
+    std::vector<LadderRung> price_ladder(const OptionParams& p, const BumpLadder& ladder,
+                                         const McOptions& opts = McOptions());
+
+    // Adjoint (AAD) greeks of the price_path_option payoff under GBM. Each
+    // path is recorded on the calling thread's tape (AadTape.h) and swept
+    // back once, which yields delta, vega, rho and theta together for a
+    // small constant multiple of the cost of pricing; standard errors come
+    // from the per-path derivatives. Theta moves the maturity with the step
+    // count fixed. Pathwise derivatives need a payoff that is continuous in
+    // the path, so barrier payoffs throw std::invalid_argument.
+    // Pseudo-random sampling only; antithetic sampling applies, the control
+    // variate and adaptive stopping are ignored. The price uses the same
+    // normals as price_path_option. Defined in AadMonteCarlo.cpp.
+    McAadResult price_path_aad(const OptionParams& p, const McOptions& opts = McOptions());
+
+    // As above at the surface's vol for (K, T) (p.v is ignored), with the
+    // vega also split over the surface's node vols. Theta follows the
+    // surface: the vol's change with T is included, not held fixed.
+    McAadResult price_path_aad(const OptionParams& p, const VolSurface& surface,
+                               const McOptions& opts = McOptions());
+
+    // Vanilla or American option by Crank-Nicolson finite differences in
+    // log-spot, with Rannacher start-up and early exercise by projection
+    // onto the payoff (p.numSamples and p.numSteps are ignored). Far faster
+    // than Monte Carlo at equal accuracy; the error is the grid's, so no
+    // standard error is reported. Throws std::invalid_argument for a
+    // non-positive S, K, T or v or an unusable grid. Defined in
+    // CrankNicolson.cpp.
+    PdeResult price_pde(const OptionParams& p, bool is_call, const PdeOptions& opts = PdeOptions());
+
+    // As price_pde for a whole chain, solved kPdeLanes options at a time
+    // with one SIMD lane per option (see pde_batch) and split across
+    // num_threads_. Sizes out to match the chain.
+    void pde_chain(const OptionChain& chain, const PdeOptions& opts, GreeksChain& out);
     
     // Black-Scholes methods (unchanged)
     double black_scholes_price(const OptionParams& p, bool is_call);
@@ -27,13 +277,30 @@ public:
     double black_scholes_theta(const OptionParams& p, bool is_call);
     double black_scholes_vega(const OptionParams& p);
 
+    // Prices a whole SoA chain (price and all greeks) in one vectorized pass,
+    // split across num_threads_. Sizes out to match the chain.
+    void black_scholes_chain(const OptionChain& chain, GreeksChain& out);
+
+    // As above with each option's vol read from the surface at its (K, T)
+    // instead of chain.v, for pricing a chain on the smile
+    void black_scholes_chain(const OptionChain& chain, const VolSurface& surface, GreeksChain& out);
+
+    // Implied volatilities of a chain of quoted prices (see
+    // implied_volatility_batch), split across num_threads_. Sizes vols to
+    // match the chain; throws std::invalid_argument if prices does not.
+    void implied_volatility_chain(const OptionChain& chain, const std::vector<double>& prices,
+                                  std::vector<double>& vols);
+
 private:
+    struct D1D2 {
+        double d1, d2, Nd1, Nd2;
+    };
+
     int num_threads_;
-    std::vector<std::mt19937> random_engines_;
-    double d1, d2, Nd1, Nd2;
-    
-    void calculate_d1_d2(const OptionParams& p);
-};
+    CounterRng rng_;
+
+    static D1D2 calculate_d1_d2(const OptionParams& p);
 
-// Global variables for Black-Scholes calculations
-extern double d1, d2, Nd1, Nd2;
+    MonteCarloResult price_european_qmc(const OptionParams& p, const McOptions& opts,
+                                        long long units, double callBS, double putBS);
+};
@@ -0,0 +1,204 @@
+#include "HestonMonteCarlo.h"
+#include "FinanceMonteCarlo.h"
+#include "McProfile.h"
+#include "PathEngine.h"
+#include "SimdMath.h"
+#include <cmath>
+#include <algorithm>
+#include <complex>
+#include <stdexcept>
+
+namespace {
+
+typedef std::complex<double> cplx;
+
+// Andersen's switching level between the quadratic and exponential branches
+const double kPsiSwitch = 1.5;
+
+// Characteristic function of log(S_T) in the little-trap form, which keeps
+// the complex log on its principal branch for long maturities
+cplx heston_cf(cplx u, const OptionParams& p, const HestonParams& h) {
+    const cplx i(0.0, 1.0);
+    cplx beta = h.kappa - h.rho * h.xi * i * u;
+    cplx d = std::sqrt(beta * beta + h.xi * h.xi * (i * u + u * u));
+    cplx g = (beta - d) / (beta + d);
+    cplx edt = std::exp(-d * p.T);
+    cplx C = h.kappa * h.theta / (h.xi * h.xi) *
+             ((beta - d) * p.T - 2.0 * std::log((1.0 - g * edt) / (1.0 - g)));
+    cplx D = (beta - d) / (h.xi * h.xi) * (1.0 - edt) / (1.0 - g * edt);
+    return std::exp(i * u * (std::log(p.S) + p.r * p.T) + C + D * h.v0);
+}
+
+// 16-point Gauss-Legendre rule on [-1, 1], roots found by Newton iteration
+struct GaussLegendre {
+    static const int kPoints = 16;
+    double node[kPoints];
+    double weight[kPoints];
+
+    GaussLegendre() {
+        const double kPi = 3.14159265358979323846;
+        for (int k = 0; k < kPoints; ++k) {
+            double x = std::cos(kPi * (k + 0.75) / (kPoints + 0.5));
+            double dp = 0.0;
+            for (int it = 0; it < 100; ++it) {
+                double p0 = 1.0, p1 = x;
+                for (int n = 2; n <= kPoints; ++n) {
+                    double pn = ((2 * n - 1) * x * p1 - (n - 1) * p0) / n;
+                    p0 = p1;
+                    p1 = pn;
+                }
+                dp = kPoints * (x * p1 - p0) / (x * x - 1);
+                double dx = p1 / dp;
+                x -= dx;
+                if (std::abs(dx) < 1e-16) {
+                    break;
+                }
+            }
+            node[k] = x;
+            weight[k] = 2.0 / ((1 - x * x) * dp * dp);
+        }
+    }
+};
+
+// QE variance step for one vector of paths. Both branches are evaluated
+// and blended so the loop stays branch-free; the exponential branch uses
+// the same normal through 1 - U = N(-Zv).
+inline vdouble qe_variance(vdouble _V, vdouble _Zv, vdouble _theta, vdouble _E,
+                           vdouble _c1, vdouble _c2) {
+    const vdouble _one = vd_set1(1.0);
+    const vdouble _zero = vd_set1(0.0);
+    vdouble _m = vd_max(vd_fmadd(vd_sub(_V, _theta), _E, _theta), vd_set1(1e-300));
+    vdouble _s2 = vd_fmadd(_V, _c1, _c2);
+    vdouble _psi = vd_div(_s2, vd_mul(_m, _m));
+
+    // Quadratic: V' = a (b + Zv)^2, moment matched for psi <= 1.5
+    vdouble _inv = vd_div(vd_set1(2.0), _psi);
+    vdouble _b2 = vd_add(vd_sub(_inv, _one),
+                         vd_mul(vd_sqrt(_inv), vd_sqrt(vd_max(vd_sub(_inv, _one), _zero))));
+    vdouble _a = vd_div(_m, vd_add(_one, _b2));
+    vdouble _bz = vd_add(vd_sqrt(_b2), _Zv);
+    vdouble _quadratic = vd_mul(_a, vd_mul(_bz, _bz));
+
+    // Exponential: mass p at zero, exponential tail with rate beta
+    vdouble _p = vd_div(vd_sub(_psi, _one), vd_add(_psi, _one));
+    vdouble _beta = vd_div(vd_sub(_one, _p), _m);
+    vdouble _u1 = vd_max(vd_norm_cdf(vd_sub(_zero, _Zv)), vd_set1(1e-300));
+    vdouble _tail = vd_div(vd_log(vd_max(vd_div(vd_sub(_one, _p), _u1), _one)), _beta);
+
+    return vd_select(vd_gt(_psi, vd_set1(kPsiSwitch)), _tail, _quadratic);
+}
+
+} // namespace
+
+void HestonParams::validate() const {
+    if (!(kappa > 0) || !(theta > 0) || !(xi > 0) || !(v0 >= 0) || !(std::abs(rho) <= 1)) {
+        throw std::invalid_argument("HestonParams: need kappa, theta, xi > 0, v0 >= 0 and |rho| <= 1");
+    }
+}
+
+double heston_price(const OptionParams& p, const HestonParams& h, bool is_call) {
+    h.validate();
+    static const GaussLegendre gl;
+    const double kPanel = 2.0;
+    const double kMaxU = 2000.0;
+    const cplx i(0.0, 1.0);
+    const double logK = std::log(p.K);
+    const double df = std::exp(-p.r * p.T);
+
+    // C = (S - K df) / 2 + df / pi * int_0^inf Re[e^{-iu lnK}
+    // (phi(u - i) - K phi(u)) / (iu)] du, integrated panel by panel until
+    // a panel no longer contributes
+    double integral = 0.0;
+    for (double a = 0.0; a < kMaxU; a += kPanel) {
+        double panel = 0.0;
+        for (int k = 0; k < GaussLegendre::kPoints; ++k) {
+            double u = a + 0.5 * kPanel * (gl.node[k] + 1.0);
+            cplx f = std::exp(-i * u * logK) * (heston_cf(u - i, p, h) - p.K * heston_cf(u, p, h)) / (i * u);
+            panel += gl.weight[k] * f.real();
+        }
+        panel *= 0.5 * kPanel;
+        integral += panel;
+        if (std::abs(panel) < 1e-14 * (p.S + p.K)) {
+            break;
+        }
+    }
+    const double kPi = 3.14159265358979323846;
+    double call = 0.5 * (p.S - p.K * df) + df * integral / kPi;
+    return is_call ? call : call - p.S + p.K * df;
+}
+
+McPriceResult FinanceMonteCarlo::price_heston(const OptionParams& p, const HestonParams& h,
+                                              const McOptions& opts) {
+    ProfileCall profile("price_heston", num_threads_);
+    h.validate();
+    if (p.numSteps < 1) {
+        throw std::invalid_argument("price_heston: numSteps must be at least 1");
+    }
+    const double dt = p.T / p.numSteps;
+    const PathPayoff payoff(p, std::sqrt(h.v0 * dt));
+
+    // Log-spot step with Andersen's central discretization of the
+    // integrated variance (gamma1 = gamma2 = 1/2)
+    const double E = std::exp(-h.kappa * dt);
+    const double c1 = h.xi * h.xi * E * (1 - E) / h.kappa;
+    const double c2 = h.theta * h.xi * h.xi * (1 - E) * (1 - E) / (2 * h.kappa);
+    const double K0 = -h.rho * h.kappa * h.theta / h.xi * dt;
+    const double K1 = 0.5 * dt * (h.kappa * h.rho / h.xi - 0.5) - h.rho / h.xi;
+    const double K2 = 0.5 * dt * (h.kappa * h.rho / h.xi - 0.5) + h.rho / h.xi;
+    const double K3 = 0.5 * dt * (1 - h.rho * h.rho);
+    const double drift = p.r * dt + K0;
+    const int steps = p.numSteps;
+    const PathAccumulator kind = payoff.accumulator;
+    const double v0 = h.v0;
+    const double theta = h.theta;
+
+    // Row 2k of z drives the variance of step k, row 2k + 1 the spot
+    PathSimulation sim;
+    sim.dimensions = 2 * steps;
+    sim.work_per_path = 2;
+    sim.bridge = false;
+    sim.simulate = [=](const double* z, size_t tile, bool antithetic, double* x, double* acc,
+                       double* x2, double* acc2, double* work) {
+        double* V = work;
+        double* V2 = work + tile;
+        std::fill(x, x + tile, 0.0);
+        std::fill(acc, acc + tile, 0.0);
+        std::fill(x2, x2 + tile, 0.0);
+        std::fill(acc2, acc2 + tile, 0.0);
+        std::fill(V, V + 2 * tile, v0);
+        const vdouble _theta = vd_set1(theta), _E = vd_set1(E), _c1 = vd_set1(c1), _c2 = vd_set1(c2);
+        const vdouble _drift = vd_set1(drift), _K1 = vd_set1(K1), _K2 = vd_set1(K2), _K3 = vd_set1(K3);
+        const vdouble _zero = vd_set1(0.0);
+
+        for (int k = 0; k < steps; ++k) {
+            const double* zv = z + static_cast<size_t>(2 * k) * tile;
+            const double* zs = zv + tile;
+            for (int leg = 0; leg < (antithetic ? 2 : 1); ++leg) {
+                double* xl = leg ? x2 : x;
+                double* al = leg ? acc2 : acc;
+                double* Vl = leg ? V2 : V;
+                for (size_t i = 0; i < tile; i += VD_LANES) {
+                    vdouble _Zv = vd_load(zv + i);
+                    vdouble _Zs = vd_load(zs + i);
+                    if (leg) {
+                        _Zv = vd_sub(_zero, _Zv);
+                        _Zs = vd_sub(_zero, _Zs);
+                    }
+                    vdouble _V = vd_load(Vl + i);
+                    vdouble _Vn = qe_variance(_V, _Zv, _theta, _E, _c1, _c2);
+                    vdouble _var = vd_max(vd_mul(_K3, vd_add(_V, _Vn)), _zero);
+                    vdouble _x = vd_add(vd_load(xl + i), vd_fmadd(_K1, _V, vd_fmadd(_K2, _Vn, _drift)));
+                    _x = vd_fmadd(vd_sqrt(_var), _Zs, _x);
+                    vd_store(Vl + i, _Vn);
+                    vd_store(xl + i, _x);
+                    vd_store(al + i, accumulate(kind, vd_load(al + i), _x));
+                }
+            }
+        }
+    };
+
+    const double controlMean = opts.control_variate
+        ? heston_price(p, h, p.payoff.is_call) * std::exp(p.r * p.T)
+        : 0.0;
+    return run_path_engine(p, payoff, sim, controlMean, opts, rng_, num_threads_);
+}
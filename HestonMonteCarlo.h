@@ -0,0 +1,21 @@
+#pragma once
+
+struct OptionParams;
+
+// Heston dynamics: dV = kappa (theta - V) dt + xi sqrt(V) dW_v, with
+// corr(dW_v, dW_S) = rho and V(0) = v0
+struct HestonParams {
+    double kappa;   // Mean reversion speed
+    double theta;   // Long-run variance
+    double xi;      // Volatility of variance
+    double rho;     // Spot-variance correlation
+    double v0;      // Initial variance
+
+    // Throws std::invalid_argument for parameters outside the model's domain
+    void validate() const;
+};
+
+// Semi-analytic European price under Heston, from the characteristic
+// function in the "little trap" form of Albrecher et al. integrated by
+// Gauss-Legendre quadrature. Uses S, K, T and r of p; p.v is ignored.
+double heston_price(const OptionParams& p, const HestonParams& h, bool is_call);
@@ -0,0 +1,13 @@
+#include "ImpliedVolatility.h"
+#include "BlackScholesBatch.h"
+#include "SimdKernels.h"
+
+void implied_volatility_batch(const OptionChain& in, const double* prices, double* vols,
+                              size_t begin, size_t end) {
+    if (begin == end) {
+        return;
+    }
+    simd_kernels().implied_volatility(&in.S[begin], &in.K[begin], &in.T[begin], &in.r[begin],
+                                      &in.is_call[begin], prices + begin, end - begin,
+                                      vols + begin);
+}
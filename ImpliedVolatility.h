@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+struct OptionChain;
+
+// Inverts Black-Scholes for options [begin, end) of the chain: vols[i] is
+// the volatility at which option i (S, K, T, r, is_call; in.v is ignored)
+// is worth prices[i]. Quotes outside the no-arbitrage bounds, or with
+// T <= 0, get NaN. Like black_scholes_batch it holds no state, so disjoint
+// ranges can be inverted from any number of threads.
+//
+// Each quote is reduced to the out-of-the-money normalized Black price and
+// solved from the inflection point of the price in sigma sqrt(T), from
+// which Newton converges monotonically. Third-order Householder steps run
+// on the price above the inflection point and on its log below, where the
+// price is exponentially flat. Lanes iterate together until all converge.
+void implied_volatility_batch(const OptionChain& in, const double* prices, double* vols,
+                              size_t begin, size_t end);
@@ -0,0 +1,117 @@
+#include "FinanceMonteCarlo.h"
+#include "McProfile.h"
+#include "PathEngine.h"
+#include "SimdMath.h"
+#include "VolSurface.h"
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+// Log-spot nodes per step of the local vol table and their half-width in
+// at-the-money standard deviations; paths beyond it see the edge value
+const int kLocalVolNodes = 257;
+const double kLocalVolSpan = 6.0;
+
+// Dupire vol at the start of each step on a uniform log(S / S0) grid, so
+// paths look it up with one multiply and a linear blend instead of a
+// surface query per path and step
+struct LocalVolTable {
+    LocalVolTable(const OptionParams& p, const VolSurface& surface) {
+        const double dt = p.T / p.numSteps;
+        double atm = surface.vol(p.S, p.T);
+        span = std::max(kLocalVolSpan * atm * std::sqrt(p.T), 0.5);
+        inv_step = (kLocalVolNodes - 1) / (2 * span);
+        sigma.resize(static_cast<size_t>(p.numSteps) * kLocalVolNodes);
+        for (int k = 0; k < p.numSteps; ++k) {
+            for (int n = 0; n < kLocalVolNodes; ++n) {
+                double x = -span + n / inv_step;
+                sigma[static_cast<size_t>(k) * kLocalVolNodes + n] =
+                    surface.local_vol(p.S * std::exp(x), k * dt, p.S, p.r);
+            }
+        }
+    }
+
+    // out[i] = sigma at step k for log-spot x[i]
+    void lookup(int k, const double* x, size_t n, double* out) const {
+        const double* row = &sigma[static_cast<size_t>(k) * kLocalVolNodes];
+        for (size_t i = 0; i < n; ++i) {
+            double pos = std::min(std::max((x[i] + span) * inv_step, 0.0), kLocalVolNodes - 1.0);
+            int node = std::min(static_cast<int>(pos), kLocalVolNodes - 2);
+            double t = pos - node;
+            out[i] = row[node] + t * (row[node + 1] - row[node]);
+        }
+    }
+
+    double span;
+    double inv_step;
+    std::vector<double> sigma;
+};
+
+// One Euler step in log-spot for a tile of paths under their own vols
+inline void local_vol_step(const double* z, const double* sigma, size_t tile, double rdt,
+                           double sqrt_dt, bool mirror, PathAccumulator kind, double* x, double* acc) {
+    const vdouble _rdt = vd_set1(rdt);
+    const vdouble _halfDt = vd_set1(0.5 * sqrt_dt * sqrt_dt);
+    const vdouble _sqrtDt = vd_set1(mirror ? -sqrt_dt : sqrt_dt);
+    for (size_t i = 0; i < tile; i += VD_LANES) {
+        vdouble _sigma = vd_load(sigma + i);
+        vdouble _drift = vd_fnmadd(vd_mul(_sigma, _sigma), _halfDt, _rdt);
+        vdouble _x = vd_fmadd(vd_mul(_sigma, _sqrtDt), vd_load(z + i), vd_add(vd_load(x + i), _drift));
+        vd_store(x + i, _x);
+        vd_store(acc + i, accumulate(kind, vd_load(acc + i), _x));
+    }
+}
+
+} // namespace
+
+McPriceResult FinanceMonteCarlo::price_local_vol(const OptionParams& p, const VolSurface& surface,
+                                                 const McOptions& opts) {
+    ProfileCall profile("price_local_vol", num_threads_);
+    if (p.numSteps < 1) {
+        throw std::invalid_argument("price_local_vol: numSteps must be at least 1");
+    }
+    const double dt = p.T / p.numSteps;
+    const double sqrt_dt = std::sqrt(dt);
+    const double rdt = p.r * dt;
+    const int steps = p.numSteps;
+    auto table = std::make_shared<const LocalVolTable>(p, surface);
+
+    // The smile vol at the strike sets the barrier shift and, through
+    // Black-Scholes, the control's mean: a Dupire model reprices the
+    // surface's own vanillas
+    OptionParams smile = p;
+    smile.v = surface.vol(p.K, p.T);
+    const PathPayoff payoff(p, smile.v * sqrt_dt);
+    const PathAccumulator kind = payoff.accumulator;
+
+    PathSimulation sim;
+    sim.dimensions = steps;
+    sim.work_per_path = 2;
+    sim.bridge = true;
+    sim.simulate = [=](const double* z, size_t tile, bool antithetic, double* x, double* acc,
+                       double* x2, double* acc2, double* work) {
+        double* sigma = work;
+        double* sigma2 = work + tile;
+        std::fill(x, x + tile, 0.0);
+        std::fill(acc, acc + tile, 0.0);
+        std::fill(x2, x2 + tile, 0.0);
+        std::fill(acc2, acc2 + tile, 0.0);
+        for (int k = 0; k < steps; ++k) {
+            const double* zk = z + static_cast<size_t>(k) * tile;
+            table->lookup(k, x, tile, sigma);
+            local_vol_step(zk, sigma, tile, rdt, sqrt_dt, false, kind, x, acc);
+            if (antithetic) {
+                table->lookup(k, x2, tile, sigma2);
+                local_vol_step(zk, sigma2, tile, rdt, sqrt_dt, true, kind, x2, acc2);
+            }
+        }
+    };
+
+    const double controlMean = opts.control_variate
+        ? black_scholes_price(smile, p.payoff.is_call) * std::exp(p.r * p.T)
+        : 0.0;
+    return run_path_engine(p, payoff, sim, controlMean, opts, rng_, num_threads_);
+}
@@ -0,0 +1,168 @@
+#include "McProfile.h"
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <omp.h>
+
+namespace {
+
+std::mutex finished_mutex;
+std::deque<McProfile> finished;
+
+#ifdef MC_INSTRUMENT
+// The call being profiled on this thread; OpenMP workers reach it through
+// the ProfileRegion opened by the calling thread
+thread_local McProfile* current_profile = nullptr;
+#endif
+
+void append_number(std::string& out, const char* key, double value) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "\"%s\": %.9g", key, value);
+    out += buf;
+}
+
+void append_count(std::string& out, const char* key, long long value) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "\"%s\": %lld", key, value);
+    out += buf;
+}
+
+const char* const kPhaseNames[kNumPhases] = {"rng_seconds", "paths_seconds", "payoff_seconds",
+                                             "reduce_seconds"};
+
+} // namespace
+
+double McProfile::paths_per_second() const {
+    return wall_seconds > 0 ? paths / wall_seconds : 0.0;
+}
+
+double McProfile::imbalance() const {
+    double total = 0, busiest = 0;
+    for (const McThreadProfile& t : threads) {
+        double busy = t.phase_seconds[kPhaseRng] + t.phase_seconds[kPhasePaths] + t.phase_seconds[kPhasePayoff];
+        total += busy;
+        busiest = std::max(busiest, busy);
+    }
+    return total > 0 ? busiest * threads.size() / total : 1.0;
+}
+
+bool profiling_enabled() {
+#ifdef MC_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<McProfile> take_profiles() {
+    std::lock_guard<std::mutex> lock(finished_mutex);
+    std::vector<McProfile> out(finished.begin(), finished.end());
+    finished.clear();
+    return out;
+}
+
+std::string profiles_json(const std::vector<McProfile>& profiles) {
+    std::string out = "{\"profiles\": [";
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        const McProfile& p = profiles[i];
+        out += i ? ",\n  {" : "\n  {";
+        out += "\"engine\": \"" + p.engine + "\", ";
+        append_count(out, "threads", p.num_threads);
+        out += ", ";
+        append_number(out, "wall_seconds", p.wall_seconds);
+        out += ", ";
+        append_number(out, "parallel_seconds", p.parallel_seconds);
+        out += ", ";
+        append_count(out, "blocks", p.blocks);
+        out += ", ";
+        append_count(out, "paths", p.paths);
+        out += ", ";
+        append_number(out, "paths_per_second", p.paths_per_second());
+        out += ", ";
+        append_number(out, "imbalance", p.imbalance());
+        out += ", \"per_thread\": [";
+        for (size_t t = 0; t < p.threads.size(); ++t) {
+            const McThreadProfile& tp = p.threads[t];
+            out += t ? ", {" : "{";
+            append_count(out, "thread", static_cast<long long>(t));
+            for (int k = 0; k < kNumPhases; ++k) {
+                out += ", ";
+                append_number(out, kPhaseNames[k], tp.phase_seconds[k]);
+            }
+            out += ", ";
+            append_number(out, "idle_seconds", tp.idle_seconds);
+            out += ", ";
+            append_count(out, "blocks", tp.blocks);
+            out += ", ";
+            append_count(out, "paths", tp.paths);
+            out += "}";
+        }
+        out += "]}";
+    }
+    out += profiles.empty() ? "]}\n" : "\n]}\n";
+    return out;
+}
+
+#ifdef MC_INSTRUMENT
+
+ProfileCall::ProfileCall(const char* engine, int num_threads)
+    : profile_(nullptr), start_(std::chrono::steady_clock::now()) {
+    if (current_profile) {
+        return;
+    }
+    profile_ = new McProfile;
+    profile_->engine = engine;
+    profile_->num_threads = num_threads;
+    // Slot 0 also takes the calling thread's reduction time
+    profile_->threads.resize(std::max(1, num_threads));
+    current_profile = profile_;
+}
+
+ProfileCall::~ProfileCall() {
+    if (!profile_) {
+        return;
+    }
+    current_profile = nullptr;
+    McProfile& p = *profile_;
+    p.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    for (McThreadProfile& t : p.threads) {
+        double busy = t.phase_seconds[kPhaseRng] + t.phase_seconds[kPhasePaths] + t.phase_seconds[kPhasePayoff];
+        t.idle_seconds = std::max(0.0, p.parallel_seconds - busy);
+        p.blocks += t.blocks;
+        p.paths += t.paths;
+    }
+    {
+        std::lock_guard<std::mutex> lock(finished_mutex);
+        finished.push_back(std::move(p));
+        if (finished.size() > kMaxProfiles) {
+            finished.pop_front();
+        }
+    }
+    delete profile_;
+}
+
+ProfileRegion::ProfileRegion()
+    : profile_(current_profile), start_(std::chrono::steady_clock::now()), open_(true) {}
+
+void ProfileRegion::finish() {
+    if (open_ && profile_) {
+        profile_->parallel_seconds +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+    open_ = false;
+}
+
+McThreadProfile* profile_calling_thread() {
+    return current_profile ? &current_profile->threads[0] : nullptr;
+}
+
+McThreadProfile* ProfileRegion::thread() const {
+    if (!profile_) {
+        return nullptr;
+    }
+    size_t t = static_cast<size_t>(omp_get_thread_num());
+    return t < profile_->threads.size() ? &profile_->threads[t] : nullptr;
+}
+
+#endif
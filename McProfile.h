@@ -0,0 +1,151 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Hot-path instrumentation of the Monte Carlo engines. Built with
+// MC_INSTRUMENT (cmake -DMC_INSTRUMENT=ON), each top-level engine call
+// records one McProfile: wall time, per-thread phase times, blocks and
+// paths run and the idle time inside its parallel regions. Without it the
+// recorders below are empty inline classes and compile away.
+//
+// Instrumented: price_european (and price_european_option), the multi-step
+// engines behind price_path_option, price_heston and price_local_vol, and
+// price_american, price_basket, price_ladder and price_path_aad. The PDE
+// solver and the closed-form pricers are not Monte Carlo and record
+// nothing.
+
+enum McPhase {
+    kPhaseRng,      // drawing normals
+    kPhasePaths,    // stepping paths (multi-step engines)
+    kPhasePayoff,   // payoffs and block sums; the fused European kernel
+    kPhaseReduce,   // folding block sums in order, on the calling thread
+    kNumPhases
+};
+
+struct alignas(64) McThreadProfile {
+    double phase_seconds[kNumPhases] = {};
+    double idle_seconds = 0.0;  // inside parallel regions but in no phase
+    long long blocks = 0;
+    long long paths = 0;
+};
+
+struct McProfile {
+    std::string engine;
+    int num_threads = 0;
+    double wall_seconds = 0.0;
+    double parallel_seconds = 0.0;      // inside the call's parallel regions
+    long long blocks = 0;
+    long long paths = 0;
+    std::vector<McThreadProfile> threads;
+
+    double paths_per_second() const;
+
+    // Busiest thread's phase time over the mean; 1 is perfectly balanced
+    double imbalance() const;
+};
+
+// True when built with MC_INSTRUMENT
+bool profiling_enabled();
+
+// Profiles of the calls finished since the last take, oldest first. At most
+// kMaxProfiles are kept; older ones are dropped.
+std::vector<McProfile> take_profiles();
+
+const size_t kMaxProfiles = 1024;
+
+// {"profiles": [...]} with one object per call and per thread
+std::string profiles_json(const std::vector<McProfile>& profiles);
+
+#ifdef MC_INSTRUMENT
+
+// Records the engine call it lives in. Nested calls (price_european_option
+// calling price_european) count toward the outermost one.
+class ProfileCall {
+public:
+    ProfileCall(const char* engine, int num_threads);
+    ~ProfileCall();
+
+    ProfileCall(const ProfileCall&) = delete;
+    ProfileCall& operator=(const ProfileCall&) = delete;
+
+private:
+    McProfile* profile_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// One parallel region of the current call, opened on the calling thread
+// before the region and finished after it
+class ProfileRegion {
+public:
+    ProfileRegion();
+    ~ProfileRegion() { finish(); }
+
+    void finish();
+
+    // The calling OpenMP thread's slot, or null outside a profiled call
+    McThreadProfile* thread() const;
+
+private:
+    McProfile* profile_;
+    std::chrono::steady_clock::time_point start_;
+    bool open_;
+};
+
+// Slot 0 of the current call, for work on the calling thread outside any
+// parallel region; null outside a profiled call
+McThreadProfile* profile_calling_thread();
+
+// Per-thread stopwatch: lap() charges the time since the last lap (or
+// construction) to a phase
+class PhaseClock {
+public:
+    PhaseClock() : thread_(profile_calling_thread()), last_(std::chrono::steady_clock::now()) {}
+
+    explicit PhaseClock(const ProfileRegion& region)
+        : thread_(region.thread()), last_(std::chrono::steady_clock::now()) {}
+
+    void restart() { last_ = std::chrono::steady_clock::now(); }
+
+    void lap(McPhase phase) {
+        auto now = std::chrono::steady_clock::now();
+        if (thread_) {
+            thread_->phase_seconds[phase] += std::chrono::duration<double>(now - last_).count();
+        }
+        last_ = now;
+    }
+
+    void count_block(long long paths) {
+        if (thread_) {
+            ++thread_->blocks;
+            thread_->paths += paths;
+        }
+    }
+
+private:
+    McThreadProfile* thread_;
+    std::chrono::steady_clock::time_point last_;
+};
+
+#else
+
+class ProfileCall {
+public:
+    ProfileCall(const char*, int) {}
+};
+
+class ProfileRegion {
+public:
+    void finish() {}
+};
+
+class PhaseClock {
+public:
+    PhaseClock() {}
+    explicit PhaseClock(const ProfileRegion&) {}
+    void restart() {}
+    void lap(McPhase) {}
+    void count_block(long long) {}
+};
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+#include "FinanceMonteCarlo.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Estimator helpers shared by the Monte Carlo engines
+
+// Sampling units per deterministic reduction block. Each block's sums are
+// kept apart and folded in block order, so results do not depend on the
+// thread count.
+const long long kPathBlock = 4096;
+
+// Inverse standard normal CDF: Acklam's rational approximation polished with
+// one Halley step against erfc, good to full double precision
+inline double inv_norm_cdf(double p) {
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                               1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                               6.680131188771972e+01, -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                               -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                               3.754408661907416e+00};
+    double x;
+    if (p < 0.02425 || p > 0.97575) {
+        double q = std::sqrt(-2 * std::log(std::min(p, 1 - p)));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+        if (p > 0.5) {
+            x = -x;
+        }
+    } else {
+        double q = p - 0.5;
+        double r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+            (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+    }
+    double e = 0.5 * std::erfc(-x / std::sqrt(2)) - p;
+    double u = e * 2.5066282746310002 * std::exp(0.5 * x * x);
+    return x - u / (1 + 0.5 * x * u);
+}
+
+struct McEstimate {
+    double price;
+    double std_error;
+    double ci_low;
+    double ci_high;
+};
+
+// Discounted mean, standard error and confidence interval from the sums of
+// per-unit payoffs y. With a control, y is regressed on x whose undiscounted
+// mean is known: control = {sum x, sum x^2, sum x*y, E[x]}.
+inline McEstimate unit_estimate(double df, double units, double z_score,
+                                double Sy, double Syy, const double* control) {
+    double mean = Sy / units;
+    double var = (Syy - units * mean * mean) / (units - 1);
+    if (control) {
+        double meanX = control[0] / units;
+        double varX = (control[1] - units * meanX * meanX) / (units - 1);
+        double cov = (control[2] - units * meanX * mean) / (units - 1);
+        double beta = varX > 0 ? cov / varX : 0.0;
+        mean -= beta * (meanX - control[3]);
+        var -= beta * cov;
+    }
+    McEstimate e;
+    e.price = df * mean;
+    e.std_error = units > 1 ? df * std::sqrt(std::max(var, 0.0) / units)
+                            : std::numeric_limits<double>::infinity();
+    e.ci_low = e.price - z_score * e.std_error;
+    e.ci_high = e.price + z_score * e.std_error;
+    return e;
+}
+
+// A greek as scale times the mean of per-unit values, from their sum and
+// sum of squares. scale may be negative (theta as minus dV/dT), so the
+// standard error is taken as its magnitude.
+inline McGreekEstimate greek_estimate(double scale, long long units, double sum, double sq) {
+    McEstimate e = unit_estimate(scale, static_cast<double>(units), 0.0, sum, sq, nullptr);
+    return McGreekEstimate{e.price, std::fabs(e.std_error)};
+}
+
+// Mean and standard error across independent replicate estimates, given the
+// sum and sum of squares of the replicate prices
+inline McEstimate replicate_estimate(int replicates, double z_score, double sum, double sq) {
+    double mean = sum / replicates;
+    double var = replicates > 1 ? (sq - replicates * mean * mean) / (replicates - 1) : 0.0;
+    McEstimate e;
+    e.price = mean;
+    e.std_error = replicates > 1 ? std::sqrt(std::max(var, 0.0) / replicates)
+                                 : std::numeric_limits<double>::infinity();
+    e.ci_low = mean - z_score * e.std_error;
+    e.ci_high = mean + z_score * e.std_error;
+    return e;
+}
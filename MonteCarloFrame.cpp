@@ -1,4 +1,52 @@
 #include "MonteCarloFrame.h"
+#include "BlackScholesBatch.h"
+#include "HestonMonteCarlo.h"
+#include "VolSurface.h"
+#include <chrono>
+#include <fstream>
+
+namespace {
+
+// Shortest gap between partial results posted to the UI thread
+const std::chrono::milliseconds kProgressInterval(50);
+
+// Implied vol surface around the inputs. Without a market feed, quotes
+// come from a Heston model whose variance is anchored at v, which gives an
+// arbitrage-free skew; a live snapshot would replace them here.
+std::shared_ptr<const VolSurface> build_vol_surface(FinanceMonteCarlo& mc, double S, double K,
+                                                    double T, double r, double v) {
+    const int kStrikes = 20;
+    const int kMaturities = 20;
+    std::vector<double> strikes(kStrikes), maturities(kMaturities);
+    for (int i = 0; i < kStrikes; ++i) {
+        strikes[i] = K * (0.7 + 0.6 * i / (kStrikes - 1));
+    }
+    for (int j = 0; j < kMaturities; ++j) {
+        maturities[j] = T * (0.5 + 1.0 * j / (kMaturities - 1));
+    }
+
+    // Out-of-the-money quotes, maturity-major as VolSurface takes them
+    HestonParams market{2.0, v * v, 0.5, -0.7, v * v};
+    OptionChain quotes;
+    std::vector<double> prices;
+    quotes.reserve(kStrikes * kMaturities);
+    prices.reserve(kStrikes * kMaturities);
+    for (int j = 0; j < kMaturities; ++j) {
+        for (int i = 0; i < kStrikes; ++i) {
+            OptionParams q{S, strikes[i], maturities[j], r, v, 0};
+            bool call = q.K >= S;
+            quotes.push_back(q, call);
+            prices.push_back(heston_price(q, market, call));
+        }
+    }
+
+    std::vector<double> implied;
+    mc.implied_volatility_chain(quotes, prices, implied);
+    return std::make_shared<const VolSurface>(std::move(strikes), std::move(maturities), implied,
+                                              VolSurface::Interpolation::Cubic);
+}
+
+} // namespace
 
 MonteCarloFrame::MonteCarloFrame() 
     : wxFrame(nullptr, wxID_ANY, "Multi-Method Option Pricer") {
@@ -17,6 +65,10 @@ MonteCarloFrame::MonteCarloFrame()
     SetSizer(sizer.release());
 }
 
+MonteCarloFrame::~MonteCarloFrame() {
+    CancelRun();
+}
+
 void MonteCarloFrame::CreatePricingControls(wxPanel* panel) {
     wxBoxSizer* inputSizer = new wxBoxSizer(wxVERTICAL);
     stockPriceCtrl = CreateLabeledTextCtrl(panel, inputSizer, "Stock Price (S):", "100");
@@ -26,29 +78,61 @@ void MonteCarloFrame::CreatePricingControls(wxPanel* panel) {
     timeToMaturityCtrl = CreateLabeledTextCtrl(panel, inputSizer, "Time to Maturity (T):", "1");
     numSamplesCtrl = CreateLabeledTextCtrl(panel, inputSizer, "Number of Samples:", "1000000");
     numThreadsCtrl = CreateLabeledTextCtrl(panel, inputSizer, "Number of Threads:", "4");
+    targetErrorCtrl = CreateLabeledTextCtrl(panel, inputSizer, "Target Std Error (0 = off):", "0");
+
+    antitheticCheck = new wxCheckBox(panel, wxID_ANY, "Antithetic variates");
+    controlVariateCheck = new wxCheckBox(panel, wxID_ANY, "Control variate");
+    inputSizer->Add(antitheticCheck, 0, wxALL, 5);
+    sobolCheck = new wxCheckBox(panel, wxID_ANY, "Quasi-Monte Carlo (Sobol)");
+    inputSizer->Add(controlVariateCheck, 0, wxALL, 5);
+    inputSizer->Add(sobolCheck, 0, wxALL, 5);
+
+    // Any edit makes the running result stale, so it stops the run
+    for (wxTextCtrl* ctrl : {stockPriceCtrl, strikePriceCtrl, riskFreeRateCtrl, volatilityCtrl,
+                             timeToMaturityCtrl, numSamplesCtrl, numThreadsCtrl, targetErrorCtrl}) {
+        ctrl->Bind(wxEVT_TEXT, &MonteCarloFrame::OnInputChanged, this);
+    }
+    for (wxCheckBox* check : {antitheticCheck, controlVariateCheck, sobolCheck}) {
+        check->Bind(wxEVT_CHECKBOX, &MonteCarloFrame::OnInputChanged, this);
+    }
 
     wxButton* calculateButton = new wxButton(panel, wxID_ANY, "Calculate");
     calculateButton->Bind(wxEVT_BUTTON, &MonteCarloFrame::OnCalculate, this);
     inputSizer->Add(calculateButton, 0, wxALL, 5);
 
     resultsGrid = new wxGrid(panel, wxID_ANY);
-    resultsGrid->CreateGrid(6, 3);
+    resultsGrid->CreateGrid(12, 3);
     resultsGrid->SetColLabelValue(0, "Metric");
     resultsGrid->SetColLabelValue(1, "Call");
     resultsGrid->SetColLabelValue(2, "Put");
     
-    wxArrayString rowLabels = {"Monte-Carlo Price", "Black-Scholes Price", 
-                              "Delta", "Gamma", "Theta", "Vega"};
+    wxArrayString rowLabels = {"Monte-Carlo Price", "MC Std Error", "Black-Scholes Price", 
+                              "Delta", "Gamma", "Theta", "Vega",
+                              "MC Delta", "MC Gamma", "MC Theta", "MC Vega", "MC Paths"};
     for (size_t i = 0; i < rowLabels.size(); ++i) {
         resultsGrid->SetCellValue(i, 0, rowLabels[i]);
     }
     
     resultsGrid->AutoSizeColumns();
-    resultsGrid->SetMinSize(wxSize(375, 275));
+    resultsGrid->SetMinSize(wxSize(375, 450));
+
+    wxBoxSizer* resultsSizer = new wxBoxSizer(wxVERTICAL);
+    resultsSizer->Add(resultsGrid, 1, wxEXPAND);
+
+    // Where the time went in the last run, per thread
+    if (profiling_enabled()) {
+        profileText = new wxTextCtrl(panel, wxID_ANY, "", wxDefaultPosition, wxSize(375, 160),
+                                     wxTE_MULTILINE | wxTE_READONLY | wxHSCROLL);
+        profileText->SetFont(wxFont(wxFontInfo(9).Family(wxFONTFAMILY_TELETYPE)));
+        wxButton* exportButton = new wxButton(panel, wxID_ANY, "Export Profile...");
+        exportButton->Bind(wxEVT_BUTTON, &MonteCarloFrame::OnExportProfile, this);
+        resultsSizer->Add(profileText, 0, wxEXPAND | wxTOP, 10);
+        resultsSizer->Add(exportButton, 0, wxTOP, 5);
+    }
 
     wxBoxSizer* mainSizer = new wxBoxSizer(wxHORIZONTAL);
     mainSizer->Add(inputSizer, 0, wxALL, 10);
-    mainSizer->Add(resultsGrid, 1, wxEXPAND | wxALL, 10);
+    mainSizer->Add(resultsSizer, 1, wxEXPAND | wxALL, 10);
 
     panel->SetSizer(mainSizer);
 }
@@ -64,6 +148,7 @@ wxTextCtrl* MonteCarloFrame::CreateLabeledTextCtrl(wxWindow* parent, wxSizer* si
 }
 
 void MonteCarloFrame::OnCalculate(wxCommandEvent& event) {
+    CancelRun();
     try {
         double S = wxAtof(stockPriceCtrl->GetValue());
         double K = wxAtof(strikePriceCtrl->GetValue());
@@ -73,42 +158,162 @@ void MonteCarloFrame::OnCalculate(wxCommandEvent& event) {
         long long numSamples = wxAtoi(numSamplesCtrl->GetValue());
         int numThreads = wxAtoi(numThreadsCtrl->GetValue());
 
-        FinanceMonteCarlo mc(numThreads);
+        McOptions options;
+        options.antithetic = antitheticCheck->GetValue();
+        options.control_variate = controlVariateCheck->GetValue();
+        options.target_std_error = wxAtof(targetErrorCtrl->GetValue());
+        options.sampler = sobolCheck->GetValue() ? Sampler::Sobol : Sampler::PseudoRandom;
+
+        // Keep the engine, and with it the seed, unless the thread count changes
+        if (!mc_ || numThreads != mcThreads_) {
+            mc_ = std::make_unique<FinanceMonteCarlo>(numThreads);
+            mcThreads_ = numThreads;
+        }
         OptionParams params{S, K, T, r, v, numSamples};
 
-        double callPrice = mc.price_european_option(params, true);
-        double putPrice = mc.price_european_option(params, false);
-        double callPriceBS = mc.black_scholes_price(params, true);
-        double putPriceBS = mc.black_scholes_price(params, false);
-        double callDelta = mc.black_scholes_delta(params, true);
-        double putDelta = mc.black_scholes_delta(params, false);
-        double gamma = mc.black_scholes_gamma(params);
-        double callTheta = mc.black_scholes_theta(params, true);
-        double putTheta = mc.black_scholes_theta(params, false);
-        double vega = mc.black_scholes_vega(params);
-
-        UpdateGridCell(0, 1, callPrice);
-        UpdateGridCell(0, 2, putPrice);
-        UpdateGridCell(1, 1, callPriceBS);
-        UpdateGridCell(1, 2, putPriceBS);
-        UpdateGridCell(2, 1, callDelta);
-        UpdateGridCell(2, 2, putDelta);
-        UpdateGridCell(3, 1, gamma);
-        UpdateGridCell(3, 2, gamma);
-        UpdateGridCell(4, 1, callTheta);
-        UpdateGridCell(4, 2, putTheta);
-        UpdateGridCell(5, 1, vega);
-        UpdateGridCell(5, 2, vega);
-
-        resultsGrid->AutoSizeColumns();
-        
-        vol_panel_->UpdateSurface(S, K, T, v);
+        // Call and put share one closed-form pass; it is cheap enough to
+        // show before the simulation starts
+        OptionChain chain;
+        chain.push_back(params, true);
+        chain.push_back(params, false);
+        GreeksChain bs;
+        black_scholes_batch(chain, bs);
+        for (int row = 0; row < resultsGrid->GetNumberRows(); ++row) {
+            for (int col = 1; col <= 2; ++col) {
+                resultsGrid->SetCellValue(row, col, "");
+            }
+        }
+        for (int col = 1; col <= 2; ++col) {
+            UpdateGridCell(2, col, bs.price[col - 1]);
+            UpdateGridCell(3, col, bs.delta[col - 1]);
+            UpdateGridCell(4, col, bs.gamma[col - 1]);
+            UpdateGridCell(5, col, bs.theta[col - 1]);
+            UpdateGridCell(6, col, bs.vega[col - 1]);
+        }
+
+        // Call, put and Monte Carlo greeks all come from one path sweep on
+        // the worker, which posts the running estimate back at most every
+        // kProgressInterval; the vol surface follows once pricing is done
+        const unsigned generation = ++generation_;
+        cancel_ = false;
+        FinanceMonteCarlo* mc = mc_.get();
+        worker_ = std::thread([this, mc, params, options, generation]() mutable {
+            auto last = std::chrono::steady_clock::now() - kProgressInterval;
+            options.cancel = &cancel_;
+            options.progress = [&](const MonteCarloResult& partial) {
+                auto now = std::chrono::steady_clock::now();
+                if (now - last >= kProgressInterval) {
+                    last = now;
+                    CallAfter([this, generation, partial]() { ShowProgress(generation, partial, false); });
+                }
+            };
+            try {
+                take_profiles();
+                MonteCarloResult result = mc->price_european(params, options);
+                CallAfter([this, generation, result]() { ShowProgress(generation, result, true); });
+                if (profiling_enabled()) {
+                    std::vector<McProfile> profiles = take_profiles();
+                    CallAfter([this, generation, profiles]() { ShowProfiles(generation, profiles); });
+                }
+                if (!cancel_) {
+                    auto surface = build_vol_surface(*mc, params.S, params.K, params.T, params.r, params.v);
+                    CallAfter([this, generation, surface]() { ShowSurface(generation, surface); });
+                }
+            }
+            catch (const std::exception& e) {
+                wxString message(e.what());
+                CallAfter([this, generation, message]() { ShowError(generation, message); });
+            }
+        });
     }
     catch (const std::exception& e) {
         wxMessageBox(e.what(), "Error", wxOK | wxICON_ERROR);
     }
 }
 
+void MonteCarloFrame::OnInputChanged(wxCommandEvent& event) {
+    CancelRun();
+    event.Skip();
+}
+
+void MonteCarloFrame::CancelRun() {
+    if (!worker_.joinable()) {
+        return;
+    }
+    // The sweep stops at its next batch boundary; bumping the generation
+    // drops whatever it already posted
+    cancel_ = true;
+    worker_.join();
+    ++generation_;
+}
+
+void MonteCarloFrame::ShowProgress(unsigned generation, const MonteCarloResult& result, bool final) {
+    if (generation != generation_) {
+        return;
+    }
+    for (int col = 1; col <= 2; ++col) {
+        const McLegResult& leg = col == 1 ? result.call : result.put;
+        UpdateGridCell(0, col, leg.price);
+        UpdateGridCell(1, col, leg.std_error);
+        UpdateGridCell(7, col, leg.pathwise.delta);
+        UpdateGridCell(8, col, leg.pathwise.gamma);
+        UpdateGridCell(9, col, leg.pathwise.theta);
+        UpdateGridCell(10, col, leg.pathwise.vega);
+    }
+    resultsGrid->SetCellValue(11, 1, wxString::Format("%lld", result.samples));
+    resultsGrid->SetCellValue(11, 2, final ? "done" : "running");
+    resultsGrid->AutoSizeColumns();
+}
+
+void MonteCarloFrame::ShowSurface(unsigned generation, std::shared_ptr<const VolSurface> surface) {
+    if (generation != generation_) {
+        return;
+    }
+    vol_panel_->UpdateSurface(*surface);
+}
+
+void MonteCarloFrame::ShowError(unsigned generation, const wxString& message) {
+    if (generation != generation_) {
+        return;
+    }
+    wxMessageBox(message, "Error", wxOK | wxICON_ERROR);
+}
+
+void MonteCarloFrame::ShowProfiles(unsigned generation, const std::vector<McProfile>& profiles) {
+    if (generation != generation_ || !profileText) {
+        return;
+    }
+    profiles_ = profiles;
+    wxString text;
+    for (const McProfile& p : profiles) {
+        text += wxString::Format("%s: %.3f s, %.3g paths/s, %lld blocks, imbalance %.2f\n",
+                                 p.engine, p.wall_seconds, p.paths_per_second(), p.blocks, p.imbalance());
+        text += "thread     rng ms  paths ms payoff ms   idle ms  blocks\n";
+        for (size_t t = 0; t < p.threads.size(); ++t) {
+            const McThreadProfile& tp = p.threads[t];
+            text += wxString::Format("%6zu %9.1f %9.1f %9.1f %9.1f %7lld\n", t,
+                                     1e3 * tp.phase_seconds[kPhaseRng], 1e3 * tp.phase_seconds[kPhasePaths],
+                                     1e3 * tp.phase_seconds[kPhasePayoff], 1e3 * tp.idle_seconds, tp.blocks);
+        }
+        text += wxString::Format("reduce %.1f ms on the calling thread\n",
+                                 1e3 * p.threads[0].phase_seconds[kPhaseReduce]);
+    }
+    profileText->SetValue(text);
+}
+
+void MonteCarloFrame::OnExportProfile(wxCommandEvent& event) {
+    wxFileDialog dialog(this, "Export profile", "", "profile.json", "JSON files (*.json)|*.json",
+                        wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (dialog.ShowModal() != wxID_OK) {
+        return;
+    }
+    std::ofstream out(dialog.GetPath().ToStdString());
+    out << profiles_json(profiles_);
+    if (!out) {
+        wxMessageBox("Cannot write " + dialog.GetPath(), "Error", wxOK | wxICON_ERROR);
+    }
+}
+
 void MonteCarloFrame::UpdateGridCell(int row, int col, double value) {
     resultsGrid->SetCellValue(row, col, wxString::Format("%.6f", value));
 }
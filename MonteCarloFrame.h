@@ -2,23 +2,52 @@
 #include <wx/wx.h>
 #include <wx/grid.h>
 #include <wx/notebook.h>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include "FinanceMonteCarlo.h"
-#include "volatility_surface.h"
+#include "McProfile.h"
+#include "VolatilitySurface.h"
+
+class VolSurface;
 
 class MonteCarloFrame : public wxFrame {
 public:
     MonteCarloFrame();
+    ~MonteCarloFrame();
 
 private:
     void CreatePricingControls(wxPanel* panel);
     wxTextCtrl* CreateLabeledTextCtrl(wxWindow* parent, wxSizer* sizer, 
                                      const wxString& label, const wxString& value);
     void OnCalculate(wxCommandEvent& event);
+    void OnInputChanged(wxCommandEvent& event);
+    void OnExportProfile(wxCommandEvent& event);
+    void CancelRun();
     void UpdateGridCell(int row, int col, double value);
 
+    // Called on the UI thread with results posted by the worker; stale
+    // generations are dropped
+    void ShowProgress(unsigned generation, const MonteCarloResult& result, bool final);
+    void ShowSurface(unsigned generation, std::shared_ptr<const VolSurface> surface);
+    void ShowError(unsigned generation, const wxString& message);
+    void ShowProfiles(unsigned generation, const std::vector<McProfile>& profiles);
+
     std::unique_ptr<wxNotebook> notebook_;
     std::unique_ptr<VolatilitySurfacePanel> vol_panel_;
     wxTextCtrl *stockPriceCtrl, *strikePriceCtrl, *riskFreeRateCtrl, 
-               *volatilityCtrl, *timeToMaturityCtrl, *numSamplesCtrl, *numThreadsCtrl;
+               *volatilityCtrl, *timeToMaturityCtrl, *numSamplesCtrl, *numThreadsCtrl,
+               *targetErrorCtrl;
+    wxCheckBox *antitheticCheck, *controlVariateCheck, *sobolCheck;
     wxGrid* resultsGrid;
+    wxTextCtrl* profileText = nullptr;     // only in MC_INSTRUMENT builds
+    std::vector<McProfile> profiles_;      // of the last finished run
+
+    // Pricing runs on one background thread at a time against an engine
+    // kept across runs; it is rebuilt only when the thread count changes
+    std::unique_ptr<FinanceMonteCarlo> mc_;
+    int mcThreads_ = 0;
+    std::thread worker_;
+    std::atomic<bool> cancel_{false};
+    unsigned generation_ = 0;
 };
@@ -0,0 +1,181 @@
+#pragma once
+#include "FinanceMonteCarlo.h"
+#include "McStatistics.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Shared machinery of the multi-step engines (GBM in PathMonteCarlo.cpp,
+// Heston in HestonMonteCarlo.cpp, local vol in LocalVolMonteCarlo.cpp). A
+// model only supplies how a tile of paths advances; payoffs, tiling,
+// blocking, sampling and estimators live here and in PathMonteCarlo.cpp.
+// The basket engine (BasketMonteCarlo.cpp) uses the tiling and run_sampling
+// directly, and the AAD engine (AadMonteCarlo.cpp) the tiling.
+
+// What each path carries besides its log-spot, in units of log(S / S0)
+enum PathAccumulator {
+    kNoAccumulator,
+    kSumSpot,       // sum of S_k / S0, arithmetic Asian
+    kSumLog,        // sum of log(S_k / S0), geometric Asian
+    kRunningMax,    // max of log(S_k / S0), including t = 0
+    kRunningMin
+};
+
+inline vdouble accumulate(PathAccumulator kind, vdouble _acc, vdouble _x) {
+    switch (kind) {
+    case kSumSpot:
+        return vd_add(_acc, vd_exp(_x));
+    case kSumLog:
+        return vd_add(_acc, _x);
+    case kRunningMax:
+        return vd_max(_acc, _x);
+    case kRunningMin:
+        return vd_min(_acc, _x);
+    default:
+        return _acc;
+    }
+}
+
+// Per-block sums of a path sweep: the payoff, the terminal vanilla used as
+// a control variate and their products (PathMonteCarlo.cpp)
+const int kNumPathSums = 5;
+typedef std::array<double, kNumPathSums> PathSums;
+
+// Maps a path's final log-spot and accumulator to its payoff
+struct PathPayoff {
+    // step_vol is the per-step volatility used for the barrier continuity
+    // correction. Throws std::invalid_argument for a barrier without level.
+    PathPayoff(const OptionParams& p, double step_vol);
+
+    // Undiscounted payoff; control receives the vanilla on the same
+    // terminal spot
+    double operator()(double x, double acc, double* control) const;
+
+    // Undiscounted payoff and its partial derivatives in x, acc and the spot
+    // S, for pathwise adjoints. At a kink the derivative is one-sided: an
+    // option exactly at the money contributes zero. Barrier payoffs jump
+    // where the path touches the barrier and have no pathwise derivative;
+    // they throw std::invalid_argument.
+    double gradient(double x, double acc, double* dx, double* dacc, double* dS) const;
+
+    double S;
+    double K;
+    int steps;
+    PayoffSpec spec;
+    PathAccumulator accumulator;
+    double log_barrier;     // log(H / S0), shifted when continuity corrected
+};
+
+// Advances every path of a tile through all steps. z is [dimension][path]
+// with tile paths per dimension; x and acc receive each path's final
+// log-spot and accumulator, x2 and acc2 those of the antithetic mirror
+// (normals negated) when antithetic is set. work has work_per_path * tile
+// doubles of per-thread scratch.
+typedef std::function<void(const double* z, size_t tile, bool antithetic, double* x, double* acc,
+                           double* x2, double* acc2, double* work)> TileSimulator;
+
+// Paths per tile: as many as fit a cache-sized tile of normals, a multiple
+// of the Philox block and of the vector width
+size_t tile_paths(int dimensions);
+
+// Drives a block sweep under opts. Under Sobol it runs qmc_replicates
+// independently scrambled replicates and takes the error from their
+// spread; otherwise it runs pseudo-random batches of blocks, stopping early
+// once the target standard error is met. max_units is the number of
+// sampling units the sweep may use.
+//
+// sweep(scramble, first_block, end_block, units, sum) runs blocks
+// [first_block, end_block) of a sweep over units sampling units and folds
+// their sums into sum in block order; scramble is the replicate's Sobol
+// scramble and is unused for pseudo-random sampling. result(sum, units)
+// prices from the sums of the first units units.
+template <typename Sums, typename Sweep, typename Result>
+McPriceResult run_sampling(const McOptions& opts, long long max_units, uint64_t seed,
+                           const Sweep& sweep, const Result& result) {
+    if (opts.sampler == Sampler::Sobol) {
+        const int replicates = std::max(1, opts.qmc_replicates);
+        const long long units_per_rep = std::max(2LL, (max_units + replicates - 1) / replicates);
+        const long long blocks = (units_per_rep + kPathBlock - 1) / kPathBlock;
+
+        Sums pooled{};
+        double repSum = 0, repSq = 0;
+        for (int rep = 0; rep < replicates; ++rep) {
+            Sums sum{};
+            sweep(seed + 0x9E3779B97F4A7C15ull * (rep + 1), 0LL, blocks, units_per_rep, sum);
+
+            double price = result(sum, units_per_rep).price;
+            repSum += price;
+            repSq += price * price;
+            for (size_t k = 0; k < pooled.size(); ++k) {
+                pooled[k] += sum[k];
+            }
+        }
+
+        McPriceResult pooledResult = result(pooled, units_per_rep * replicates);
+        McEstimate e = replicate_estimate(replicates, inv_norm_cdf(0.5 + 0.5 * opts.confidence),
+                                          repSum, repSq);
+        pooledResult.price = e.price;
+        pooledResult.std_error = e.std_error;
+        pooledResult.ci_low = e.ci_low;
+        pooledResult.ci_high = e.ci_high;
+        return pooledResult;
+    }
+
+    const long long perUnit = opts.antithetic ? 2 : 1;
+    const long long max_blocks = (max_units + kPathBlock - 1) / kPathBlock;
+    const bool adaptive = opts.target_std_error > 0;
+    const long long batch_blocks = adaptive
+        ? std::max(1LL, opts.batch_size / (perUnit * kPathBlock))
+        : max_blocks;
+
+    Sums sum{};
+    McPriceResult batchResult{};
+    for (long long batch = 0; batch < max_blocks; batch += batch_blocks) {
+        const long long batch_end = std::min(batch + batch_blocks, max_blocks);
+        sweep(uint64_t(0), batch, batch_end, max_units, sum);
+
+        long long units = std::min(batch_end * kPathBlock, max_units);
+        batchResult = result(sum, units);
+        if (adaptive && batchResult.std_error <= opts.target_std_error) {
+            break;
+        }
+    }
+    return batchResult;
+}
+
+// GBM tile: x += drift + diffusion * z at every step, with the layout of
+// TileSimulator
+void simulate_gbm_tile(double drift, double diffusion, int steps, PathAccumulator kind,
+                       const double* z, size_t tile, bool antithetic,
+                       double* x, double* acc, double* x2, double* acc2);
+
+struct PathSimulation {
+    TileSimulator simulate;
+    int dimensions;         // normals per path
+    int work_per_path;      // scratch doubles per path for simulate
+    bool bridge;            // under Sobol, feed the normals through a Brownian bridge
+};
+
+// Runs the simulation under opts (antithetic, control variate, adaptive
+// stopping, Sobol replicates) with deterministic block reduction.
+// controlMean is the undiscounted mean of the terminal vanilla.
+McPriceResult run_path_engine(const OptionParams& p, const PathPayoff& payoff,
+                              const PathSimulation& sim, double controlMean,
+                              const McOptions& opts, const CounterRng& rng, int num_threads);
+
+// Price from the sums of the first units sampling units, folded in block
+// order. controlMean is used only when opts.control_variate is set.
+McPriceResult path_result(const OptionParams& p, const McOptions& opts, const PathSums& sum,
+                          long long units, double controlMean);
+
+// The pseudo-random price_path_option sweep a range of blocks at a time,
+// for callers that schedule its blocks themselves (ShardedMonteCarlo.cpp):
+// block_sums[b - first_block] receives the sums of block b. Folding every
+// block's sums in order and passing them to path_result prices exactly as
+// price_path_option without adaptive stopping.
+void path_option_block_sums(const OptionParams& p, bool antithetic, const CounterRng& rng,
+                            int num_threads, long long first_block, long long end_block,
+                            PathSums* block_sums);
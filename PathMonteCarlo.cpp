@@ -0,0 +1,411 @@
+#include "FinanceMonteCarlo.h"
+#include "BrownianBridge.h"
+#include "McProfile.h"
+#include "McStatistics.h"
+#include "PathEngine.h"
+#include "SimdMath.h"
+#include "SobolSequence.h"
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Broadie-Glasserman-Kou constant: a discretely monitored barrier behaves
+// like a continuous one shifted by beta * v * sqrt(dt) away from the spot,
+// so moving the simulated barrier towards the spot mimics continuous
+// monitoring
+const double kBarrierShift = 0.5826;
+
+// Path state for a tile (the normals, log-spot and accumulator for every
+// path) is kept within this many bytes so it stays cache resident
+const size_t kTileBytes = 256 * 1024;
+const size_t kMaxTile = 256;
+
+PathAccumulator accumulator_for(const PayoffSpec& payoff) {
+    switch (payoff.type) {
+    case PayoffType::AsianArithmetic:
+        return kSumSpot;
+    case PayoffType::AsianGeometric:
+        return kSumLog;
+    case PayoffType::UpAndOut:
+    case PayoffType::UpAndIn:
+        return kRunningMax;
+    case PayoffType::DownAndOut:
+    case PayoffType::DownAndIn:
+        return kRunningMin;
+    case PayoffType::LookbackFixed:
+        return payoff.is_call ? kRunningMax : kRunningMin;
+    case PayoffType::LookbackFloating:
+        return payoff.is_call ? kRunningMin : kRunningMax;
+    default:
+        return kNoAccumulator;
+    }
+}
+
+bool is_barrier(PayoffType type) {
+    return type == PayoffType::UpAndOut || type == PayoffType::UpAndIn ||
+           type == PayoffType::DownAndOut || type == PayoffType::DownAndIn;
+}
+
+inline double vanilla(double ST, double K, bool is_call) {
+    return is_call ? std::max(ST - K, 0.0) : std::max(K - ST, 0.0);
+}
+
+// Slots of PathSums: payoff y and the terminal vanilla x
+enum PathSum {
+    kY,
+    kYY,
+    kX,
+    kXX,
+    kXY
+};
+
+} // namespace
+
+// Paths per tile: as many as fit kTileBytes of normals, a multiple of the
+// Philox block and of the vector width
+size_t tile_paths(int dimensions) {
+    size_t fit = kTileBytes / (sizeof(double) * static_cast<size_t>(dimensions));
+    return std::max<size_t>(16, std::min(kMaxTile, fit / 16 * 16));
+}
+
+// GBM tile: x += drift + diffusion * z at every step
+void simulate_gbm_tile(double drift, double diffusion, int steps, PathAccumulator kind,
+                       const double* z, size_t tile, bool antithetic,
+                       double* x, double* acc, double* x2, double* acc2) {
+    std::fill(x, x + tile, 0.0);
+    std::fill(acc, acc + tile, 0.0);
+    std::fill(x2, x2 + tile, 0.0);
+    std::fill(acc2, acc2 + tile, 0.0);
+    const vdouble _drift = vd_set1(drift);
+    const vdouble _diffusion = vd_set1(diffusion);
+    const vdouble _negDiffusion = vd_set1(-diffusion);
+
+    // Mirror paths run alongside, so each step's normals are loaded once
+    for (int k = 0; k < steps; ++k) {
+        const double* zk = z + static_cast<size_t>(k) * tile;
+        for (size_t i = 0; i < tile; i += VD_LANES) {
+            vdouble _z = vd_load(zk + i);
+            vdouble _x = vd_fmadd(_diffusion, _z, vd_add(vd_load(x + i), _drift));
+            vd_store(x + i, _x);
+            vd_store(acc + i, accumulate(kind, vd_load(acc + i), _x));
+            if (antithetic) {
+                vdouble _x2 = vd_fmadd(_negDiffusion, _z, vd_add(vd_load(x2 + i), _drift));
+                vd_store(x2 + i, _x2);
+                vd_store(acc2 + i, accumulate(kind, vd_load(acc2 + i), _x2));
+            }
+        }
+    }
+}
+
+namespace {
+
+// draw(first, z, scratch) fills z with the [dimension][path] normals of the
+// tile units [first, first + tile); scratch has the same size
+typedef std::function<void(long long, double*, double*)> TileDraw;
+
+// Per-thread buffers of a sweep
+struct TileBuffers {
+    std::vector<double> z;
+    std::vector<double> scratch;
+    std::vector<double> state;
+    std::vector<double> work;
+};
+
+PathSums path_block_sums(const PathPayoff& payoff, const PathSimulation& sim, bool antithetic,
+                         long long first, long long units, size_t tile, const TileDraw& draw,
+                         TileBuffers& buf, PhaseClock& clock) {
+    double* x = buf.state.data();
+    double* acc = x + tile;
+    double* x2 = acc + tile;
+    double* acc2 = x2 + tile;
+    PathSums sums{};
+
+    for (long long t = 0; t < units; t += tile) {
+        // Tails simulate the whole tile and only count the live paths
+        clock.restart();
+        draw(first + t, buf.z.data(), buf.scratch.data());
+        clock.lap(kPhaseRng);
+        sim.simulate(buf.z.data(), tile, antithetic, x, acc, x2, acc2, buf.work.data());
+        clock.lap(kPhasePaths);
+
+        long long live = std::min(static_cast<long long>(tile), units - t);
+        for (long long i = 0; i < live; ++i) {
+            double c;
+            double y = payoff(x[i], acc[i], &c);
+            if (antithetic) {
+                double c2;
+                y = 0.5 * (y + payoff(x2[i], acc2[i], &c2));
+                c = 0.5 * (c + c2);
+            }
+            sums[kY] += y;
+            sums[kYY] += y * y;
+            sums[kX] += c;
+            sums[kXX] += c * c;
+            sums[kXY] += c * y;
+        }
+        clock.lap(kPhasePayoff);
+    }
+    clock.count_block(units * (antithetic ? 2 : 1));
+    return sums;
+}
+
+// Sums of each block [first_block, end_block) over max_units sampling
+// units, into block_sums[b - first_block]
+void path_blocks(const PathPayoff& payoff, const PathSimulation& sim, bool antithetic,
+                 int num_threads, long long first_block, long long end_block, long long max_units,
+                 const TileDraw& draw, PathSums* block_sums) {
+    const size_t tile = tile_paths(sim.dimensions);
+    ProfileRegion region;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        PhaseClock clock(region);
+        TileBuffers buf;
+        buf.z.resize(static_cast<size_t>(sim.dimensions) * tile);
+        buf.scratch.resize(buf.z.size());
+        buf.state.resize(4 * tile);
+        buf.work.resize(static_cast<size_t>(sim.work_per_path) * tile);
+
+        #pragma omp for schedule(dynamic)
+        for (long long b = first_block; b < end_block; ++b) {
+            long long first = b * kPathBlock;
+            long long count = std::min(kPathBlock, max_units - first);
+            block_sums[b - first_block] = path_block_sums(payoff, sim, antithetic, first, count,
+                                                          tile, draw, buf, clock);
+        }
+    }
+}
+
+// Runs blocks [first_block, end_block) over max_units sampling units and
+// folds their sums into sum in block order
+void sweep_paths(const PathPayoff& payoff, const PathSimulation& sim, bool antithetic,
+                 int num_threads, long long first_block, long long end_block, long long max_units,
+                 const TileDraw& draw, PathSums& sum) {
+    std::vector<PathSums> block_sums(end_block - first_block);
+    path_blocks(payoff, sim, antithetic, num_threads, first_block, end_block, max_units, draw,
+                block_sums.data());
+    PhaseClock clock;
+    for (const PathSums& partial : block_sums) {
+        for (int k = 0; k < kNumPathSums; ++k) {
+            sum[k] += partial[k];
+        }
+    }
+    clock.lap(kPhaseReduce);
+}
+
+} // namespace
+
+McPriceResult path_result(const OptionParams& p, const McOptions& opts, const PathSums& sum,
+                          long long units, double controlMean) {
+    double df = std::exp(-p.r * p.T);
+    double z_score = inv_norm_cdf(0.5 + 0.5 * opts.confidence);
+    double control[] = {sum[kX], sum[kXX], sum[kXY], controlMean};
+    McEstimate e = unit_estimate(df, units, z_score, sum[kY], sum[kYY],
+                                 opts.control_variate ? control : nullptr);
+    McPriceResult result;
+    result.price = e.price;
+    result.std_error = e.std_error;
+    result.ci_low = e.ci_low;
+    result.ci_high = e.ci_high;
+    result.samples = units * (opts.antithetic ? 2 : 1);
+    return result;
+}
+
+PathPayoff::PathPayoff(const OptionParams& p, double step_vol)
+    : S(p.S), K(p.K), steps(p.numSteps), spec(p.payoff),
+      accumulator(accumulator_for(p.payoff)), log_barrier(0.0) {
+    if (is_barrier(spec.type)) {
+        if (spec.barrier <= 0) {
+            throw std::invalid_argument("price_path_option: barrier options need a positive barrier");
+        }
+        bool up = spec.type == PayoffType::UpAndOut || spec.type == PayoffType::UpAndIn;
+        double shift = spec.continuity_correction ? kBarrierShift * step_vol : 0.0;
+        log_barrier = std::log(spec.barrier / p.S) + (up ? -shift : shift);
+    }
+}
+
+double PathPayoff::operator()(double x, double acc, double* control) const {
+    double ST = S * std::exp(x);
+    double plain = vanilla(ST, K, spec.is_call);
+    *control = plain;
+
+    switch (spec.type) {
+    case PayoffType::AsianArithmetic:
+        return vanilla(S * acc / steps, K, spec.is_call);
+    case PayoffType::AsianGeometric:
+        return vanilla(S * std::exp(acc / steps), K, spec.is_call);
+    case PayoffType::UpAndOut:
+        return acc >= log_barrier ? 0.0 : plain;
+    case PayoffType::UpAndIn:
+        return acc >= log_barrier ? plain : 0.0;
+    case PayoffType::DownAndOut:
+        return acc <= log_barrier ? 0.0 : plain;
+    case PayoffType::DownAndIn:
+        return acc <= log_barrier ? plain : 0.0;
+    case PayoffType::LookbackFixed:
+        return vanilla(S * std::exp(acc), K, spec.is_call);
+    case PayoffType::LookbackFloating:
+        return spec.is_call ? ST - S * std::exp(acc) : S * std::exp(acc) - ST;
+    default:
+        return plain;
+    }
+}
+
+double PathPayoff::gradient(double x, double acc, double* dx, double* dacc, double* dS) const {
+    const double sign = spec.is_call ? 1.0 : -1.0;
+    double ST = S * std::exp(x);
+    *dx = 0.0;
+    *dacc = 0.0;
+    *dS = 0.0;
+
+    // A vanilla on an underlying U moves with U when in the money
+    auto vanilla_on = [&](double U, double dU_dx, double dU_dacc) {
+        double payoff = vanilla(U, K, spec.is_call);
+        if (payoff > 0) {
+            *dx = sign * dU_dx;
+            *dacc = sign * dU_dacc;
+            *dS = sign * U / S;
+        }
+        return payoff;
+    };
+
+    switch (spec.type) {
+    case PayoffType::AsianArithmetic:
+        return vanilla_on(S * acc / steps, 0.0, S / steps);
+    case PayoffType::AsianGeometric: {
+        double G = S * std::exp(acc / steps);
+        return vanilla_on(G, 0.0, G / steps);
+    }
+    case PayoffType::LookbackFixed: {
+        double M = S * std::exp(acc);
+        return vanilla_on(M, 0.0, M);
+    }
+    case PayoffType::LookbackFloating: {
+        double M = S * std::exp(acc);
+        *dx = sign * ST;
+        *dacc = -sign * M;
+        *dS = sign * (ST - M) / S;
+        return sign * (ST - M);
+    }
+    case PayoffType::European:
+        return vanilla_on(ST, ST, 0.0);
+    default:
+        throw std::invalid_argument("PathPayoff: barrier payoffs have no pathwise derivative");
+    }
+}
+
+namespace {
+
+// Dimension k of unit i uses normal i of stream k, so a path is the same
+// whatever tile, block, thread, batch or process it lands in
+TileDraw pseudo_random_draw(const CounterRng& rng, int dims, size_t tile) {
+    return [&rng, dims, tile](long long first, double* z, double*) {
+        for (int k = 0; k < dims; ++k) {
+            rng.normals(static_cast<uint32_t>(k), first, z + static_cast<size_t>(k) * tile, tile);
+        }
+    };
+}
+
+double gbm_diffusion(const OptionParams& p) {
+    return p.v * std::sqrt(p.T / p.numSteps);
+}
+
+PathSimulation gbm_simulation(const OptionParams& p, PathAccumulator kind) {
+    const double dt = p.T / p.numSteps;
+    const double drift = (p.r - 0.5 * p.v * p.v) * dt;
+    const double diffusion = gbm_diffusion(p);
+    const int steps = p.numSteps;
+    PathSimulation sim;
+    sim.dimensions = steps;
+    sim.work_per_path = 0;
+    sim.bridge = true;
+    sim.simulate = [drift, diffusion, steps, kind](const double* z, size_t tile, bool antithetic,
+                                                   double* x, double* acc, double* x2, double* acc2,
+                                                   double*) {
+        simulate_gbm_tile(drift, diffusion, steps, kind, z, tile, antithetic, x, acc, x2, acc2);
+    };
+    return sim;
+}
+
+} // namespace
+
+McPriceResult run_path_engine(const OptionParams& p, const PathPayoff& payoff,
+                              const PathSimulation& sim, double controlMean,
+                              const McOptions& opts, const CounterRng& rng, int num_threads) {
+    if (p.numSamples < 2) {
+        throw std::invalid_argument("price_path_option: numSamples must be at least 2");
+    }
+    const long long perUnit = opts.antithetic ? 2 : 1;
+    const long long max_units = (p.numSamples + perUnit - 1) / perUnit;
+    const size_t tile = tile_paths(sim.dimensions);
+    const int dims = sim.dimensions;
+    auto result = [&](const PathSums& sum, long long units) {
+        return path_result(p, opts, sum, units, controlMean);
+    };
+
+    if (opts.sampler == Sampler::Sobol) {
+        // Bridge ordering puts the terminal value, which drives most of the
+        // payoff, on the first and best-distributed Sobol dimension
+        SobolSequence sobol(dims);
+        BrownianBridge bridge(dims);
+        const bool use_bridge = sim.bridge;
+        auto sweep = [&](uint64_t scramble, long long first_block, long long end_block,
+                         long long units, PathSums& sum) {
+            TileDraw draw = [&sobol, &bridge, use_bridge, scramble, tile](long long first, double* z,
+                                                                          double* scratch) {
+                if (use_bridge) {
+                    sobol.normals(scramble, static_cast<uint32_t>(first), tile, scratch);
+                    bridge.build(scratch, tile, z);
+                } else {
+                    sobol.normals(scramble, static_cast<uint32_t>(first), tile, z);
+                }
+            };
+            sweep_paths(payoff, sim, opts.antithetic, num_threads, first_block, end_block, units,
+                        draw, sum);
+        };
+        return run_sampling<PathSums>(opts, max_units, rng.seed(), sweep, result);
+    }
+
+    TileDraw draw = pseudo_random_draw(rng, dims, tile);
+    auto sweep = [&](uint64_t, long long first_block, long long end_block, long long units,
+                     PathSums& sum) {
+        sweep_paths(payoff, sim, opts.antithetic, num_threads, first_block, end_block, units, draw, sum);
+    };
+    return run_sampling<PathSums>(opts, max_units, rng.seed(), sweep, result);
+}
+
+McPriceResult FinanceMonteCarlo::price_path_option(const OptionParams& p, const McOptions& opts) {
+    ProfileCall profile("price_path_option", num_threads_);
+    if (p.numSteps < 1) {
+        throw std::invalid_argument("price_path_option: numSteps must be at least 1");
+    }
+    const PathPayoff payoff(p, gbm_diffusion(p));
+    const PathSimulation sim = gbm_simulation(p, payoff.accumulator);
+    const double controlMean = opts.control_variate
+        ? black_scholes_price(p, p.payoff.is_call) * std::exp(p.r * p.T)
+        : 0.0;
+    return run_path_engine(p, payoff, sim, controlMean, opts, rng_, num_threads_);
+}
+
+void path_option_block_sums(const OptionParams& p, bool antithetic, const CounterRng& rng,
+                            int num_threads, long long first_block, long long end_block,
+                            PathSums* block_sums) {
+    if (p.numSteps < 1) {
+        throw std::invalid_argument("price_path_option: numSteps must be at least 1");
+    }
+    const PathPayoff payoff(p, gbm_diffusion(p));
+    const PathSimulation sim = gbm_simulation(p, payoff.accumulator);
+    const long long perUnit = antithetic ? 2 : 1;
+    const long long max_units = (p.numSamples + perUnit - 1) / perUnit;
+    if (first_block < 0 || end_block > (max_units + kPathBlock - 1) / kPathBlock) {
+        throw std::invalid_argument("price_path_option: block range outside the sweep");
+    }
+    TileDraw draw = pseudo_random_draw(rng, sim.dimensions, tile_paths(sim.dimensions));
+    path_blocks(payoff, sim, antithetic, num_threads, first_block, end_block, max_units, draw,
+                block_sums);
+}
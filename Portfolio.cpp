@@ -0,0 +1,305 @@
+#include "Portfolio.h"
+#include "BlackScholesBatch.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kPortfolioMagic[8] = {'M', 'C', 'P', 'O', 'R', 'T', '1', '\0'};
+const char kResultsMagic[8] = {'M', 'C', 'R', 'E', 'S', '1', '\0', '\0'};
+
+// Longest formatted double from std::to_chars plus a separator
+const size_t kMaxField = 32;
+
+template <typename T>
+void append_raw(std::vector<char>& out, const T& value) {
+    const char* p = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+std::invalid_argument bad_row(size_t offset, const char* what) {
+    return std::invalid_argument("portfolio: " + std::string(what) + " in row at byte " +
+                                 std::to_string(offset));
+}
+
+bool is_blank_or_comment(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        ++p;
+    }
+    return p == end || *p == '#';
+}
+
+// True if the line starts like a number, i.e. is not a header
+bool starts_numeric(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    return p < end && (std::isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' || *p == '.');
+}
+
+const char* parse_field(const char* p, const char* end, double& value) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    if (p < end && *p == '+') {
+        ++p;
+    }
+    auto res = std::from_chars(p, end, value);
+    if (res.ec != std::errc()) {
+        return nullptr;
+    }
+    p = res.ptr;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    return p;
+}
+
+// C, P, call, put, 1 or 0, in any case
+bool parse_type(const char* p, const char* end, unsigned char& call) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        --end;
+    }
+    if (p == end) {
+        return false;
+    }
+    char c = static_cast<char>(std::tolower(static_cast<unsigned char>(*p)));
+    size_t n = end - p;
+    if ((c == 'c' && (n == 1 || (n == 4 && strncasecmp(p, "call", 4) == 0))) || (c == '1' && n == 1)) {
+        call = 1;
+        return true;
+    }
+    if ((c == 'p' && (n == 1 || (n == 3 && strncasecmp(p, "put", 3) == 0))) || (c == '0' && n == 1)) {
+        call = 0;
+        return true;
+    }
+    return false;
+}
+
+void parse_csv(const char* base, size_t first, size_t last, OptionChain& chain) {
+    const char* p = base + first;
+    const char* end = base + last;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) {
+            eol = end;
+        }
+        if (!is_blank_or_comment(p, eol)) {
+            size_t offset = p - base;
+            double field[5];
+            const char* q = p;
+            for (int f = 0; f < 5; ++f) {
+                q = parse_field(q, eol, field[f]);
+                if (!q || q == eol || *q != ',') {
+                    throw bad_row(offset, "expected S,K,T,r,v,type");
+                }
+                ++q;
+            }
+            unsigned char call;
+            if (!parse_type(q, eol, call)) {
+                throw bad_row(offset, "option type must be C, P, call, put, 1 or 0");
+            }
+            chain.S.push_back(field[0]);
+            chain.K.push_back(field[1]);
+            chain.T.push_back(field[2]);
+            chain.r.push_back(field[3]);
+            chain.v.push_back(field[4]);
+            chain.is_call.push_back(call);
+        }
+        p = eol + 1;
+    }
+}
+
+void append_csv_number(double x, std::vector<char>& out) {
+    size_t at = out.size();
+    out.resize(at + kMaxField);
+    auto res = std::to_chars(out.data() + at, out.data() + at + kMaxField, x);
+    out.resize(res.ptr - out.data());
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("cannot map " + path);
+        }
+        // Chunks are read front to back
+        ::madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p);
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+PortfolioReader::PortfolioReader(const std::string& path, size_t chunk_bytes) : file_(path) {
+    const char* data = file_.data();
+    const size_t size = file_.size();
+    chunk_bytes = std::max<size_t>(chunk_bytes, sizeof(PortfolioRecord));
+
+    if (size >= sizeof(PortfolioHeader) && std::memcmp(data, kPortfolioMagic, 8) == 0) {
+        PortfolioHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.record_size != sizeof(PortfolioRecord) ||
+            (size - sizeof(PortfolioHeader)) % sizeof(PortfolioRecord) != 0) {
+            throw std::invalid_argument("portfolio: " + path + " is not a whole number of records");
+        }
+        format_ = PortfolioFormat::Binary;
+        const size_t per_chunk = chunk_bytes / sizeof(PortfolioRecord) * sizeof(PortfolioRecord);
+        for (size_t at = sizeof(PortfolioHeader); at < size; at += per_chunk) {
+            bounds_.push_back(at);
+        }
+        bounds_.push_back(size);
+        if (bounds_.size() == 1) {
+            bounds_.insert(bounds_.begin(), size);
+        }
+        return;
+    }
+
+    // CSV chunks end just after a newline, so no row straddles two chunks
+    format_ = PortfolioFormat::Csv;
+    size_t start = 0;
+    const char* eol = static_cast<const char*>(std::memchr(data, '\n', size));
+    size_t first_line_end = eol ? eol - data : size;
+    if (size > 0 && !starts_numeric(data, data + first_line_end) &&
+        !is_blank_or_comment(data, data + first_line_end)) {
+        start = std::min(first_line_end + 1, size);
+    }
+    bounds_.push_back(start);
+    while (bounds_.back() < size) {
+        size_t at = bounds_.back() + chunk_bytes;
+        if (at >= size) {
+            at = size;
+        } else {
+            const char* nl = static_cast<const char*>(std::memchr(data + at, '\n', size - at));
+            at = nl ? nl - data + 1 : size;
+        }
+        bounds_.push_back(at);
+    }
+    if (bounds_.size() == 1) {
+        bounds_.push_back(start);
+    }
+}
+
+void PortfolioReader::read_chunk(size_t c, OptionChain& chain) const {
+    const size_t first = bounds_[c];
+    const size_t last = bounds_[c + 1];
+    // Clear rather than replace so a reused chain keeps its capacity
+    chain.S.clear();
+    chain.K.clear();
+    chain.T.clear();
+    chain.r.clear();
+    chain.v.clear();
+    chain.is_call.clear();
+    if (format_ == PortfolioFormat::Csv) {
+        // Rows are rarely shorter than ~24 bytes
+        chain.reserve((last - first) / 24 + 1);
+        parse_csv(file_.data(), first, last, chain);
+        return;
+    }
+
+    const size_t n = (last - first) / sizeof(PortfolioRecord);
+    chain.S.resize(n);
+    chain.K.resize(n);
+    chain.T.resize(n);
+    chain.r.resize(n);
+    chain.v.resize(n);
+    chain.is_call.resize(n);
+    const char* p = file_.data() + first;
+    for (size_t i = 0; i < n; ++i, p += sizeof(PortfolioRecord)) {
+        PortfolioRecord rec;
+        std::memcpy(&rec, p, sizeof(rec));
+        chain.S[i] = rec.S;
+        chain.K[i] = rec.K;
+        chain.T[i] = rec.T;
+        chain.r[i] = rec.r;
+        chain.v[i] = rec.v;
+        chain.is_call[i] = rec.is_call ? 1 : 0;
+    }
+}
+
+void write_portfolio_header(std::vector<char>& out) {
+    PortfolioHeader header{};
+    std::memcpy(header.magic, kPortfolioMagic, 8);
+    header.record_size = sizeof(PortfolioRecord);
+    append_raw(out, header);
+}
+
+void append_portfolio_records(const OptionChain& chain, std::vector<char>& out) {
+    out.reserve(out.size() + chain.size() * sizeof(PortfolioRecord));
+    for (size_t i = 0; i < chain.size(); ++i) {
+        PortfolioRecord rec{};
+        rec.S = chain.S[i];
+        rec.K = chain.K[i];
+        rec.T = chain.T[i];
+        rec.r = chain.r[i];
+        rec.v = chain.v[i];
+        rec.is_call = chain.is_call[i];
+        append_raw(out, rec);
+    }
+}
+
+void write_results_header(ResultFormat format, bool with_error, std::vector<char>& out) {
+    if (format == ResultFormat::Csv) {
+        const char* header = with_error ? "price,delta,gamma,theta,vega,std_error\n"
+                                        : "price,delta,gamma,theta,vega\n";
+        out.insert(out.end(), header, header + std::strlen(header));
+        return;
+    }
+    out.insert(out.end(), kResultsMagic, kResultsMagic + 8);
+    append_raw(out, static_cast<uint32_t>(with_error ? 6 : 5));
+    append_raw(out, static_cast<uint32_t>(0));
+}
+
+void append_results(ResultFormat format, const GreeksChain& results, const double* std_error,
+                    std::vector<char>& out) {
+    const size_t n = results.size();
+    const double* columns[] = {results.price.data(), results.delta.data(), results.gamma.data(),
+                               results.theta.data(), results.vega.data(), std_error};
+    const int num_columns = std_error ? 6 : 5;
+
+    if (format == ResultFormat::Binary) {
+        append_raw(out, static_cast<uint64_t>(n));
+        for (int c = 0; c < num_columns; ++c) {
+            const char* p = reinterpret_cast<const char*>(columns[c]);
+            out.insert(out.end(), p, p + n * sizeof(double));
+        }
+        return;
+    }
+
+    out.reserve(out.size() + n * num_columns * 12);
+    for (size_t i = 0; i < n; ++i) {
+        for (int c = 0; c < num_columns; ++c) {
+            append_csv_number(columns[c][i], out);
+            out.push_back(c + 1 < num_columns ? ',' : '\n');
+        }
+    }
+}
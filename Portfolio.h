@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct OptionChain;
+struct GreeksChain;
+
+// Read-only memory map of a whole file. Throws std::runtime_error if the
+// file cannot be opened or mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Fixed-width binary portfolio: one header, then one record per position
+// up to the end of the file, so writers can stream without knowing the
+// count in advance
+struct PortfolioHeader {
+    char magic[8];              // "MCPORT1" and a NUL
+    uint32_t record_size;       // sizeof(PortfolioRecord)
+    uint32_t reserved;
+};
+
+struct PortfolioRecord {
+    double S;
+    double K;
+    double T;
+    double r;
+    double v;
+    uint8_t is_call;            // 1 for calls, 0 for puts
+    uint8_t pad[7];
+};
+
+static_assert(sizeof(PortfolioHeader) == 16, "PortfolioHeader must stay 16 bytes");
+static_assert(sizeof(PortfolioRecord) == 48, "PortfolioRecord must stay 48 bytes");
+
+enum class PortfolioFormat {
+    Csv,        // S,K,T,r,v,type per line; type is C/P, call/put or 1/0
+    Binary      // PortfolioHeader then PortfolioRecords
+};
+
+// A memory-mapped portfolio cut into chunks that parse independently, so
+// threads can each take a chunk straight from the page cache. The format
+// is detected from the header magic. CSV files may start with a header
+// line; blank lines and lines starting with '#' are skipped.
+class PortfolioReader {
+public:
+    explicit PortfolioReader(const std::string& path, size_t chunk_bytes = 1 << 20);
+
+    PortfolioFormat format() const { return format_; }
+    size_t num_chunks() const { return bounds_.size() - 1; }
+
+    // Replaces chain with the positions of chunk c. Throws
+    // std::invalid_argument naming the byte offset of a malformed row.
+    void read_chunk(size_t c, OptionChain& chain) const;
+
+private:
+    MappedFile file_;
+    PortfolioFormat format_;
+    std::vector<size_t> bounds_;    // chunk c is bytes [bounds_[c], bounds_[c + 1])
+};
+
+void write_portfolio_header(std::vector<char>& out);
+void append_portfolio_records(const OptionChain& chain, std::vector<char>& out);
+
+enum class ResultFormat {
+    Csv,        // one line per position, numbers written with std::to_chars
+    Binary      // columnar blocks, see append_results
+};
+
+// Results are encoded into a caller-owned buffer so threads can format
+// their own chunk and only the write itself has to happen in order.
+//
+// The binary layout is a header ("MCRES1", a NUL, a pad byte, then a
+// uint32 column count and a uint32 reserved word), then one block per
+// chunk: a uint64 row count followed by each column as that many doubles,
+// in the order price, delta, gamma, theta, vega and, with standard errors,
+// std_error.
+void write_results_header(ResultFormat format, bool with_error, std::vector<char>& out);
+
+// Appends results for one chunk; std_error may be null
+void append_results(ResultFormat format, const GreeksChain& results, const double* std_error,
+                    std::vector<char>& out);
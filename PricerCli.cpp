@@ -0,0 +1,380 @@
+// Headless batch pricer: streams a portfolio file through the
+// Black-Scholes, Monte Carlo or finite-difference engine and writes one
+// result row per position, without wxWidgets.
+//
+//   mc_pricer [options] <portfolio.csv|portfolio.bin> <results>
+//
+// --engine bs|mc|pde closed form (default), Monte Carlo per position, or
+//                    Crank-Nicolson solved a SIMD batch of positions at a
+//                    time (CrankNicolson.h)
+// --american         early exercise (pde engine only)
+// --samples N        Monte Carlo paths per position (default 100000)
+// --seed S           Monte Carlo seed, shared by all positions (default 1)
+// --antithetic       antithetic Monte Carlo paths
+// --single-precision float32 Monte Carlo sweep (McOptions::single_precision)
+// --threads N        worker threads (default: all cores)
+// --format csv|bin   result format (default csv)
+// --chunk-bytes N    input bytes per work chunk (default 1 MiB)
+// --to-binary        convert a CSV portfolio to the binary format instead
+// --shards N         split every Monte Carlo position over N local worker
+//                    processes (ShardedMonteCarlo.h); same results
+// --shard-worker     serve shard requests on stdin/stdout, for --shards or
+//                    a remote coordinator
+//
+// Results are written in input order; "-" as the output writes to stdout.
+#include "BlackScholesBatch.h"
+#include "CrankNicolson.h"
+#include "FinanceMonteCarlo.h"
+#include "Portfolio.h"
+#include "PricingService.h"
+#include "ShardedMonteCarlo.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <unistd.h>
+
+namespace {
+
+struct CliOptions {
+    bool monte_carlo = false;
+    bool pde = false;
+    bool american = false;
+    long long samples = 100000;
+    uint64_t seed = 1;
+    bool antithetic = false;
+    bool single_precision = false;
+    int threads = 0;
+    ResultFormat format = ResultFormat::Csv;
+    size_t chunk_bytes = 1 << 20;
+    bool to_binary = false;
+    int shards = 0;
+    bool shard_worker = false;
+    std::string program;
+    std::string input;
+    std::string output;
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: mc_pricer [--engine bs|mc|pde] [--american] [--samples N] [--seed S]\n"
+                 "                 [--antithetic] [--single-precision] [--threads N] [--format csv|bin]\n"
+                 "                 [--chunk-bytes N] [--to-binary] [--shards N] <portfolio> <output|->\n"
+                 "       mc_pricer --shard-worker [--threads N]\n");
+}
+
+CliOptions parse_args(int argc, char** argv) {
+    CliOptions o;
+    o.program = argv[0];
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(arg + " needs a value");
+            }
+            return argv[++i];
+        };
+        if (arg == "--engine") {
+            std::string e = value();
+            if (e != "bs" && e != "mc" && e != "pde") {
+                throw std::invalid_argument("--engine must be bs, mc or pde");
+            }
+            o.monte_carlo = e == "mc";
+            o.pde = e == "pde";
+        } else if (arg == "--american") {
+            o.american = true;
+        } else if (arg == "--samples") {
+            o.samples = std::stoll(value());
+        } else if (arg == "--seed") {
+            o.seed = std::stoull(value());
+        } else if (arg == "--antithetic") {
+            o.antithetic = true;
+        } else if (arg == "--single-precision") {
+            o.single_precision = true;
+        } else if (arg == "--threads") {
+            o.threads = std::stoi(value());
+        } else if (arg == "--format") {
+            std::string f = value();
+            if (f != "csv" && f != "bin") {
+                throw std::invalid_argument("--format must be csv or bin");
+            }
+            o.format = f == "bin" ? ResultFormat::Binary : ResultFormat::Csv;
+        } else if (arg == "--chunk-bytes") {
+            o.chunk_bytes = std::stoull(value());
+        } else if (arg == "--to-binary") {
+            o.to_binary = true;
+        } else if (arg == "--shards") {
+            o.shards = std::stoi(value());
+        } else if (arg == "--shard-worker") {
+            o.shard_worker = true;
+        } else if (arg.size() > 1 && arg[0] == '-' && arg != "-") {
+            throw std::invalid_argument("unknown option " + arg);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (o.threads <= 0) {
+        o.threads = omp_get_max_threads();
+    }
+    if (o.shard_worker) {
+        return o;
+    }
+    if (o.american && !o.pde) {
+        throw std::invalid_argument("--american needs --engine pde");
+    }
+    if (o.single_precision && o.shards > 0) {
+        throw std::invalid_argument("--single-precision runs cannot be sharded");
+    }
+    if (positional.size() != 2) {
+        throw std::invalid_argument("need a portfolio file and an output file");
+    }
+    o.input = positional[0];
+    o.output = positional[1];
+    return o;
+}
+
+std::vector<PricingJob> chunk_jobs(const CliOptions& o, const OptionChain& chain) {
+    std::vector<PricingJob> jobs(chain.size());
+    for (size_t i = 0; i < chain.size(); ++i) {
+        jobs[i].params = OptionParams{chain.S[i], chain.K[i], chain.T[i], chain.r[i], chain.v[i], o.samples};
+        jobs[i].is_call = chain.is_call[i] != 0;
+        jobs[i].options.antithetic = o.antithetic;
+        jobs[i].options.single_precision = o.single_precision;
+    }
+    return jobs;
+}
+
+// Writes all of buf; throws on a short write (full disk, closed pipe, ...)
+void write_all(std::FILE* out, const std::vector<char>& buf) {
+    if (std::fwrite(buf.data(), 1, buf.size(), out) != buf.size()) {
+        throw std::runtime_error("writing the results failed");
+    }
+}
+
+void store_result(const PricingResult& r, bool is_call, size_t i, GreeksChain& results,
+                  std::vector<double>& std_error) {
+    const McLegResult& leg = is_call ? r.european.call : r.european.put;
+    results.price[i] = leg.price;
+    results.delta[i] = leg.pathwise.delta;
+    results.gamma[i] = leg.pathwise.gamma;
+    results.theta[i] = leg.pathwise.theta;
+    results.vega[i] = leg.pathwise.vega;
+    std_error[i] = leg.std_error;
+}
+
+// Monte Carlo positions go through a PricingService a chunk at a time: the
+// next chunk is parsed and queued while the workers finish the current one,
+// so many small positions and a few huge ones all keep every core busy.
+// Every position draws the same paths. Returns the positions written.
+long long price_monte_carlo(const CliOptions& o, const PortfolioReader& reader, std::FILE* out) {
+    const long long chunks = static_cast<long long>(reader.num_chunks());
+    PricingService service(o.threads, o.seed);
+    OptionChain chains[2];
+    std::vector<std::future<PricingResult>> pending[2];
+    auto queue = [&](long long c) {
+        OptionChain& chain = chains[c % 2];
+        reader.read_chunk(c, chain);
+        pending[c % 2] = service.submit(chunk_jobs(o, chain));
+    };
+
+    long long positions = 0;
+    GreeksChain results;
+    std::vector<double> std_error;
+    std::vector<char> buf;
+    if (chunks > 0) {
+        queue(0);
+    }
+    for (long long c = 0; c < chunks; ++c) {
+        if (c + 1 < chunks) {
+            queue(c + 1);
+        }
+        std::vector<std::future<PricingResult>>& futures = pending[c % 2];
+        results.resize(futures.size());
+        std_error.resize(futures.size());
+        for (size_t i = 0; i < futures.size(); ++i) {
+            store_result(futures[i].get(), chains[c % 2].is_call[i] != 0, i, results, std_error);
+        }
+        buf.clear();
+        append_results(o.format, results, std_error.data(), buf);
+        write_all(out, buf);
+        positions += futures.size();
+    }
+    return positions;
+}
+
+// With --shards every position is split across worker processes running
+// this binary with --shard-worker, which share the threads between them.
+// Results are identical to price_monte_carlo's.
+long long price_sharded(const CliOptions& o, const PortfolioReader& reader, std::FILE* out) {
+    const long long chunks = static_cast<long long>(reader.num_chunks());
+    const int worker_threads = std::max(1, o.threads / o.shards);
+    std::vector<std::string> commands(o.shards, "'" + o.program + "' --shard-worker --threads " +
+                                                    std::to_string(worker_threads));
+    ShardedMonteCarlo sharded(commands, o.seed);
+
+    long long positions = 0;
+    OptionChain chain;
+    GreeksChain results;
+    std::vector<double> std_error;
+    std::vector<char> buf;
+    for (long long c = 0; c < chunks; ++c) {
+        reader.read_chunk(c, chain);
+        std::vector<PricingJob> jobs = chunk_jobs(o, chain);
+        results.resize(jobs.size());
+        std_error.resize(jobs.size());
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            store_result(sharded.price(jobs[i]), jobs[i].is_call, i, results, std_error);
+        }
+        buf.clear();
+        append_results(o.format, results, std_error.data(), buf);
+        write_all(out, buf);
+        positions += jobs.size();
+    }
+    return positions;
+}
+
+int run(const CliOptions& o) {
+    const auto start = std::chrono::steady_clock::now();
+    PortfolioReader reader(o.input, o.chunk_bytes);
+    const long long chunks = static_cast<long long>(reader.num_chunks());
+
+    std::FILE* out = o.output == "-" ? stdout : std::fopen(o.output.c_str(), "wb");
+    if (!out) {
+        throw std::runtime_error("cannot open " + o.output + " for writing");
+    }
+
+    std::vector<char> header;
+    if (o.to_binary) {
+        write_portfolio_header(header);
+    } else {
+        write_results_header(o.format, o.monte_carlo, header);
+    }
+    if (std::fwrite(header.data(), 1, header.size(), out) != header.size()) {
+        if (out != stdout) {
+            std::fclose(out);
+        }
+        throw std::runtime_error("writing the results failed");
+    }
+
+    // Chunks are parsed, priced and encoded in parallel and written in
+    // order; an error anywhere stops the remaining chunks. Monte Carlo
+    // positions are spread over a PricingService instead.
+    PdeOptions pde;
+    pde.american = o.american;
+    pde.vega = true;
+    long long positions = 0;
+    std::atomic<bool> failed{false};
+    std::string error;
+    if (o.monte_carlo && !o.to_binary) {
+        try {
+            positions = o.shards > 0 ? price_sharded(o, reader, out) : price_monte_carlo(o, reader, out);
+        }
+        catch (const std::exception& e) {
+            failed = true;
+            error = e.what();
+        }
+    } else {
+        #pragma omp parallel num_threads(o.threads) reduction(+:positions)
+        {
+            OptionChain chain;
+            GreeksChain results;
+            std::vector<char> buf;
+
+            #pragma omp for ordered schedule(dynamic)
+            for (long long c = 0; c < chunks; ++c) {
+                bool ok = !failed;
+                buf.clear();
+                if (ok) {
+                    try {
+                        reader.read_chunk(c, chain);
+                        if (o.to_binary) {
+                            append_portfolio_records(chain, buf);
+                        } else {
+                            if (o.pde) {
+                                pde_batch(chain, pde, results);
+                            } else {
+                                black_scholes_batch(chain, results);
+                            }
+                            append_results(o.format, results, nullptr, buf);
+                        }
+                        positions += chain.size();
+                    }
+                    catch (const std::exception& e) {
+                        ok = false;
+                        #pragma omp critical(cli_error)
+                        {
+                            if (!failed) {
+                                error = e.what();
+                            }
+                            failed = true;
+                        }
+                    }
+                }
+                // Chunks after a failed write are dropped too, so the output
+                // never has a gap in the middle
+                #pragma omp ordered
+                {
+                    if (ok && !failed && !buf.empty() &&
+                        std::fwrite(buf.data(), 1, buf.size(), out) != buf.size()) {
+                        #pragma omp critical(cli_error)
+                        {
+                            if (!failed) {
+                                error = "writing the results failed";
+                            }
+                            failed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Buffered data only reaches the file here, so a full disk or a closed
+    // pipe may first show up now
+    bool flushed = std::fflush(out) == 0 && !std::ferror(out);
+    if (out != stdout) {
+        flushed = std::fclose(out) == 0 && flushed;
+    }
+    if (failed) {
+        throw std::runtime_error(error);
+    }
+    if (!flushed) {
+        throw std::runtime_error("writing " + o.output + " failed");
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "%lld positions in %.3f s (%.0f per second)\n",
+                 positions, seconds, positions / seconds);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        CliOptions o = parse_args(argc, argv);
+        if (o.shard_worker) {
+            serve_shards(STDIN_FILENO, STDOUT_FILENO, o.threads);
+            return 0;
+        }
+        return run(o);
+    }
+    catch (const std::invalid_argument& e) {
+        std::fprintf(stderr, "mc_pricer: %s\n", e.what());
+        usage();
+        return 2;
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "mc_pricer: %s\n", e.what());
+        return 1;
+    }
+}
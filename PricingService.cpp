@@ -0,0 +1,252 @@
+#include "PricingService.h"
+#include "EuropeanSweep.h"
+#include "McStatistics.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+struct PricingService::Job {
+    PricingJob spec;
+    size_t index = 0;
+    std::shared_ptr<const JobCallback> on_done;
+    std::promise<PricingResult> promise;
+
+    // Split European jobs: block sums land in their slots and are folded by
+    // whichever task finishes the last block
+    bool split = false;
+    long long units = 0;
+    double callBS = 0.0;
+    double putBS = 0.0;
+    std::vector<EuropeanSums> block_sums;
+    std::atomic<long long> remaining{0};
+};
+
+namespace {
+
+// A plain pseudo-random sweep whose blocks can be run in any order. Adaptive
+// and progressive runs decide batch by batch and Sobol runs go replicate by
+// replicate, so those stay whole, as do single-precision sweeps.
+bool splittable(const PricingJob& job) {
+    const McOptions& o = job.options;
+    return job.engine == PricingEngine::European && o.sampler == Sampler::PseudoRandom &&
+           o.target_std_error <= 0 && !o.progress && !o.cancel && !o.single_precision &&
+           job.params.numSamples > 0;
+}
+
+McPriceResult leg_result(const McLegResult& leg, long long samples) {
+    McPriceResult r;
+    r.price = leg.price;
+    r.std_error = leg.std_error;
+    r.ci_low = leg.ci_low;
+    r.ci_high = leg.ci_high;
+    r.samples = samples;
+    return r;
+}
+
+PricingResult european_pricing_result(const MonteCarloResult& european, bool is_call) {
+    PricingResult result{};
+    result.european = european;
+    result.price = leg_result(is_call ? european.call : european.put, european.samples);
+    return result;
+}
+
+} // namespace
+
+PricingService::PricingService(int num_threads, uint64_t seed) : rng_(seed) {
+    if (num_threads < 1) {
+        throw std::invalid_argument("PricingService needs at least one thread");
+    }
+    for (int w = 0; w < num_threads; ++w) {
+        workers_.emplace_back(new Worker);
+        workers_.back()->z.resize(kPathBlock);
+    }
+    for (int w = 0; w < num_threads; ++w) {
+        workers_[w]->thread = std::thread(&PricingService::run_worker, this, w);
+    }
+}
+
+PricingService::~PricingService() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+std::vector<std::future<PricingResult>> PricingService::submit(const std::vector<PricingJob>& jobs,
+                                                               JobCallback on_done) {
+    std::shared_ptr<const JobCallback> callback;
+    if (on_done) {
+        callback = std::make_shared<const JobCallback>(std::move(on_done));
+    }
+    FinanceMonteCarlo bs(1, rng_.seed());
+
+    std::vector<std::future<PricingResult>> futures;
+    futures.reserve(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        auto job = std::make_shared<Job>();
+        job->spec = jobs[i];
+        job->index = i;
+        job->on_done = callback;
+        futures.push_back(job->promise.get_future());
+
+        long long blocks = 0;
+        if (splittable(job->spec)) {
+            const OptionParams& p = job->spec.params;
+            const long long perUnit = job->spec.options.antithetic ? 2 : 1;
+            job->split = true;
+            job->units = (p.numSamples + perUnit - 1) / perUnit;
+            if (job->spec.options.control_variate) {
+                job->callBS = bs.black_scholes_price(p, true);
+                job->putBS = bs.black_scholes_price(p, false);
+            }
+            blocks = (job->units + kPathBlock - 1) / kPathBlock;
+            job->block_sums.resize(blocks);
+            job->remaining = blocks;
+        }
+        push(next_worker_++ % workers_.size(), Task{std::move(job), 0, blocks});
+    }
+    return futures;
+}
+
+std::future<PricingResult> PricingService::submit(const PricingJob& job) {
+    return std::move(submit(std::vector<PricingJob>(1, job)).front());
+}
+
+void PricingService::push(size_t worker, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(workers_[worker]->mutex);
+        workers_[worker]->tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+    // A worker counts itself idle before checking queued_, so one of the
+    // two always sees the other
+    if (idle_.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+        wake_.notify_one();
+    }
+}
+
+bool PricingService::pop(size_t worker, Task& task) {
+    const size_t n = workers_.size();
+    for (size_t k = 0; k < n; ++k) {
+        // Own deque newest first, then steal the oldest task of the others
+        Worker& from = *workers_[(worker + k) % n];
+        std::lock_guard<std::mutex> lock(from.mutex);
+        if (from.tasks.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            task = std::move(from.tasks.back());
+            from.tasks.pop_back();
+        } else {
+            task = std::move(from.tasks.front());
+            from.tasks.pop_front();
+        }
+        queued_.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void PricingService::run_worker(size_t worker) {
+    for (;;) {
+        Task task;
+        if (pop(worker, task)) {
+            run_task(worker, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        idle_.fetch_add(1);
+        wake_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+        idle_.fetch_sub(1);
+        if (stop_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
+
+void PricingService::run_task(size_t worker, Task& task) {
+    Job& job = *task.job;
+    if (!job.split) {
+        run_whole(job);
+        return;
+    }
+
+    const OptionParams& p = job.spec.params;
+    const bool antithetic = job.spec.options.antithetic;
+    double* z = workers_[worker]->z.data();
+    long long end = task.end_block;
+    long long done = 0;
+    for (long long b = task.first_block; b < end; ++b, ++done) {
+        // Give the upper half of what is left to a worker that has nothing
+        if (end - b > 1 && idle_.load(std::memory_order_relaxed) > queued_.load(std::memory_order_relaxed)) {
+            long long mid = b + (end - b) / 2;
+            push(worker, Task{task.job, mid, end});
+            end = mid;
+        }
+        long long first = b * kPathBlock;
+        long long count = std::min(kPathBlock, job.units - first);
+        rng_.normals(0, first, z, count);
+        job.block_sums[b] = european_block_sums(z, count, p, antithetic);
+    }
+
+    if (job.remaining.fetch_sub(done, std::memory_order_acq_rel) != done) {
+        return;
+    }
+    try {
+        EuropeanSums sum{};
+        for (const EuropeanSums& partial : job.block_sums) {
+            for (int k = 0; k < kNumEuropeanSums; ++k) {
+                sum[k] += partial[k];
+            }
+        }
+        PricingResult result = european_pricing_result(
+            european_result(p, job.spec.options, sum, job.units, job.callBS, job.putBS), job.spec.is_call);
+        if (job.on_done) {
+            (*job.on_done)(job.index, result);
+        }
+        job.promise.set_value(result);
+    }
+    catch (...) {
+        job.promise.set_exception(std::current_exception());
+    }
+}
+
+void PricingService::run_whole(Job& job) {
+    try {
+        FinanceMonteCarlo mc(1, rng_.seed());
+        const PricingJob& spec = job.spec;
+        PricingResult result{};
+        switch (spec.engine) {
+        case PricingEngine::BlackScholes: {
+            double price = mc.black_scholes_price(spec.params, spec.is_call);
+            result.price = McPriceResult{price, 0.0, price, price, 0};
+            break;
+        }
+        case PricingEngine::European:
+            result = european_pricing_result(mc.price_european(spec.params, spec.options), spec.is_call);
+            break;
+        case PricingEngine::PathDependent:
+            result.price = mc.price_path_option(spec.params, spec.options);
+            break;
+        case PricingEngine::American:
+            result.price = mc.price_american(spec.params, spec.is_call, spec.options);
+            break;
+        case PricingEngine::Pde:
+            result.pde = mc.price_pde(spec.params, spec.is_call, spec.pde);
+            result.price = McPriceResult{result.pde.price, 0.0, result.pde.price, result.pde.price, 0};
+            break;
+        }
+        if (job.on_done) {
+            (*job.on_done)(job.index, result);
+        }
+        job.promise.set_value(result);
+    }
+    catch (...) {
+        job.promise.set_exception(std::current_exception());
+    }
+}
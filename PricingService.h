@@ -0,0 +1,109 @@
+#pragma once
+#include "FinanceMonteCarlo.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class PricingEngine {
+    BlackScholes,   // closed form
+    European,       // FinanceMonteCarlo::price_european
+    PathDependent,  // FinanceMonteCarlo::price_path_option
+    American,       // FinanceMonteCarlo::price_american
+    Pde             // FinanceMonteCarlo::price_pde
+};
+
+struct PricingJob {
+    PricingEngine engine = PricingEngine::European;
+    OptionParams params{};
+    bool is_call = true;        // leg reported in PricingResult::price
+    McOptions options;
+    PdeOptions pde;             // grid and exercise style, Pde engine only
+};
+
+struct PricingResult {
+    McPriceResult price;        // the is_call leg; zero error for BlackScholes
+    MonteCarloResult european;  // both legs with greeks, European engine only
+    PdeResult pde;              // price and grid greeks, Pde engine only
+};
+
+// Long-lived pricing engine for portfolios of many independent jobs. It
+// owns num_threads workers, each with a deque of tasks and its own normals
+// buffer. Workers pop their own deque newest first and steal the oldest
+// task of another worker when theirs is empty.
+//
+// A plain pseudo-random European job is one task over all of its path
+// blocks. While other workers are idle, a worker running such a task
+// hands the upper half of its remaining blocks back to its deque, so a
+// single large job spreads across every core while a batch of small ones
+// runs one job per worker with no splitting at all. Other jobs (the
+// remaining engines, and European runs that are adaptive, progressive or
+// Sobol) run whole on one worker. A Pde job is a single-option solve;
+// whole chains are cheaper through FinanceMonteCarlo::pde_chain, which
+// fills every SIMD lane.
+//
+// Every job is priced exactly as FinanceMonteCarlo(n, seed) would price
+// it: the block sums are folded in block order, so results are
+// bit-identical however the work was split.
+class PricingService {
+public:
+    typedef std::function<void(size_t index, const PricingResult& result)> JobCallback;
+
+    PricingService(int num_threads, uint64_t seed);
+
+    // Finishes every job already submitted, then joins the workers
+    ~PricingService();
+
+    PricingService(const PricingService&) = delete;
+    PricingService& operator=(const PricingService&) = delete;
+
+    int num_threads() const { return static_cast<int>(workers_.size()); }
+    uint64_t seed() const { return rng_.seed(); }
+
+    // Queues the jobs and returns one future per job, in order. on_done,
+    // when set, is called on a worker thread with the job's index in jobs
+    // as each one finishes, before its future becomes ready; a job that
+    // throws skips it and stores the exception in its future.
+    std::vector<std::future<PricingResult>> submit(const std::vector<PricingJob>& jobs,
+                                                   JobCallback on_done = nullptr);
+    std::future<PricingResult> submit(const PricingJob& job);
+
+private:
+    struct Job;
+
+    // Blocks [first_block, end_block) of a split job, or the whole job
+    struct Task {
+        std::shared_ptr<Job> job;
+        long long first_block;
+        long long end_block;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::vector<double> z;      // normals of one path block
+        std::thread thread;
+    };
+
+    CounterRng rng_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<long long> queued_{0};     // tasks sitting in any deque
+    std::atomic<int> idle_{0};             // workers waiting for tasks
+    std::atomic<size_t> next_worker_{0};   // round-robin target of submit
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+
+    void push(size_t worker, Task task);
+    bool pop(size_t worker, Task& task);
+    void run_worker(size_t worker);
+    void run_task(size_t worker, Task& task);
+    void run_whole(Job& job);
+};
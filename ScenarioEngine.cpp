@@ -0,0 +1,162 @@
+#include "ScenarioEngine.h"
+#include "BlackScholesBatch.h"
+#include "SimdKernels.h"
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// Positions per reduction block and per cache tile. A tile's invariants
+// (seven arrays) stay in L1 while every scenario sweeps over it.
+const size_t kPositionBlock = 4096;
+const size_t kScenarioTile = 256;
+
+struct TileInvariants {
+    double S[kScenarioTile];
+    double log_moneyness[kScenarioTile];
+    double Kdf[kScenarioTile];
+    double sqrtT[kScenarioTile];
+    double v[kScenarioTile];
+    double quantity[kScenarioTile];
+    unsigned char is_call[kScenarioTile];
+
+    ScenarioInvariants view() const {
+        return ScenarioInvariants{S, log_moneyness, Kdf, sqrtT, v, quantity, is_call};
+    }
+};
+
+void load_tile(const OptionChain& chain, const double* quantity, size_t begin, size_t n,
+               TileInvariants& t) {
+    for (size_t j = 0; j < n; ++j) {
+        size_t i = begin + j;
+        double rT = chain.r[i] * chain.T[i];
+        t.S[j] = chain.S[i];
+        t.log_moneyness[j] = std::log(chain.S[i] / chain.K[i]) + rT;
+        t.Kdf[j] = chain.K[i] * std::exp(-rT);
+        t.sqrtT[j] = std::sqrt(chain.T[i]);
+        t.v[j] = chain.v[i];
+        t.quantity[j] = quantity ? quantity[i] : 1.0;
+        t.is_call[j] = chain.is_call[i];
+    }
+}
+
+} // namespace
+
+ScenarioEngine::ScenarioEngine(std::vector<Scenario> scenarios, int num_threads)
+    : scenarios_(std::move(scenarios)), num_threads_(num_threads) {
+    if (scenarios_.empty()) {
+        throw std::invalid_argument("ScenarioEngine: need at least one scenario");
+    }
+    for (const Scenario& s : scenarios_) {
+        if (!(s.weight >= 0) || !(s.spot_shift > -1)) {
+            throw std::invalid_argument("ScenarioEngine: weights must be >= 0 and spot shifts > -1");
+        }
+    }
+    reset();
+}
+
+std::vector<Scenario> ScenarioEngine::grid(const std::vector<double>& spot_shifts,
+                                           const std::vector<double>& vol_shifts) {
+    std::vector<Scenario> out;
+    out.reserve(spot_shifts.size() * vol_shifts.size());
+    for (double ds : spot_shifts) {
+        for (double dv : vol_shifts) {
+            out.push_back(Scenario{ds, dv});
+        }
+    }
+    return out;
+}
+
+void ScenarioEngine::reset() {
+    values_.assign(scenarios_.size() + 1, 0.0);
+}
+
+void ScenarioEngine::add(const OptionChain& chain, const double* quantity) {
+    const size_t n = chain.size();
+    const size_t width = values_.size();
+    const long long blocks = static_cast<long long>((n + kPositionBlock - 1) / kPositionBlock);
+    std::vector<double> block_sums(static_cast<size_t>(blocks) * width, 0.0);
+    const SimdKernels& kernels = simd_kernels();
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        TileInvariants tile;
+
+        #pragma omp for schedule(dynamic)
+        for (long long b = 0; b < blocks; ++b) {
+            double* sums = &block_sums[static_cast<size_t>(b) * width];
+            size_t end = std::min(n, static_cast<size_t>(b + 1) * kPositionBlock);
+            for (size_t begin = static_cast<size_t>(b) * kPositionBlock; begin < end; begin += kScenarioTile) {
+                size_t count = std::min(kScenarioTile, end - begin);
+                load_tile(chain, quantity, begin, count, tile);
+                ScenarioInvariants inv = tile.view();
+                for (size_t s = 0; s < scenarios_.size(); ++s) {
+                    sums[s] += kernels.scenario_value(inv, count, 1 + scenarios_[s].spot_shift,
+                                                      scenarios_[s].vol_shift);
+                }
+                sums[width - 1] += kernels.scenario_value(inv, count, 1.0, 0.0);
+            }
+        }
+    }
+
+    for (long long b = 0; b < blocks; ++b) {
+        const double* partial = &block_sums[static_cast<size_t>(b) * width];
+        for (size_t s = 0; s < width; ++s) {
+            values_[s] += partial[s];
+        }
+    }
+}
+
+ScenarioResult ScenarioEngine::result(double confidence) const {
+    if (!(confidence > 0 && confidence <= 1)) {
+        throw std::invalid_argument("ScenarioEngine::result: confidence must be in (0, 1]");
+    }
+    const size_t m = scenarios_.size();
+    ScenarioResult r;
+    r.base_value = values_[m];
+    r.pnl.resize(m);
+    for (size_t s = 0; s < m; ++s) {
+        r.pnl[s] = values_[s] - r.base_value;
+    }
+
+    // Walk the losses from the largest down until the tail holds
+    // 1 - confidence of the weight; the last scenario needed is only
+    // partly inside the tail
+    std::vector<size_t> order(m);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return r.pnl[a] < r.pnl[b]; });
+    r.worst_scenario = order[0];
+
+    double total = 0;
+    for (const Scenario& s : scenarios_) {
+        total += s.weight;
+    }
+    const double tail = (1 - confidence) * total;
+    double mass = 0;
+    double loss_sum = 0;
+    r.var = -r.pnl[order[0]];
+    r.expected_shortfall = r.var;
+    for (size_t k = 0; k < m && tail > 0; ++k) {
+        double w = scenarios_[order[k]].weight;
+        if (w == 0) {
+            continue;
+        }
+        bool last = mass + w >= tail;
+        if (last) {
+            w = tail - mass;
+        }
+        mass += w;
+        loss_sum += w * -r.pnl[order[k]];
+        r.var = -r.pnl[order[k]];
+        if (last) {
+            break;
+        }
+    }
+    if (mass > 0) {
+        r.expected_shortfall = loss_sum / mass;
+    }
+    return r;
+}
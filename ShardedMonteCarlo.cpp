@@ -0,0 +1,419 @@
+#include "ShardedMonteCarlo.h"
+#include "EuropeanSweep.h"
+#include "McStatistics.h"
+#include "PathEngine.h"
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+enum ShardStatus : uint8_t {
+    kShardOk,
+    kShardError
+};
+
+// Writes all of [data, data + n); throws on a closed or broken pipe
+void write_exact(int fd, const void* data, size_t n) {
+    const char* p = static_cast<const char*>(data);
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            throw std::runtime_error(std::string("shard pipe write failed: ") + std::strerror(errno));
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+}
+
+// Reads exactly n bytes. Returns false on end of input before the first
+// byte; end of input part way through throws.
+bool read_exact(int fd, void* data, size_t n) {
+    char* p = static_cast<char*>(data);
+    size_t got = 0;
+    while (got < n) {
+        ssize_t r = ::read(fd, p + got, n - got);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0) {
+            throw std::runtime_error(std::string("shard pipe read failed: ") + std::strerror(errno));
+        }
+        if (r == 0) {
+            if (got == 0) {
+                return false;
+            }
+            throw std::runtime_error("shard pipe closed mid-message");
+        }
+        got += static_cast<size_t>(r);
+    }
+    return true;
+}
+
+// Fixed-layout message built field by field, so struct padding never goes
+// over the wire
+struct Message {
+    std::vector<char> bytes;
+
+    template <class T>
+    void put(T value) {
+        const char* p = reinterpret_cast<const char*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+};
+
+template <class T>
+T get(int fd) {
+    T value;
+    if (!read_exact(fd, &value, sizeof(T))) {
+        throw std::runtime_error("shard pipe closed mid-message");
+    }
+    return value;
+}
+
+// Only what a shard needs: the parameters, the sampling and the range.
+// Control variates and confidence levels only matter when the coordinator
+// turns the folded sums into a price.
+Message encode_request(const ShardRequest& r) {
+    const OptionParams& p = r.job.params;
+    Message m;
+    m.put<int32_t>(static_cast<int32_t>(r.job.engine));
+    m.put(p.S);
+    m.put(p.K);
+    m.put(p.T);
+    m.put(p.r);
+    m.put(p.v);
+    m.put<int64_t>(p.numSamples);
+    m.put<int32_t>(p.numSteps);
+    m.put<int32_t>(static_cast<int32_t>(p.payoff.type));
+    m.put<uint8_t>(p.payoff.is_call);
+    m.put(p.payoff.barrier);
+    m.put<uint8_t>(p.payoff.continuity_correction);
+    m.put<uint8_t>(r.job.is_call);
+    m.put<uint8_t>(r.job.options.antithetic);
+    m.put<uint64_t>(r.seed);
+    m.put<int64_t>(r.first_block);
+    m.put<int64_t>(r.end_block);
+    return m;
+}
+
+// False on end of input between requests
+bool decode_request(int fd, ShardRequest& r) {
+    int32_t engine;
+    if (!read_exact(fd, &engine, sizeof(engine))) {
+        return false;
+    }
+    r = ShardRequest{};
+    OptionParams& p = r.job.params;
+    r.job.engine = static_cast<PricingEngine>(engine);
+    p.S = get<double>(fd);
+    p.K = get<double>(fd);
+    p.T = get<double>(fd);
+    p.r = get<double>(fd);
+    p.v = get<double>(fd);
+    p.numSamples = get<int64_t>(fd);
+    p.numSteps = get<int32_t>(fd);
+    p.payoff.type = static_cast<PayoffType>(get<int32_t>(fd));
+    p.payoff.is_call = get<uint8_t>(fd) != 0;
+    p.payoff.barrier = get<double>(fd);
+    p.payoff.continuity_correction = get<uint8_t>(fd) != 0;
+    r.job.is_call = get<uint8_t>(fd) != 0;
+    r.job.options.antithetic = get<uint8_t>(fd) != 0;
+    r.seed = get<uint64_t>(fd);
+    r.first_block = get<int64_t>(fd);
+    r.end_block = get<int64_t>(fd);
+    return true;
+}
+
+size_t sums_per_block(PricingEngine engine) {
+    return engine == PricingEngine::European ? kNumEuropeanSums : kNumPathSums;
+}
+
+template <size_t N>
+std::vector<double> flatten(const std::vector<std::array<double, N>>& blocks) {
+    std::vector<double> out;
+    out.reserve(blocks.size() * N);
+    for (const std::array<double, N>& b : blocks) {
+        out.insert(out.end(), b.begin(), b.end());
+    }
+    return out;
+}
+
+void set_cloexec(int fd) {
+    ::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+// SIGPIPE is ignored while any coordinator is alive, so that a worker that
+// dies surfaces as a failed write rather than ending this process; the
+// host's own handler is put back when the last coordinator shuts down
+std::mutex sigpipe_mutex;
+int sigpipe_users = 0;
+void (*sigpipe_previous)(int) = SIG_DFL;
+
+void ignore_sigpipe() {
+    std::lock_guard<std::mutex> lock(sigpipe_mutex);
+    if (sigpipe_users++ == 0) {
+        sigpipe_previous = std::signal(SIGPIPE, SIG_IGN);
+    }
+}
+
+void restore_sigpipe() {
+    std::lock_guard<std::mutex> lock(sigpipe_mutex);
+    if (--sigpipe_users == 0) {
+        std::signal(SIGPIPE, sigpipe_previous);
+    }
+}
+
+} // namespace
+
+long long shard_blocks(const PricingJob& job) {
+    const OptionParams& p = job.params;
+    const McOptions& o = job.options;
+    if (job.engine != PricingEngine::European && job.engine != PricingEngine::PathDependent) {
+        throw std::invalid_argument("ShardedMonteCarlo: only European and path-dependent jobs can be sharded");
+    }
+    if (o.sampler != Sampler::PseudoRandom || o.target_std_error > 0 || o.progress || o.cancel ||
+        o.single_precision) {
+        throw std::invalid_argument("ShardedMonteCarlo: only plain double-precision pseudo-random runs can be sharded");
+    }
+    if (p.numSamples < (job.engine == PricingEngine::European ? 1 : 2)) {
+        throw std::invalid_argument("ShardedMonteCarlo: too few samples");
+    }
+    if (job.engine == PricingEngine::PathDependent && p.numSteps < 1) {
+        throw std::invalid_argument("ShardedMonteCarlo: numSteps must be at least 1");
+    }
+    const long long perUnit = o.antithetic ? 2 : 1;
+    const long long units = (p.numSamples + perUnit - 1) / perUnit;
+    return (units + kPathBlock - 1) / kPathBlock;
+}
+
+std::vector<double> run_shard(const ShardRequest& r, int num_threads) {
+    const long long blocks = shard_blocks(r.job);
+    if (r.first_block < 0 || r.first_block > r.end_block || r.end_block > blocks) {
+        throw std::invalid_argument("ShardedMonteCarlo: block range outside the sweep");
+    }
+    const CounterRng rng(r.seed);
+    const size_t n = static_cast<size_t>(r.end_block - r.first_block);
+    const bool antithetic = r.job.options.antithetic;
+    if (r.job.engine == PricingEngine::European) {
+        std::vector<EuropeanSums> sums(n);
+        european_block_range(r.job.params, antithetic, rng, num_threads, r.first_block, r.end_block,
+                             sums.data());
+        return flatten(sums);
+    }
+    std::vector<PathSums> sums(n);
+    path_option_block_sums(r.job.params, antithetic, rng, num_threads, r.first_block, r.end_block,
+                           sums.data());
+    return flatten(sums);
+}
+
+void serve_shards(int in_fd, int out_fd, int num_threads) {
+    ShardRequest request;
+    while (decode_request(in_fd, request)) {
+        Message reply;
+        try {
+            std::vector<double> sums = run_shard(request, num_threads);
+            reply.put<uint8_t>(kShardOk);
+            reply.put<uint64_t>(sums.size());
+            for (double s : sums) {
+                reply.put(s);
+            }
+        }
+        catch (const std::exception& e) {
+            std::string what = e.what();
+            reply.bytes.clear();
+            reply.put<uint8_t>(kShardError);
+            reply.put<uint64_t>(what.size());
+            reply.bytes.insert(reply.bytes.end(), what.begin(), what.end());
+        }
+        write_exact(out_fd, reply.bytes.data(), reply.bytes.size());
+    }
+}
+
+ShardedMonteCarlo::ShardedMonteCarlo(const std::vector<std::string>& worker_commands, uint64_t seed)
+    : seed_(seed), failed_(false), ignoring_sigpipe_(false) {
+    if (worker_commands.empty()) {
+        throw std::invalid_argument("ShardedMonteCarlo needs at least one worker");
+    }
+    ignore_sigpipe();
+    ignoring_sigpipe_ = true;
+
+    for (const std::string& command : worker_commands) {
+        int to[2], from[2];
+        if (::pipe(to) != 0) {
+            shutdown();
+            throw std::runtime_error("cannot create a pipe for " + command);
+        }
+        if (::pipe(from) != 0) {
+            ::close(to[0]);
+            ::close(to[1]);
+            shutdown();
+            throw std::runtime_error("cannot create a pipe for " + command);
+        }
+        // Later workers must not inherit these ends, or a worker would
+        // never see its input close
+        for (int fd : {to[0], to[1], from[0], from[1]}) {
+            set_cloexec(fd);
+        }
+
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::dup2(to[0], STDIN_FILENO);
+            ::dup2(from[1], STDOUT_FILENO);
+            ::execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+            ::_exit(127);
+        }
+        ::close(to[0]);
+        ::close(from[1]);
+        if (pid < 0) {
+            ::close(to[1]);
+            ::close(from[0]);
+            shutdown();
+            throw std::runtime_error("cannot start " + command);
+        }
+        workers_.push_back(Worker{pid, to[1], from[0]});
+    }
+}
+
+ShardedMonteCarlo::~ShardedMonteCarlo() {
+    shutdown();
+}
+
+void ShardedMonteCarlo::shutdown() {
+    for (Worker& w : workers_) {
+        ::close(w.to);
+    }
+    for (Worker& w : workers_) {
+        ::close(w.from);
+        int status;
+        while (::waitpid(w.pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+    workers_.clear();
+    if (ignoring_sigpipe_) {
+        restore_sigpipe();
+        ignoring_sigpipe_ = false;
+    }
+}
+
+void ShardedMonteCarlo::fail() {
+    // The pipes may hold half a message, so no later request could be
+    // matched to its reply: stop the workers rather than wait for shards
+    // nobody will read
+    failed_ = true;
+    for (Worker& w : workers_) {
+        ::kill(w.pid, SIGTERM);
+    }
+    shutdown();
+}
+
+PricingResult ShardedMonteCarlo::price(const PricingJob& job) {
+    if (failed_) {
+        throw std::runtime_error("ShardedMonteCarlo: shut down after an earlier worker failure");
+    }
+    const long long blocks = shard_blocks(job);
+    const size_t width = sums_per_block(job.engine);
+    const size_t n = workers_.size();
+
+    // Contiguous, near-equal block ranges; idle workers get none
+    std::vector<long long> bounds(n + 1);
+    for (size_t w = 0; w <= n; ++w) {
+        bounds[w] = static_cast<long long>(static_cast<unsigned long long>(blocks) * w / n);
+    }
+
+    // Any failure past this point leaves the pipes out of step; a worker's
+    // own error reply does not, so it only fails this job
+    std::vector<double> block_sums(static_cast<size_t>(blocks) * width);
+    std::string error;
+    try {
+        for (size_t w = 0; w < n; ++w) {
+            if (bounds[w] < bounds[w + 1]) {
+                Message m = encode_request(ShardRequest{job, seed_, bounds[w], bounds[w + 1]});
+                write_exact(workers_[w].to, m.bytes.data(), m.bytes.size());
+            }
+        }
+
+        // Every reply is read, even after an error reply, so the pipes stay
+        // in step
+        for (size_t w = 0; w < n; ++w) {
+            if (bounds[w] == bounds[w + 1]) {
+                continue;
+            }
+            uint8_t status;
+            if (!read_exact(workers_[w].from, &status, sizeof(status))) {
+                throw std::runtime_error("shard worker " + std::to_string(w) + " exited");
+            }
+            uint64_t count = get<uint64_t>(workers_[w].from);
+            if (status != kShardOk) {
+                std::string what(count, '\0');
+                if (!read_exact(workers_[w].from, &what[0], what.size())) {
+                    throw std::runtime_error("shard pipe closed mid-message");
+                }
+                if (error.empty()) {
+                    error = "shard worker " + std::to_string(w) + ": " + what;
+                }
+                continue;
+            }
+            if (count != static_cast<uint64_t>(bounds[w + 1] - bounds[w]) * width) {
+                throw std::runtime_error("shard worker " + std::to_string(w) +
+                                         " returned the wrong number of sums");
+            }
+            if (!read_exact(workers_[w].from, &block_sums[static_cast<size_t>(bounds[w]) * width],
+                            count * sizeof(double))) {
+                throw std::runtime_error("shard pipe closed mid-message");
+            }
+        }
+    }
+    catch (...) {
+        fail();
+        throw;
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+
+    // Fold in block order, exactly as the single-process sweep does
+    const OptionParams& p = job.params;
+    const McOptions& opts = job.options;
+    const long long perUnit = opts.antithetic ? 2 : 1;
+    const long long units = (p.numSamples + perUnit - 1) / perUnit;
+    FinanceMonteCarlo bs(1, seed_);
+    PricingResult result{};
+
+    if (job.engine == PricingEngine::European) {
+        EuropeanSums sum{};
+        for (long long b = 0; b < blocks; ++b) {
+            for (size_t k = 0; k < width; ++k) {
+                sum[k] += block_sums[static_cast<size_t>(b) * width + k];
+            }
+        }
+        const double callBS = opts.control_variate ? bs.black_scholes_price(p, true) : 0.0;
+        const double putBS = opts.control_variate ? bs.black_scholes_price(p, false) : 0.0;
+        result.european = european_result(p, opts, sum, units, callBS, putBS);
+        const McLegResult& leg = job.is_call ? result.european.call : result.european.put;
+        result.price = McPriceResult{leg.price, leg.std_error, leg.ci_low, leg.ci_high,
+                                     result.european.samples};
+        return result;
+    }
+
+    PathSums sum{};
+    for (long long b = 0; b < blocks; ++b) {
+        for (size_t k = 0; k < width; ++k) {
+            sum[k] += block_sums[static_cast<size_t>(b) * width + k];
+        }
+    }
+    const double controlMean = opts.control_variate
+        ? bs.black_scholes_price(p, p.payoff.is_call) * std::exp(p.r * p.T)
+        : 0.0;
+    result.price = path_result(p, opts, sum, units, controlMean);
+    return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "PricingService.h"
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// One shard of a job: blocks [first_block, end_block) of its pseudo-random
+// sweep under the given seed
+struct ShardRequest {
+    PricingJob job;
+    uint64_t seed;
+    long long first_block;
+    long long end_block;
+};
+
+// kPathBlock blocks in the job's sweep. Throws std::invalid_argument for a
+// job that cannot be sharded: only plain pseudo-random European and
+// path-dependent runs can, not adaptive, progressive, Sobol or American ones.
+long long shard_blocks(const PricingJob& job);
+
+// Block sums of one shard, block by block (kNumEuropeanSums or kNumPathSums
+// doubles each), computed on num_threads threads
+std::vector<double> run_shard(const ShardRequest& request, int num_threads);
+
+// Worker side of ShardedMonteCarlo: answers the requests read from in_fd on
+// out_fd until in_fd is closed. A failed request is answered with its
+// error message and the worker carries on.
+void serve_shards(int in_fd, int out_fd, int num_threads);
+
+// Coordinator that spreads each job's path blocks over worker processes.
+// Every worker gets a contiguous range of blocks; since normal i of a
+// stream depends only on the seed and i, shards draw disjoint substreams
+// without any setup. The workers return one set of sums per block and the
+// coordinator folds them in block order, so prices, errors and greeks are
+// bit-identical to FinanceMonteCarlo(n, seed) in a single process.
+//
+// Workers are commands run with /bin/sh -c and spoken to over their stdin
+// and stdout, e.g. "mc_pricer --shard-worker" on this host or
+// "ssh host mc_pricer --shard-worker" on another. Requests and sums go in
+// the native byte order, so all hosts must share it.
+//
+// SIGPIPE is process-wide: while any coordinator is alive it is ignored,
+// so that a worker that dies shows up as a failed write instead of
+// killing the host process. The handler in place before the first
+// coordinator started is restored when the last one shuts down; a handler
+// installed by the host in between is overwritten at that point.
+class ShardedMonteCarlo {
+public:
+    // Throws std::runtime_error if a worker cannot be started
+    ShardedMonteCarlo(const std::vector<std::string>& worker_commands, uint64_t seed);
+
+    // Closes the workers' input, waits for them to exit and restores
+    // SIGPIPE
+    ~ShardedMonteCarlo();
+
+    ShardedMonteCarlo(const ShardedMonteCarlo&) = delete;
+    ShardedMonteCarlo& operator=(const ShardedMonteCarlo&) = delete;
+
+    size_t num_workers() const { return workers_.size(); }
+
+    // Prices one job across all workers. Throws std::invalid_argument as
+    // shard_blocks does, before anything is sent. A worker that reports an
+    // error fails only this job (std::runtime_error). A worker that dies, a
+    // broken pipe or a malformed reply leaves the pipes out of step: the
+    // workers are stopped and this and every later call throw
+    // std::runtime_error.
+    PricingResult price(const PricingJob& job);
+
+    // False once a worker failure has shut the coordinator down
+    bool healthy() const { return !failed_; }
+
+private:
+    struct Worker {
+        pid_t pid;
+        int to;         // worker's stdin
+        int from;       // worker's stdout
+    };
+
+    uint64_t seed_;
+    std::vector<Worker> workers_;
+    bool failed_;
+    bool ignoring_sigpipe_;
+
+    void shutdown();
+
+    // Marks the coordinator failed and stops the workers
+    void fail();
+};
@@ -0,0 +1,122 @@
+#include "SimdKernels.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Defined by SimdKernelsScalar.cpp, SimdKernelsSse2.cpp, ...; nullptr when
+// the file was not compiled for its instruction set
+extern const SimdKernels* const simd_kernels_scalar;
+extern const SimdKernels* const simd_kernels_sse2;
+extern const SimdKernels* const simd_kernels_avx2;
+extern const SimdKernels* const simd_kernels_avx512;
+
+namespace {
+
+bool cpu_supports(SimdIsa isa) {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    switch (isa) {
+    case SimdIsa::Scalar:
+        return true;
+    case SimdIsa::Sse2:
+        return __builtin_cpu_supports("sse2");
+    case SimdIsa::Avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case SimdIsa::Avx512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+    }
+    return false;
+#else
+    // Without a CPUID query only the baseline the compiler targets is known
+    // to run, and the wider files are only built when it already has them
+    (void)isa;
+    return true;
+#endif
+}
+
+const SimdKernels* compiled_kernels(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::Scalar:
+        return simd_kernels_scalar;
+    case SimdIsa::Sse2:
+        return simd_kernels_sse2;
+    case SimdIsa::Avx2:
+        return simd_kernels_avx2;
+    case SimdIsa::Avx512:
+        return simd_kernels_avx512;
+    }
+    return nullptr;
+}
+
+const char* isa_name(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::Scalar:
+        return "scalar";
+    case SimdIsa::Sse2:
+        return "sse2";
+    case SimdIsa::Avx2:
+        return "avx2";
+    case SimdIsa::Avx512:
+        return "avx512";
+    }
+    return "?";
+}
+
+// The widest instruction set to consider, from MC_SIMD. Returns false when
+// it is unset, or not a known name (reported on stderr), and leaves cap
+// alone.
+bool isa_cap(SimdIsa& cap) {
+    const char* env = std::getenv("MC_SIMD");
+    if (env == nullptr || *env == '\0') {
+        return false;
+    }
+    const SimdIsa names[] = {SimdIsa::Scalar, SimdIsa::Sse2, SimdIsa::Avx2, SimdIsa::Avx512};
+    for (SimdIsa isa : names) {
+        if (std::strcmp(env, isa_name(isa)) == 0) {
+            cap = isa;
+            return true;
+        }
+    }
+    std::fprintf(stderr, "MC_SIMD=%s is not scalar, sse2, avx2 or avx512; ignored\n", env);
+    return false;
+}
+
+const SimdKernels& select_kernels() {
+    const SimdIsa order[] = {SimdIsa::Avx512, SimdIsa::Avx2, SimdIsa::Sse2};
+    SimdIsa cap = SimdIsa::Avx512;
+    const bool capped = isa_cap(cap);
+    const SimdKernels* chosen = simd_kernels_scalar;
+    for (SimdIsa isa : order) {
+        if (isa > cap) {
+            continue;
+        }
+        if (const SimdKernels* k = simd_kernels(isa)) {
+            chosen = k;
+            break;
+        }
+    }
+
+    // Dropping below the requested set unannounced would pass another
+    // build's numbers off as that set's, e.g. under -march=native from the
+    // shell scripts, where the narrower tables compile empty
+    if (capped && chosen->isa != cap) {
+        std::fprintf(stderr, "MC_SIMD=%s: the %s kernels are %s; using %s\n", isa_name(cap),
+                     isa_name(cap),
+                     compiled_kernels(cap) == nullptr ? "not compiled into this build"
+                                                      : "not supported by this CPU",
+                     chosen->name);
+    }
+    return *chosen;
+}
+
+} // namespace
+
+const SimdKernels* simd_kernels(SimdIsa isa) {
+    const SimdKernels* k = compiled_kernels(isa);
+    return k != nullptr && cpu_supports(isa) ? k : nullptr;
+}
+
+const SimdKernels& simd_kernels() {
+    static const SimdKernels& kernels = select_kernels();
+    return kernels;
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Per-block accumulators of the European sweep. Everything the call, the
+// put and their greeks need is a linear function of these sums. The first
+// group runs over individual paths; the squares and cross product run over
+// sampling units (a path, or an antithetic pair averaged together).
+enum EuropeanSum {
+    kCall,          // max(ST - K, 0)
+    kPut,           // max(K - ST, 0)
+    kCallZ,         // call payoff * Z
+    kCallZ2,        // call payoff * Z^2
+    kPutZ,
+    kPutZ2,
+    kCallItmS,      // 1{ST > K} * ST
+    kCallItmSZ,     // 1{ST > K} * ST * Z
+    kCallItmZ,      // 1{ST > K} * Z
+    kPutItmS,       // 1{ST < K} * ST
+    kPutItmSZ,
+    kPutItmZ,
+    kCallSq,        // unit call payoff^2
+    kPutSq,         // unit put payoff^2
+    kCallPut,       // unit call payoff * unit put payoff
+    kNumEuropeanSums
+};
+
+// Terminal spot is S exp(drift + diffusion Z)
+struct EuropeanKernelArgs {
+    double drift;
+    double diffusion;
+    double S;
+    double K;
+};
+
+// Per-option invariants of Black-Scholes revaluation under spot and vol
+// shocks: everything that does not depend on the scenario, as parallel
+// arrays
+struct ScenarioInvariants {
+    const double* S;
+    const double* log_moneyness;    // log(S / K) + r T
+    const double* Kdf;              // K exp(-r T)
+    const double* sqrtT;
+    const double* v;
+    const double* quantity;
+    const unsigned char* is_call;
+};
+
+// Options per Crank-Nicolson batch. Every build runs kPdeLanes / lanes
+// vectors side by side, so the layout does not depend on the instruction
+// set and a scalar batch still has independent work to overlap.
+const int kPdeLanes = 8;
+
+// One batch of kPdeLanes options, each on its own log-spot grid with a
+// common node count. Node arrays are node-major with the options
+// interleaved: element i * kPdeLanes + l is node i of option l. Per-option
+// arrays have kPdeLanes entries. A grid may run in either direction, but
+// early exercise is only solved exactly with the exercise region at the
+// high-index end.
+struct PdeKernelArgs {
+    int nodes;              // boundaries included
+    int steps;              // time steps of dt
+    int rannacher_steps;    // leading steps taken as two fully implicit half steps
+
+    // Spatial operator: (L V)_i = lower_i V_i-1 + diag_i V_i + upper_i V_i+1
+    // at interior nodes
+    const double* lower;
+    const double* diag;
+    const double* upper;
+    const double* exercise; // value floor: the payoff for American options, -infinity otherwise
+
+    const double* dt;
+    const double* r;
+    const double* lo_const; // value at node 0 at time to expiry tau: lo_const + lo_df exp(-r tau)
+    const double* lo_df;
+    const double* hi_const; // likewise at the last node
+    const double* hi_df;
+};
+
+enum class SimdIsa {
+    Scalar,     // one lane, C library exp/log: the reference
+    Sse2,       // two lanes
+    Avx2,       // four lanes with FMA
+    Avx512      // eight lanes
+};
+
+// The hot vectorized kernels, compiled once per instruction set from
+// SimdKernels.inc (SimdKernelsScalar.cpp, SimdKernelsSse2.cpp, ...) and
+// reached through this table. All take any count and mask or pad the
+// last partial vector themselves. Results agree across instruction sets
+// to rounding, not bit for bit: FMA and the vector exp/log differ from the
+// scalar reference in the last bits.
+struct SimdKernels {
+    SimdIsa isa;
+    const char* name;
+    int lanes;
+
+    // Adds the EuropeanSum accumulators of sampling units [0, units) of z
+    // to sums[0, kNumEuropeanSums)
+    void (*european_sums)(const double* z, long long units, const EuropeanKernelArgs& args,
+                          bool antithetic, double* sums);
+
+    // Normals of blocks [first_block, first_block + blocks) of a
+    // CounterRng stream, kNormalBlock per block
+    void (*normal_blocks)(uint64_t seed, uint32_t stream, uint64_t first_block, size_t blocks,
+                          double* out);
+
+    // european_sums over single-precision normals, with float paths and
+    // payoffs; the sums are still carried and returned in double
+    void (*european_sums_f32)(const float* z, long long units, const EuropeanKernelArgs& args,
+                              bool antithetic, double* sums);
+
+    // Single-precision normals of blocks [first_block, first_block + blocks)
+    // of a CounterRng stream, kFloatNormalBlock per block
+    void (*normal_blocks_f32)(uint64_t seed, uint32_t stream, uint64_t first_block, size_t blocks,
+                              float* out);
+
+    // Black-Scholes price and greeks of n options (see black_scholes_batch)
+    void (*black_scholes)(const double* S, const double* K, const double* T, const double* r,
+                          const double* v, const unsigned char* is_call, size_t n,
+                          double* price, double* delta, double* gamma, double* theta, double* vega);
+
+    // Implied vols of n quotes (see implied_volatility_batch)
+    void (*implied_volatility)(const double* S, const double* K, const double* T, const double* r,
+                               const unsigned char* is_call, const double* price, size_t n,
+                               double* vol);
+
+    // Sum over options [0, n) of quantity times the Black-Scholes value
+    // with the spot scaled by spot_factor and vol + vol_shift as the vol
+    double (*scenario_value)(const ScenarioInvariants& inv, size_t n, double spot_factor,
+                             double vol_shift);
+
+    // Steps value (nodes x kPdeLanes, the payoff on entry) back from expiry
+    // to tau = steps dt with Crank-Nicolson, flooring it at the exercise
+    // value within every step. previous receives the values one step short
+    // of the end; work holds 4 * nodes * kPdeLanes doubles.
+    void (*crank_nicolson)(const PdeKernelArgs& args, double* value, double* previous, double* work);
+};
+
+// Normals per Philox block, shared with CounterRng::kBlock
+const int kNormalBlock = 16;
+
+// Single-precision normals per Philox block, shared with
+// CounterRng::kFloatBlock
+const int kFloatNormalBlock = 2 * kNormalBlock;
+
+// Kernels for the widest instruction set that is both compiled in and
+// supported by this CPU, chosen once on first use. MC_SIMD=scalar, sse2,
+// avx2 or avx512 in the environment caps the choice, e.g. to rerun a job
+// against the scalar reference. When the named set is not compiled in or
+// not supported, the next narrower one is used and a warning goes to
+// stderr; an unknown name is reported and ignored.
+const SimdKernels& simd_kernels();
+
+// Kernels for one instruction set, or nullptr if that build is not
+// compiled in or this CPU cannot run it
+const SimdKernels* simd_kernels(SimdIsa isa);
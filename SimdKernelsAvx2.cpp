@@ -0,0 +1,13 @@
+// AVX2+FMA build of the kernels. The build compiles this file with
+// -mavx2 -mfma; without those flags it is left empty.
+#include "SimdKernels.h"
+
+#if defined(__AVX2__) && defined(__FMA__) && !defined(__AVX512F__)
+#define SIMD_KERNELS_ISA SimdIsa::Avx2
+#define SIMD_KERNELS_NAME "avx2"
+#include "SimdKernels.inc"
+
+extern const SimdKernels* const simd_kernels_avx2 = &kKernels;
+#else
+extern const SimdKernels* const simd_kernels_avx2 = nullptr;
+#endif
@@ -0,0 +1,13 @@
+// AVX-512 build of the kernels. The build compiles this file with
+// -mavx512f -mavx512dq; without those flags it is left empty.
+#include "SimdKernels.h"
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+#define SIMD_KERNELS_ISA SimdIsa::Avx512
+#define SIMD_KERNELS_NAME "avx512"
+#include "SimdKernels.inc"
+
+extern const SimdKernels* const simd_kernels_avx512 = &kKernels;
+#else
+extern const SimdKernels* const simd_kernels_avx512 = nullptr;
+#endif
@@ -0,0 +1,7 @@
+// Scalar reference build of the kernels: one lane, C library exp and log
+#define MC_SIMD_SCALAR
+#define SIMD_KERNELS_ISA SimdIsa::Scalar
+#define SIMD_KERNELS_NAME "scalar"
+#include "SimdKernels.inc"
+
+extern const SimdKernels* const simd_kernels_scalar = &kKernels;
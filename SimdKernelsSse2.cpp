@@ -0,0 +1,13 @@
+// SSE2 build of the kernels. The build compiles this file for SSE2 only;
+// without that it is left empty.
+#include "SimdKernels.h"
+
+#if defined(__SSE2__) && !defined(__AVX__)
+#define SIMD_KERNELS_ISA SimdIsa::Sse2
+#define SIMD_KERNELS_NAME "sse2"
+#include "SimdKernels.inc"
+
+extern const SimdKernels* const simd_kernels_sse2 = &kKernels;
+#else
+extern const SimdKernels* const simd_kernels_sse2 = nullptr;
+#endif
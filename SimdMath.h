@@ -0,0 +1,630 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Width-agnostic SIMD helpers. Kernels are written once against vdouble and
+// pick up the widest instruction set enabled for the translation unit:
+// AVX-512 (8 lanes), AVX2+FMA (4 lanes), SSE2 (2 lanes) or a scalar
+// fallback (1 lane); defining MC_SIMD_SCALAR forces the scalar build,
+// which uses the C library's exp and log as a reference. vfloat is the
+// single-precision counterpart with twice the lanes (one in the scalar
+// build) and float-accurate exp, log and sincos. Each width lives
+// in its own namespace, so translation units compiled for different
+// instruction sets (see SimdKernels.h) never share an inline definition.
+// Nothing here touches shared state, so every function is safe to call
+// concurrently.
+
+#if defined(MC_SIMD_SCALAR)
+#define VD_NAMESPACE simd_scalar
+#elif defined(__AVX512F__) && defined(__AVX512DQ__)
+#define VD_NAMESPACE simd_avx512
+#elif defined(__AVX2__) && defined(__FMA__)
+#define VD_NAMESPACE simd_avx2
+#elif defined(__SSE2__) || defined(_M_X64)
+#define VD_NAMESPACE simd_sse2
+#else
+#define VD_NAMESPACE simd_scalar
+#define MC_SIMD_SCALAR
+#endif
+
+namespace VD_NAMESPACE {
+
+#if defined(MC_SIMD_SCALAR)
+
+#define VD_LANES 1
+typedef double vdouble;
+typedef bool vmask;
+
+inline vdouble vd_set1(double x) { return x; }
+inline vdouble vd_load(const double* p) { return *p; }
+inline void vd_store(double* p, vdouble a) { *p = a; }
+inline vdouble vd_add(vdouble a, vdouble b) { return a + b; }
+inline vdouble vd_sub(vdouble a, vdouble b) { return a - b; }
+inline vdouble vd_mul(vdouble a, vdouble b) { return a * b; }
+inline vdouble vd_div(vdouble a, vdouble b) { return a / b; }
+inline vdouble vd_fmadd(vdouble a, vdouble b, vdouble c) { return a * b + c; }
+inline vdouble vd_fnmadd(vdouble a, vdouble b, vdouble c) { return c - a * b; }
+inline vdouble vd_sqrt(vdouble a) { return std::sqrt(a); }
+inline vdouble vd_max(vdouble a, vdouble b) { return a > b ? a : b; }
+inline vdouble vd_min(vdouble a, vdouble b) { return a < b ? a : b; }
+inline vdouble vd_abs(vdouble a) { return std::fabs(a); }
+inline vdouble vd_round(vdouble a) { return std::nearbyint(a); }
+inline vmask vd_lt(vdouble a, vdouble b) { return a < b; }
+inline vmask vd_gt(vdouble a, vdouble b) { return a > b; }
+inline vdouble vd_select(vmask m, vdouble a, vdouble b) { return m ? a : b; }
+inline double vd_reduce_add(vdouble a) { return a; }
+inline vmask vd_mask_from_bytes(const unsigned char* p) { return *p != 0; }
+
+#elif defined(__AVX512F__) && defined(__AVX512DQ__)
+
+#define VD_LANES 8
+typedef __m512d vdouble;
+typedef __mmask8 vmask;
+
+inline vdouble vd_set1(double x) { return _mm512_set1_pd(x); }
+inline vdouble vd_load(const double* p) { return _mm512_loadu_pd(p); }
+inline void vd_store(double* p, vdouble a) { _mm512_storeu_pd(p, a); }
+inline vdouble vd_add(vdouble a, vdouble b) { return _mm512_add_pd(a, b); }
+inline vdouble vd_sub(vdouble a, vdouble b) { return _mm512_sub_pd(a, b); }
+inline vdouble vd_mul(vdouble a, vdouble b) { return _mm512_mul_pd(a, b); }
+inline vdouble vd_div(vdouble a, vdouble b) { return _mm512_div_pd(a, b); }
+inline vdouble vd_fmadd(vdouble a, vdouble b, vdouble c) { return _mm512_fmadd_pd(a, b, c); }
+inline vdouble vd_fnmadd(vdouble a, vdouble b, vdouble c) { return _mm512_fnmadd_pd(a, b, c); }
+inline vdouble vd_sqrt(vdouble a) { return _mm512_sqrt_pd(a); }
+inline vdouble vd_max(vdouble a, vdouble b) { return _mm512_max_pd(a, b); }
+inline vdouble vd_min(vdouble a, vdouble b) { return _mm512_min_pd(a, b); }
+inline vdouble vd_abs(vdouble a) { return _mm512_abs_pd(a); }
+inline vdouble vd_round(vdouble a) { return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline vmask vd_lt(vdouble a, vdouble b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+inline vmask vd_gt(vdouble a, vdouble b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+inline vdouble vd_select(vmask m, vdouble a, vdouble b) { return _mm512_mask_blend_pd(m, b, a); }
+inline double vd_reduce_add(vdouble a) { return _mm512_reduce_add_pd(a); }
+
+inline vmask vd_mask_from_bytes(const unsigned char* p) {
+    long long bytes;
+    std::memcpy(&bytes, p, sizeof(bytes));
+    __m512i wide = _mm512_cvtepu8_epi64(_mm_cvtsi64_si128(bytes));
+    return _mm512_test_epi64_mask(wide, wide);
+}
+
+// 2^n for integer-valued n in [-1022, 1023]
+inline vdouble vd_pow2i(vdouble n) { return _mm512_scalef_pd(_mm512_set1_pd(1.0), n); }
+
+// Splits positive normal x into mantissa in [1, 2) and unbiased exponent
+inline vdouble vd_frexp(vdouble x, vdouble* e) {
+    *e = _mm512_getexp_pd(x);
+    return _mm512_getmant_pd(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_src);
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+#define VD_LANES 4
+typedef __m256d vdouble;
+typedef __m256d vmask;
+
+inline vdouble vd_set1(double x) { return _mm256_set1_pd(x); }
+inline vdouble vd_load(const double* p) { return _mm256_loadu_pd(p); }
+inline void vd_store(double* p, vdouble a) { _mm256_storeu_pd(p, a); }
+inline vdouble vd_add(vdouble a, vdouble b) { return _mm256_add_pd(a, b); }
+inline vdouble vd_sub(vdouble a, vdouble b) { return _mm256_sub_pd(a, b); }
+inline vdouble vd_mul(vdouble a, vdouble b) { return _mm256_mul_pd(a, b); }
+inline vdouble vd_div(vdouble a, vdouble b) { return _mm256_div_pd(a, b); }
+inline vdouble vd_fmadd(vdouble a, vdouble b, vdouble c) { return _mm256_fmadd_pd(a, b, c); }
+inline vdouble vd_fnmadd(vdouble a, vdouble b, vdouble c) { return _mm256_fnmadd_pd(a, b, c); }
+inline vdouble vd_sqrt(vdouble a) { return _mm256_sqrt_pd(a); }
+inline vdouble vd_max(vdouble a, vdouble b) { return _mm256_max_pd(a, b); }
+inline vdouble vd_min(vdouble a, vdouble b) { return _mm256_min_pd(a, b); }
+inline vdouble vd_abs(vdouble a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+inline vdouble vd_round(vdouble a) { return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline vmask vd_lt(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+inline vmask vd_gt(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+inline vdouble vd_select(vmask m, vdouble a, vdouble b) { return _mm256_blendv_pd(b, a, m); }
+
+inline double vd_reduce_add(vdouble a) {
+    __m128d lo = _mm256_castpd256_pd128(a);
+    __m128d hi = _mm256_extractf128_pd(a, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+inline vmask vd_mask_from_bytes(const unsigned char* p) {
+    int bytes;
+    std::memcpy(&bytes, p, sizeof(bytes));
+    __m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes));
+    return _mm256_castsi256_pd(_mm256_cmpgt_epi64(wide, _mm256_setzero_si256()));
+}
+
+// 2^n for integer-valued n in [-1022, 1023]: park n in the low mantissa bits
+// with the 1.5*2^52 trick, rebias and shift it into the exponent field.
+inline vdouble vd_pow2i(vdouble n) {
+    __m256i bits = _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(6755399441055744.0)));
+    bits = _mm256_sub_epi64(bits, _mm256_set1_epi64x(0x4338000000000000LL - 1023));
+    return _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52));
+}
+
+// Splits positive normal x into mantissa in [1, 2) and unbiased exponent
+inline vdouble vd_frexp(vdouble x, vdouble* e) {
+    __m256i bits = _mm256_castpd_si256(x);
+    __m256i biased = _mm256_or_si256(_mm256_srli_epi64(bits, 52),
+                                     _mm256_set1_epi64x(0x4330000000000000LL));
+    *e = _mm256_sub_pd(_mm256_castsi256_pd(biased), _mm256_set1_pd(4503599627370496.0 + 1023.0));
+    __m256i mant = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                   _mm256_set1_epi64x(0x3FF0000000000000LL));
+    return _mm256_castsi256_pd(mant);
+}
+
+#else
+
+#define VD_LANES 2
+typedef __m128d vdouble;
+typedef __m128d vmask;
+
+inline vdouble vd_set1(double x) { return _mm_set1_pd(x); }
+inline vdouble vd_load(const double* p) { return _mm_loadu_pd(p); }
+inline void vd_store(double* p, vdouble a) { _mm_storeu_pd(p, a); }
+inline vdouble vd_add(vdouble a, vdouble b) { return _mm_add_pd(a, b); }
+inline vdouble vd_sub(vdouble a, vdouble b) { return _mm_sub_pd(a, b); }
+inline vdouble vd_mul(vdouble a, vdouble b) { return _mm_mul_pd(a, b); }
+inline vdouble vd_div(vdouble a, vdouble b) { return _mm_div_pd(a, b); }
+// No FMA before AVX2: multiply and add round separately
+inline vdouble vd_fmadd(vdouble a, vdouble b, vdouble c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+inline vdouble vd_fnmadd(vdouble a, vdouble b, vdouble c) { return _mm_sub_pd(c, _mm_mul_pd(a, b)); }
+inline vdouble vd_sqrt(vdouble a) { return _mm_sqrt_pd(a); }
+inline vdouble vd_max(vdouble a, vdouble b) { return _mm_max_pd(a, b); }
+inline vdouble vd_min(vdouble a, vdouble b) { return _mm_min_pd(a, b); }
+inline vdouble vd_abs(vdouble a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+inline vmask vd_lt(vdouble a, vdouble b) { return _mm_cmplt_pd(a, b); }
+inline vmask vd_gt(vdouble a, vdouble b) { return _mm_cmpgt_pd(a, b); }
+inline vdouble vd_select(vmask m, vdouble a, vdouble b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+inline double vd_reduce_add(vdouble a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+
+// Round to nearest (even) by adding and removing 1.5*2^52, valid for
+// |a| < 2^51, which covers every use here; SSE2 has no rounding instruction
+inline vdouble vd_round(vdouble a) {
+    const __m128d magic = _mm_set1_pd(6755399441055744.0);
+    return _mm_sub_pd(_mm_add_pd(a, magic), magic);
+}
+
+inline vmask vd_mask_from_bytes(const unsigned char* p) {
+    return _mm_castsi128_pd(_mm_set_epi64x(p[1] ? -1 : 0, p[0] ? -1 : 0));
+}
+
+// 2^n for integer-valued n in [-1022, 1023], as in the AVX2 version
+inline vdouble vd_pow2i(vdouble n) {
+    __m128i bits = _mm_castpd_si128(_mm_add_pd(n, _mm_set1_pd(6755399441055744.0)));
+    bits = _mm_sub_epi64(bits, _mm_set1_epi64x(0x4338000000000000LL - 1023));
+    return _mm_castsi128_pd(_mm_slli_epi64(bits, 52));
+}
+
+// Splits positive normal x into mantissa in [1, 2) and unbiased exponent
+inline vdouble vd_frexp(vdouble x, vdouble* e) {
+    __m128i bits = _mm_castpd_si128(x);
+    __m128i biased = _mm_or_si128(_mm_srli_epi64(bits, 52), _mm_set1_epi64x(0x4330000000000000LL));
+    *e = _mm_sub_pd(_mm_castsi128_pd(biased), _mm_set1_pd(4503599627370496.0 + 1023.0));
+    __m128i mant = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                _mm_set1_epi64x(0x3FF0000000000000LL));
+    return _mm_castsi128_pd(mant);
+}
+
+#endif
+
+// e^x, accurate to about 1 ulp on [-708, 709]
+inline vdouble vd_exp(vdouble x) {
+#if VD_LANES == 1
+    return std::exp(x);
+#else
+    x = vd_min(vd_max(x, vd_set1(-708.0)), vd_set1(709.0));
+    vdouble n = vd_round(vd_mul(x, vd_set1(1.4426950408889634)));
+    vdouble r = vd_fnmadd(n, vd_set1(6.93147180369123816490e-01), x);
+    r = vd_fnmadd(n, vd_set1(1.90821492927058770002e-10), r);
+
+    // Taylor series to r^13 is below double rounding for |r| <= ln(2)/2
+    vdouble p = vd_set1(1.0 / 6227020800.0);
+    p = vd_fmadd(p, r, vd_set1(1.0 / 479001600.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 39916800.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 3628800.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 362880.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 40320.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 5040.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 720.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 120.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 24.0));
+    p = vd_fmadd(p, r, vd_set1(1.0 / 6.0));
+    p = vd_fmadd(p, r, vd_set1(0.5));
+    p = vd_fmadd(p, r, vd_set1(1.0));
+    p = vd_fmadd(p, r, vd_set1(1.0));
+    return vd_mul(p, vd_pow2i(n));
+#endif
+}
+
+// Natural log for positive normal x
+inline vdouble vd_log(vdouble x) {
+#if VD_LANES == 1
+    return std::log(x);
+#else
+    vdouble e;
+    vdouble m = vd_frexp(x, &e);
+    vmask big = vd_gt(m, vd_set1(1.4142135623730951));
+    m = vd_select(big, vd_mul(m, vd_set1(0.5)), m);
+    e = vd_select(big, vd_add(e, vd_set1(1.0)), e);
+
+    // log(m) = 2 atanh(s), |s| <= 0.1716 so the odd series converges fast
+    vdouble s = vd_div(vd_sub(m, vd_set1(1.0)), vd_add(m, vd_set1(1.0)));
+    vdouble s2 = vd_mul(s, s);
+    vdouble p = vd_set1(1.0 / 21.0);
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 19.0));
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 17.0));
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 15.0));
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 13.0));
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 11.0));
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 9.0));
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 7.0));
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 5.0));
+    p = vd_fmadd(p, s2, vd_set1(1.0 / 3.0));
+    vdouble logm = vd_fmadd(vd_mul(vd_add(s, s), s2), p, vd_add(s, s));
+    logm = vd_fmadd(e, vd_set1(1.90821492927058770002e-10), logm);
+    return vd_fmadd(e, vd_set1(6.93147180369123816490e-01), logm);
+#endif
+}
+
+// Standard normal density
+inline vdouble vd_norm_pdf(vdouble x) {
+    return vd_mul(vd_exp(vd_mul(vd_set1(-0.5), vd_mul(x, x))), vd_set1(0.3989422804014327));
+}
+
+// Standard normal CDF, Hart's double precision rational approximation as
+// given by West (2005). Both branches are evaluated and blended so the
+// function stays branch-free.
+inline vdouble vd_norm_cdf(vdouble x) {
+    vdouble a = vd_abs(x);
+    vdouble e = vd_exp(vd_mul(vd_set1(-0.5), vd_mul(a, a)));
+
+    vdouble num = vd_set1(3.52624965998911e-02);
+    num = vd_fmadd(num, a, vd_set1(0.700383064443688));
+    num = vd_fmadd(num, a, vd_set1(6.37396220353165));
+    num = vd_fmadd(num, a, vd_set1(33.912866078383));
+    num = vd_fmadd(num, a, vd_set1(112.079291497871));
+    num = vd_fmadd(num, a, vd_set1(221.213596169931));
+    num = vd_fmadd(num, a, vd_set1(220.206867912376));
+    vdouble den = vd_set1(8.83883476483184e-02);
+    den = vd_fmadd(den, a, vd_set1(1.75566716318264));
+    den = vd_fmadd(den, a, vd_set1(16.064177579207));
+    den = vd_fmadd(den, a, vd_set1(86.7807322029461));
+    den = vd_fmadd(den, a, vd_set1(296.564248779674));
+    den = vd_fmadd(den, a, vd_set1(637.333633378831));
+    den = vd_fmadd(den, a, vd_set1(793.826512519948));
+    den = vd_fmadd(den, a, vd_set1(440.413735824752));
+    vdouble central = vd_div(vd_mul(e, num), den);
+
+    // Continued fraction for the far tail
+    vdouble cf = vd_add(a, vd_set1(0.65));
+    cf = vd_add(a, vd_div(vd_set1(4.0), cf));
+    cf = vd_add(a, vd_div(vd_set1(3.0), cf));
+    cf = vd_add(a, vd_div(vd_set1(2.0), cf));
+    cf = vd_add(a, vd_div(vd_set1(1.0), cf));
+    vdouble tail = vd_div(e, vd_mul(cf, vd_set1(2.506628274631)));
+
+    vdouble c = vd_select(vd_lt(a, vd_set1(7.07106781186547)), central, tail);
+    c = vd_select(vd_gt(a, vd_set1(37.0)), vd_set1(0.0), c);
+    return vd_select(vd_gt(x, vd_set1(0.0)), vd_sub(vd_set1(1.0), c), c);
+}
+
+// sin(2 pi u) and cos(2 pi u) for u in [0, 1]. The argument is reduced to an
+// octant around the nearest quarter turn, so no Cody-Waite reduction is needed.
+inline void vd_sincos_2pi(vdouble u, vdouble* s, vdouble* c) {
+    vdouble q = vd_round(vd_mul(u, vd_set1(4.0)));
+    vdouble x = vd_mul(vd_fnmadd(q, vd_set1(0.25), u), vd_set1(6.283185307179586));
+    vdouble x2 = vd_mul(x, x);
+
+    vdouble sp = vd_set1(-1.0 / 1307674368000.0);
+    sp = vd_fmadd(sp, x2, vd_set1(1.0 / 6227020800.0));
+    sp = vd_fmadd(sp, x2, vd_set1(-1.0 / 39916800.0));
+    sp = vd_fmadd(sp, x2, vd_set1(1.0 / 362880.0));
+    sp = vd_fmadd(sp, x2, vd_set1(-1.0 / 5040.0));
+    sp = vd_fmadd(sp, x2, vd_set1(1.0 / 120.0));
+    sp = vd_fmadd(sp, x2, vd_set1(-1.0 / 6.0));
+    vdouble sx = vd_fmadd(vd_mul(sp, x2), x, x);
+
+    vdouble cp = vd_set1(1.0 / 20922789888000.0);
+    cp = vd_fmadd(cp, x2, vd_set1(-1.0 / 87178291200.0));
+    cp = vd_fmadd(cp, x2, vd_set1(1.0 / 479001600.0));
+    cp = vd_fmadd(cp, x2, vd_set1(-1.0 / 3628800.0));
+    cp = vd_fmadd(cp, x2, vd_set1(1.0 / 40320.0));
+    cp = vd_fmadd(cp, x2, vd_set1(-1.0 / 720.0));
+    cp = vd_fmadd(cp, x2, vd_set1(1.0 / 24.0));
+    cp = vd_fmadd(cp, x2, vd_set1(-0.5));
+    vdouble cx = vd_fmadd(cp, x2, vd_set1(1.0));
+
+    // Rotate by the quarter turns: odd quadrants swap sin/cos, then fix signs
+    q = vd_select(vd_gt(q, vd_set1(3.5)), vd_sub(q, vd_set1(4.0)), q);
+    vdouble half = vd_mul(q, vd_set1(0.5));
+    vmask odd = vd_gt(vd_abs(vd_sub(half, vd_round(half))), vd_set1(0.25));
+    vdouble sr = vd_select(odd, cx, sx);
+    vdouble cr = vd_select(odd, sx, cx);
+    vdouble zero = vd_set1(0.0);
+    *s = vd_select(vd_gt(q, vd_set1(1.5)), vd_sub(zero, sr), sr);
+    *c = vd_select(vd_lt(vd_abs(vd_sub(q, vd_set1(1.5))), vd_set1(1.0)), vd_sub(zero, cr), cr);
+}
+
+// Inverse standard normal CDF for p in (0, 1), Acklam's rational
+// approximation (relative error below 1.2e-9). Central and tail branches are
+// both evaluated and blended.
+inline vdouble vd_inv_norm_cdf(vdouble p) {
+    vdouble one = vd_set1(1.0);
+    vdouble q = vd_sub(p, vd_set1(0.5));
+    vdouble r = vd_mul(q, q);
+    vdouble num = vd_set1(-3.969683028665376e+01);
+    num = vd_fmadd(num, r, vd_set1(2.209460984245205e+02));
+    num = vd_fmadd(num, r, vd_set1(-2.759285104469687e+02));
+    num = vd_fmadd(num, r, vd_set1(1.383577518672690e+02));
+    num = vd_fmadd(num, r, vd_set1(-3.066479806614716e+01));
+    num = vd_fmadd(num, r, vd_set1(2.506628277459239e+00));
+    vdouble den = vd_set1(-5.447609879822406e+01);
+    den = vd_fmadd(den, r, vd_set1(1.615858368580409e+02));
+    den = vd_fmadd(den, r, vd_set1(-1.556989798598866e+02));
+    den = vd_fmadd(den, r, vd_set1(6.680131188771972e+01));
+    den = vd_fmadd(den, r, vd_set1(-1.328068155288572e+01));
+    den = vd_fmadd(den, r, one);
+    vdouble central = vd_div(vd_mul(num, q), den);
+
+    vdouble t = vd_sqrt(vd_mul(vd_set1(-2.0), vd_log(vd_min(p, vd_sub(one, p)))));
+    vdouble tn = vd_set1(-7.784894002430293e-03);
+    tn = vd_fmadd(tn, t, vd_set1(-3.223964580411365e-01));
+    tn = vd_fmadd(tn, t, vd_set1(-2.400758277161838e+00));
+    tn = vd_fmadd(tn, t, vd_set1(-2.549732539343734e+00));
+    tn = vd_fmadd(tn, t, vd_set1(4.374664141464968e+00));
+    tn = vd_fmadd(tn, t, vd_set1(2.938163982698783e+00));
+    vdouble td = vd_set1(7.784695709041462e-03);
+    td = vd_fmadd(td, t, vd_set1(3.224671290700398e-01));
+    td = vd_fmadd(td, t, vd_set1(2.445134137142996e+00));
+    td = vd_fmadd(td, t, vd_set1(3.754408661907416e+00));
+    td = vd_fmadd(td, t, one);
+    vdouble tail = vd_div(tn, td);
+    tail = vd_select(vd_gt(q, vd_set1(0.0)), vd_sub(vd_set1(0.0), tail), tail);
+
+    return vd_select(vd_lt(vd_abs(q), vd_set1(0.47575)), central, tail);
+}
+
+// ---- Single precision ----
+
+#if defined(MC_SIMD_SCALAR)
+
+#define VF_LANES 1
+typedef float vfloat;
+typedef bool vfmask;
+
+inline vfloat vf_set1(float x) { return x; }
+inline vfloat vf_load(const float* p) { return *p; }
+inline void vf_store(float* p, vfloat a) { *p = a; }
+inline vfloat vf_add(vfloat a, vfloat b) { return a + b; }
+inline vfloat vf_sub(vfloat a, vfloat b) { return a - b; }
+inline vfloat vf_mul(vfloat a, vfloat b) { return a * b; }
+inline vfloat vf_div(vfloat a, vfloat b) { return a / b; }
+inline vfloat vf_fmadd(vfloat a, vfloat b, vfloat c) { return a * b + c; }
+inline vfloat vf_fnmadd(vfloat a, vfloat b, vfloat c) { return c - a * b; }
+inline vfloat vf_sqrt(vfloat a) { return std::sqrt(a); }
+inline vfloat vf_max(vfloat a, vfloat b) { return a > b ? a : b; }
+inline vfloat vf_min(vfloat a, vfloat b) { return a < b ? a : b; }
+inline vfloat vf_abs(vfloat a) { return std::fabs(a); }
+inline vfloat vf_round(vfloat a) { return std::nearbyint(a); }
+inline vfmask vf_lt(vfloat a, vfloat b) { return a < b; }
+inline vfmask vf_gt(vfloat a, vfloat b) { return a > b; }
+inline vfloat vf_select(vfmask m, vfloat a, vfloat b) { return m ? a : b; }
+
+// Lanes [0, VD_LANES) and [VD_LANES, 2 VD_LANES) as doubles; the scalar
+// build has a single lane, so hi is zero
+inline void vf_widen(vfloat a, vdouble* lo, vdouble* hi) {
+    *lo = a;
+    *hi = 0.0;
+}
+
+#elif defined(__AVX512F__) && defined(__AVX512DQ__)
+
+#define VF_LANES 16
+typedef __m512 vfloat;
+typedef __mmask16 vfmask;
+
+inline vfloat vf_set1(float x) { return _mm512_set1_ps(x); }
+inline vfloat vf_load(const float* p) { return _mm512_loadu_ps(p); }
+inline void vf_store(float* p, vfloat a) { _mm512_storeu_ps(p, a); }
+inline vfloat vf_add(vfloat a, vfloat b) { return _mm512_add_ps(a, b); }
+inline vfloat vf_sub(vfloat a, vfloat b) { return _mm512_sub_ps(a, b); }
+inline vfloat vf_mul(vfloat a, vfloat b) { return _mm512_mul_ps(a, b); }
+inline vfloat vf_div(vfloat a, vfloat b) { return _mm512_div_ps(a, b); }
+inline vfloat vf_fmadd(vfloat a, vfloat b, vfloat c) { return _mm512_fmadd_ps(a, b, c); }
+inline vfloat vf_fnmadd(vfloat a, vfloat b, vfloat c) { return _mm512_fnmadd_ps(a, b, c); }
+inline vfloat vf_sqrt(vfloat a) { return _mm512_sqrt_ps(a); }
+inline vfloat vf_max(vfloat a, vfloat b) { return _mm512_max_ps(a, b); }
+inline vfloat vf_min(vfloat a, vfloat b) { return _mm512_min_ps(a, b); }
+inline vfloat vf_abs(vfloat a) { return _mm512_abs_ps(a); }
+inline vfloat vf_round(vfloat a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline vfmask vf_lt(vfloat a, vfloat b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+inline vfmask vf_gt(vfloat a, vfloat b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+inline vfloat vf_select(vfmask m, vfloat a, vfloat b) { return _mm512_mask_blend_ps(m, b, a); }
+
+inline void vf_widen(vfloat a, vdouble* lo, vdouble* hi) {
+    *lo = _mm512_cvtps_pd(_mm512_castps512_ps256(a));
+    *hi = _mm512_cvtps_pd(_mm512_extractf32x8_ps(a, 1));
+}
+
+inline vfloat vf_pow2i(vfloat n) { return _mm512_scalef_ps(_mm512_set1_ps(1.0f), n); }
+
+inline vfloat vf_frexp(vfloat x, vfloat* e) {
+    *e = _mm512_getexp_ps(x);
+    return _mm512_getmant_ps(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_src);
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+#define VF_LANES 8
+typedef __m256 vfloat;
+typedef __m256 vfmask;
+
+inline vfloat vf_set1(float x) { return _mm256_set1_ps(x); }
+inline vfloat vf_load(const float* p) { return _mm256_loadu_ps(p); }
+inline void vf_store(float* p, vfloat a) { _mm256_storeu_ps(p, a); }
+inline vfloat vf_add(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+inline vfloat vf_sub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+inline vfloat vf_mul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+inline vfloat vf_div(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+inline vfloat vf_fmadd(vfloat a, vfloat b, vfloat c) { return _mm256_fmadd_ps(a, b, c); }
+inline vfloat vf_fnmadd(vfloat a, vfloat b, vfloat c) { return _mm256_fnmadd_ps(a, b, c); }
+inline vfloat vf_sqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+inline vfloat vf_max(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+inline vfloat vf_min(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+inline vfloat vf_abs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+inline vfloat vf_round(vfloat a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline vfmask vf_lt(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline vfmask vf_gt(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+inline vfloat vf_select(vfmask m, vfloat a, vfloat b) { return _mm256_blendv_ps(b, a, m); }
+
+inline void vf_widen(vfloat a, vdouble* lo, vdouble* hi) {
+    *lo = _mm256_cvtps_pd(_mm256_castps256_ps128(a));
+    *hi = _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1));
+}
+
+// 2^n for integer-valued n in [-126, 127], built in the exponent field
+inline vfloat vf_pow2i(vfloat n) {
+    __m256i bits = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23));
+}
+
+inline vfloat vf_frexp(vfloat x, vfloat* e) {
+    __m256i bits = _mm256_castps_si256(x);
+    *e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256i mant = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                                   _mm256_set1_epi32(0x3F800000));
+    return _mm256_castsi256_ps(mant);
+}
+
+#else
+
+#define VF_LANES 4
+typedef __m128 vfloat;
+typedef __m128 vfmask;
+
+inline vfloat vf_set1(float x) { return _mm_set1_ps(x); }
+inline vfloat vf_load(const float* p) { return _mm_loadu_ps(p); }
+inline void vf_store(float* p, vfloat a) { _mm_storeu_ps(p, a); }
+inline vfloat vf_add(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+inline vfloat vf_sub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+inline vfloat vf_mul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+inline vfloat vf_div(vfloat a, vfloat b) { return _mm_div_ps(a, b); }
+inline vfloat vf_fmadd(vfloat a, vfloat b, vfloat c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline vfloat vf_fnmadd(vfloat a, vfloat b, vfloat c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+inline vfloat vf_sqrt(vfloat a) { return _mm_sqrt_ps(a); }
+inline vfloat vf_max(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+inline vfloat vf_min(vfloat a, vfloat b) { return _mm_min_ps(a, b); }
+inline vfloat vf_abs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline vfmask vf_lt(vfloat a, vfloat b) { return _mm_cmplt_ps(a, b); }
+inline vfmask vf_gt(vfloat a, vfloat b) { return _mm_cmpgt_ps(a, b); }
+inline vfloat vf_select(vfmask m, vfloat a, vfloat b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+// Round to nearest by adding and removing 1.5*2^23, valid for |a| < 2^22
+inline vfloat vf_round(vfloat a) {
+    const __m128 magic = _mm_set1_ps(12582912.0f);
+    return _mm_sub_ps(_mm_add_ps(a, magic), magic);
+}
+
+inline void vf_widen(vfloat a, vdouble* lo, vdouble* hi) {
+    *lo = _mm_cvtps_pd(a);
+    *hi = _mm_cvtps_pd(_mm_movehl_ps(a, a));
+}
+
+inline vfloat vf_pow2i(vfloat n) {
+    __m128i bits = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+    return _mm_castsi128_ps(_mm_slli_epi32(bits, 23));
+}
+
+inline vfloat vf_frexp(vfloat x, vfloat* e) {
+    __m128i bits = _mm_castps_si128(x);
+    *e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128i mant = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                                _mm_set1_epi32(0x3F800000));
+    return _mm_castsi128_ps(mant);
+}
+
+#endif
+
+// e^x in single precision, about 1 ulp on [-87, 88]
+inline vfloat vf_exp(vfloat x) {
+#if VF_LANES == 1
+    return std::exp(x);
+#else
+    x = vf_min(vf_max(x, vf_set1(-87.0f)), vf_set1(88.0f));
+    vfloat n = vf_round(vf_mul(x, vf_set1(1.44269504f)));
+    vfloat r = vf_fnmadd(n, vf_set1(0.693359375f), x);
+    r = vf_fnmadd(n, vf_set1(-2.12194440e-4f), r);
+
+    // Taylor series to r^7 for |r| <= ln(2)/2
+    vfloat p = vf_set1(1.0f / 5040.0f);
+    p = vf_fmadd(p, r, vf_set1(1.0f / 720.0f));
+    p = vf_fmadd(p, r, vf_set1(1.0f / 120.0f));
+    p = vf_fmadd(p, r, vf_set1(1.0f / 24.0f));
+    p = vf_fmadd(p, r, vf_set1(1.0f / 6.0f));
+    p = vf_fmadd(p, r, vf_set1(0.5f));
+    p = vf_fmadd(p, r, vf_set1(1.0f));
+    p = vf_fmadd(p, r, vf_set1(1.0f));
+    return vf_mul(p, vf_pow2i(n));
+#endif
+}
+
+// Natural log for positive normal x, single precision
+inline vfloat vf_log(vfloat x) {
+#if VF_LANES == 1
+    return std::log(x);
+#else
+    vfloat e;
+    vfloat m = vf_frexp(x, &e);
+    vfmask big = vf_gt(m, vf_set1(1.41421356f));
+    m = vf_select(big, vf_mul(m, vf_set1(0.5f)), m);
+    e = vf_select(big, vf_add(e, vf_set1(1.0f)), e);
+
+    vfloat s = vf_div(vf_sub(m, vf_set1(1.0f)), vf_add(m, vf_set1(1.0f)));
+    vfloat s2 = vf_mul(s, s);
+    vfloat p = vf_set1(1.0f / 9.0f);
+    p = vf_fmadd(p, s2, vf_set1(1.0f / 7.0f));
+    p = vf_fmadd(p, s2, vf_set1(1.0f / 5.0f));
+    p = vf_fmadd(p, s2, vf_set1(1.0f / 3.0f));
+    vfloat logm = vf_fmadd(vf_mul(vf_add(s, s), s2), p, vf_add(s, s));
+    logm = vf_fmadd(e, vf_set1(-2.12194440e-4f), logm);
+    return vf_fmadd(e, vf_set1(0.693359375f), logm);
+#endif
+}
+
+// sin(2 pi u) and cos(2 pi u) for u in [0, 1], as vd_sincos_2pi
+inline void vf_sincos_2pi(vfloat u, vfloat* s, vfloat* c) {
+    vfloat q = vf_round(vf_mul(u, vf_set1(4.0f)));
+    vfloat x = vf_mul(vf_fnmadd(q, vf_set1(0.25f), u), vf_set1(6.28318531f));
+    vfloat x2 = vf_mul(x, x);
+
+    vfloat sp = vf_set1(1.0f / 362880.0f);
+    sp = vf_fmadd(sp, x2, vf_set1(-1.0f / 5040.0f));
+    sp = vf_fmadd(sp, x2, vf_set1(1.0f / 120.0f));
+    sp = vf_fmadd(sp, x2, vf_set1(-1.0f / 6.0f));
+    vfloat sx = vf_fmadd(vf_mul(sp, x2), x, x);
+
+    vfloat cp = vf_set1(-1.0f / 3628800.0f);
+    cp = vf_fmadd(cp, x2, vf_set1(1.0f / 40320.0f));
+    cp = vf_fmadd(cp, x2, vf_set1(-1.0f / 720.0f));
+    cp = vf_fmadd(cp, x2, vf_set1(1.0f / 24.0f));
+    cp = vf_fmadd(cp, x2, vf_set1(-0.5f));
+    vfloat cx = vf_fmadd(cp, x2, vf_set1(1.0f));
+
+    q = vf_select(vf_gt(q, vf_set1(3.5f)), vf_sub(q, vf_set1(4.0f)), q);
+    vfloat half = vf_mul(q, vf_set1(0.5f));
+    vfmask odd = vf_gt(vf_abs(vf_sub(half, vf_round(half))), vf_set1(0.25f));
+    vfloat sr = vf_select(odd, cx, sx);
+    vfloat cr = vf_select(odd, sx, cx);
+    vfloat zero = vf_set1(0.0f);
+    *s = vf_select(vf_gt(q, vf_set1(1.5f)), vf_sub(zero, sr), sr);
+    *c = vf_select(vf_lt(vf_abs(vf_sub(q, vf_set1(1.5f))), vf_set1(1.0f)), vf_sub(zero, cr), cr);
+}
+
+} // namespace VD_NAMESPACE
+
+using namespace VD_NAMESPACE;
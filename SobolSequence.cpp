@@ -0,0 +1,129 @@
+#include "SobolSequence.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+#include "SobolDirections.inc"
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Nested uniform (Owen) scramble: a hash that only mixes bits towards the
+// high end acts on the bit-reversed value, so each output digit depends on
+// the digits above it, as Owen's tree of random permutations requires
+inline uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return reverse_bits(x);
+}
+
+// Per-dimension scramble seed, splitmix64 finalizer over (seed, dimension)
+inline uint32_t dimension_seed(uint64_t seed, int dimension) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull * (static_cast<uint64_t>(dimension) + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>(z ^ (z >> 31));
+}
+
+} // namespace
+
+SobolSequence::SobolSequence(int dimensions)
+    : dimensions_(dimensions), directions_(static_cast<size_t>(dimensions) * kBits) {
+    if (dimensions < 1 || dimensions > kMaxDimension) {
+        throw std::invalid_argument("SobolSequence: dimension count must be in [1, 1024]");
+    }
+
+    // Dimension 0 is the van der Corput sequence
+    for (int k = 0; k < kBits; ++k) {
+        directions_[k] = 1u << (kBits - 1 - k);
+    }
+
+    // Remaining dimensions follow the Bratley-Fox recurrence on m_k
+    size_t offset = 0;
+    for (int d = 1; d < dimensions; ++d) {
+        uint32_t poly = kSobolPolynomials[d - 1];
+        int degree = 0;
+        while ((poly >> (degree + 1)) != 0) {
+            ++degree;
+        }
+
+        uint32_t m[kBits];
+        for (int k = 0; k < degree; ++k) {
+            m[k] = kSobolInitial[offset + k];
+        }
+        offset += degree;
+        for (int k = degree; k < kBits; ++k) {
+            m[k] = m[k - degree];
+            uint32_t coeffs = poly;
+            for (int i = 0; i < degree; ++i, coeffs >>= 1) {
+                int shift = degree - i;
+                m[k] ^= ((coeffs & 1u) * m[k - shift]) << shift;
+            }
+        }
+
+        uint32_t* v = &directions_[static_cast<size_t>(d) * kBits];
+        for (int k = 0; k < kBits; ++k) {
+            v[k] = m[k] << (kBits - 1 - k);
+        }
+    }
+}
+
+void SobolSequence::uniforms(uint64_t scramble_seed, uint32_t first, size_t count, double* out) const {
+    if (count == 0) {
+        return;
+    }
+    std::vector<uint32_t> x(count);
+    for (int d = 0; d < dimensions_; ++d) {
+        const uint32_t* v = &directions_[static_cast<size_t>(d) * kBits];
+
+        // Jump straight to the first point's Gray code, then flip one
+        // direction number per step
+        uint32_t gray = first ^ (first >> 1);
+        uint32_t point = 0;
+        for (int k = 0; gray != 0; ++k, gray >>= 1) {
+            if (gray & 1u) {
+                point ^= v[k];
+            }
+        }
+        x[0] = point;
+        for (size_t j = 1; j < count; ++j) {
+            point ^= v[__builtin_ctz(static_cast<uint32_t>(first + j))];
+            x[j] = point;
+        }
+
+        // Independent loop over the block so the scramble vectorizes
+        uint32_t seed = dimension_seed(scramble_seed, d);
+        double* row = out + static_cast<size_t>(d) * count;
+        for (size_t j = 0; j < count; ++j) {
+            row[j] = (static_cast<double>(owen_scramble(x[j], seed)) + 0.5) * (1.0 / 4294967296.0);
+        }
+    }
+}
+
+void SobolSequence::normals(uint64_t scramble_seed, uint32_t first, size_t count, double* out) const {
+    uniforms(scramble_seed, first, count, out);
+    size_t total = static_cast<size_t>(dimensions_) * count;
+    size_t i = 0;
+    for (; i + VD_LANES <= total; i += VD_LANES) {
+        vd_store(out + i, vd_inv_norm_cdf(vd_load(out + i)));
+    }
+    if (i < total) {
+        double tail[VD_LANES];
+        for (int j = 0; j < VD_LANES; ++j) {
+            tail[j] = i + j < total ? out[i + j] : 0.5;
+        }
+        vd_store(tail, vd_inv_norm_cdf(vd_load(tail)));
+        std::copy(tail, tail + (total - i), out + i);
+    }
+}
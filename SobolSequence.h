@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sobol low-discrepancy points with Joe-Kuo direction numbers and
+// hash-based Owen scrambling (Burley 2020). Points are indexed in Gray-code
+// order, so any block [first, first + count) can be generated independently
+// and blocks can be handed to threads in any order.
+class SobolSequence {
+public:
+    static constexpr int kMaxDimension = 1024;
+
+    explicit SobolSequence(int dimensions);
+
+    int dimensions() const { return dimensions_; }
+
+    // Scrambled uniforms in (0, 1): out[d * count + j] is dimension d of
+    // point first + j. Each scramble_seed gives an independent randomized
+    // replicate of the same point set.
+    void uniforms(uint64_t scramble_seed, uint32_t first, size_t count, double* out) const;
+
+    // As uniforms, mapped through the inverse normal CDF
+    void normals(uint64_t scramble_seed, uint32_t first, size_t count, double* out) const;
+
+private:
+    static constexpr int kBits = 32;
+
+    int dimensions_;
+    std::vector<uint32_t> directions_;   // [dimension][bit]
+};
@@ -0,0 +1,368 @@
+#include "VolSurface.h"
+#include "SimdMath.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Lookup bins per grid cell; more bins mean fewer steps after the lookup
+// on irregular grids
+const size_t kBinsPerCell = 4;
+
+// Floor for local variance where the Dupire ratio is not meaningful
+// (calendar or butterfly arbitrage in the input grid)
+const double kMinLocalVariance = 1e-8;
+
+inline double hermite(const double* c, double t) {
+    return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+}
+
+bool strictly_increasing_positive(const std::vector<double>& x) {
+    if (x.empty() || !(x[0] > 0)) {
+        return false;
+    }
+    for (size_t i = 1; i < x.size(); ++i) {
+        if (!(x[i] > x[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+double SviSlice::total_variance(double k) const {
+    double d = k - m;
+    return a + b * (rho * d + std::sqrt(d * d + sigma * sigma));
+}
+
+void VolSurface::AxisIndex::build(const std::vector<double>& x) {
+    origin = x.front();
+    bins.clear();
+    if (x.size() < 2) {
+        return;
+    }
+    const size_t nbins = (x.size() - 1) * kBinsPerCell;
+    inv_width = nbins / (x.back() - x.front());
+    bins.assign(nbins, 0);
+    size_t i = 0;
+    for (size_t b = 0; b < nbins; ++b) {
+        double start = origin + b / inv_width;
+        while (i + 2 < x.size() && x[i + 1] <= start) {
+            ++i;
+        }
+        bins[b] = static_cast<unsigned>(i);
+    }
+}
+
+size_t VolSurface::AxisIndex::locate(const std::vector<double>& x, double v) const {
+    if (x.size() < 2 || v <= origin) {
+        return 0;
+    }
+    double pos = (v - origin) * inv_width;
+    if (pos >= bins.size()) {
+        return x.size() - 2;
+    }
+    size_t i = bins[static_cast<size_t>(pos)];
+    while (i + 2 < x.size() && x[i + 1] <= v) {
+        ++i;
+    }
+    return i;
+}
+
+VolSurface::VolSurface(std::vector<double> strikes, std::vector<double> maturities,
+                       const std::vector<double>& vols, Interpolation interpolation)
+    : strikes_(std::move(strikes)), maturities_(std::move(maturities)),
+      interpolation_(interpolation) {
+    if (strikes_.size() < 2 || !strictly_increasing_positive(strikes_)) {
+        throw std::invalid_argument("VolSurface: need at least two increasing positive strikes");
+    }
+    if (!strictly_increasing_positive(maturities_)) {
+        throw std::invalid_argument("VolSurface: maturities must be increasing and positive");
+    }
+    const size_t nk = strikes_.size();
+    const size_t nt = maturities_.size();
+    if (vols.size() != nk * nt) {
+        throw std::invalid_argument("VolSurface: need one vol per strike and maturity");
+    }
+
+    log_strikes_.resize(nk);
+    for (size_t i = 0; i < nk; ++i) {
+        log_strikes_[i] = std::log(strikes_[i]);
+    }
+    variance_.resize(nk * nt);
+    coeffs_.resize(nt * (nk - 1) * 4);
+    strike_index_.build(log_strikes_);
+    maturity_index_.build(maturities_);
+    for (size_t j = 0; j < nt; ++j) {
+        for (size_t i = 0; i < nk; ++i) {
+            variance_[j * nk + i] = vols[j * nk + i] * vols[j * nk + i] * maturities_[j];
+        }
+        rebuild_cells(j, 0, nk - 1);
+    }
+}
+
+double VolSurface::node_vol(size_t maturity, size_t strike) const {
+    return std::sqrt(variance_[maturity * strikes_.size() + strike] / maturities_[maturity]);
+}
+
+void VolSurface::rebuild_cells(size_t j, size_t first_cell, size_t end_cell) {
+    const size_t nk = strikes_.size();
+    for (size_t i = first_cell; i < end_cell; ++i) {
+        cell_coeffs(&variance_[j * nk], i, &coeffs_[(j * (nk - 1) + i) * 4]);
+    }
+}
+
+void VolSurface::cell_coeffs(const double* w, size_t i, double* c) const {
+    const size_t nk = strikes_.size();
+    const double* x = log_strikes_.data();
+
+    // Slope at node i from its neighbours, one-sided at the ends
+    auto slope = [&](size_t n) {
+        if (n == 0) {
+            return (w[1] - w[0]) / (x[1] - x[0]);
+        }
+        if (n == nk - 1) {
+            return (w[nk - 1] - w[nk - 2]) / (x[nk - 1] - x[nk - 2]);
+        }
+        double hl = x[n] - x[n - 1];
+        double hr = x[n + 1] - x[n];
+        double dl = (w[n] - w[n - 1]) / hl;
+        double dr = (w[n + 1] - w[n]) / hr;
+        return (hr * dl + hl * dr) / (hl + hr);
+    };
+
+    double dw = w[i + 1] - w[i];
+    c[0] = w[i];
+    if (interpolation_ == Interpolation::Bilinear) {
+        c[1] = dw;
+        c[2] = 0.0;
+        c[3] = 0.0;
+    } else {
+        double h = x[i + 1] - x[i];
+        double m0 = h * slope(i);
+        double m1 = h * slope(i + 1);
+        c[1] = m0;
+        c[2] = 3 * dw - 2 * m0 - m1;
+        c[3] = -2 * dw + m0 + m1;
+    }
+}
+
+double VolSurface::row_variance(size_t j, double x, double* dw, double* d2w) const {
+    const size_t nk = strikes_.size();
+    bool inside = x > log_strikes_.front() && x < log_strikes_.back();
+    x = std::min(std::max(x, log_strikes_.front()), log_strikes_.back());
+    size_t i = strike_index_.locate(log_strikes_, x);
+    double h = log_strikes_[i + 1] - log_strikes_[i];
+    double t = (x - log_strikes_[i]) / h;
+    const double* c = &coeffs_[(j * (nk - 1) + i) * 4];
+    if (dw) {
+        // Flat extrapolation has no slope
+        *dw = inside ? (c[1] + t * (2 * c[2] + 3 * t * c[3])) / h : 0.0;
+        *d2w = inside ? (2 * c[2] + 6 * t * c[3]) / (h * h) : 0.0;
+    }
+    return hermite(c, t);
+}
+
+double VolSurface::total_variance(double K, double T) const {
+    double v = vol(K, T);
+    return v * v * T;
+}
+
+double VolSurface::vol(double K, double T) const {
+    double out;
+    vol(&K, &T, &out, 1);
+    return out;
+}
+
+void VolSurface::vol(const double* K, const double* T, double* out, size_t n) const {
+    const size_t nk = strikes_.size();
+    const size_t nt = maturities_.size();
+    const double xlo = log_strikes_.front();
+    const double xhi = log_strikes_.back();
+
+    // Cell lookups are scalar; the lanes then evaluate both bracketing rows
+    // and blend them in vector registers
+    double t[VD_LANES], alpha[VD_LANES], beta[VD_LANES];
+    double ca[4][VD_LANES], cb[4][VD_LANES];
+    double vol_out[VD_LANES];
+    for (size_t base = 0; base < n; base += VD_LANES) {
+        size_t lanes = std::min(static_cast<size_t>(VD_LANES), n - base);
+        double logK[VD_LANES];
+        for (size_t l = 0; l < VD_LANES; ++l) {
+            logK[l] = K[base + std::min(l, lanes - 1)];
+        }
+        vd_store(logK, vd_min(vd_max(vd_log(vd_load(logK)), vd_set1(xlo)), vd_set1(xhi)));
+        for (size_t l = 0; l < VD_LANES; ++l) {
+            size_t q = base + std::min(l, lanes - 1);
+            double x = logK[l];
+            size_t i = strike_index_.locate(log_strikes_, x);
+            t[l] = (x - log_strikes_[i]) / (log_strikes_[i + 1] - log_strikes_[i]);
+
+            // vol^2 = alpha w_j0 + beta w_j1
+            double Tq = T[q];
+            size_t j0, j1;
+            if (nt == 1 || Tq <= maturities_.front()) {
+                j0 = j1 = 0;
+                alpha[l] = 1.0 / maturities_.front();
+                beta[l] = 0.0;
+            } else if (Tq >= maturities_.back()) {
+                j0 = j1 = nt - 1;
+                alpha[l] = 1.0 / maturities_.back();
+                beta[l] = 0.0;
+            } else {
+                j0 = maturity_index_.locate(maturities_, Tq);
+                j1 = j0 + 1;
+                double lambda = (Tq - maturities_[j0]) / (maturities_[j1] - maturities_[j0]);
+                alpha[l] = (1 - lambda) / Tq;
+                beta[l] = lambda / Tq;
+            }
+            const double* c0 = &coeffs_[(j0 * (nk - 1) + i) * 4];
+            const double* c1 = &coeffs_[(j1 * (nk - 1) + i) * 4];
+            for (int k = 0; k < 4; ++k) {
+                ca[k][l] = c0[k];
+                cb[k][l] = c1[k];
+            }
+        }
+
+        vdouble _t = vd_load(t);
+        vdouble _wa = vd_fmadd(vd_fmadd(vd_fmadd(vd_load(ca[3]), _t, vd_load(ca[2])), _t, vd_load(ca[1])),
+                               _t, vd_load(ca[0]));
+        vdouble _wb = vd_fmadd(vd_fmadd(vd_fmadd(vd_load(cb[3]), _t, vd_load(cb[2])), _t, vd_load(cb[1])),
+                               _t, vd_load(cb[0]));
+        vdouble _var = vd_fmadd(vd_load(alpha), _wa, vd_mul(vd_load(beta), _wb));
+        vd_store(vol_out, vd_sqrt(vd_max(_var, vd_set1(0.0))));
+        std::copy(vol_out, vol_out + lanes, out + base);
+    }
+}
+
+void VolSurface::vol_gradient(double K, double T, std::vector<double>& grad) const {
+    const size_t nk = strikes_.size();
+    const size_t nt = maturities_.size();
+    grad.assign(nk * nt, 0.0);
+    double v = vol(K, T);
+    if (!(v > 0)) {
+        return;
+    }
+
+    // vol^2 = alpha w_j0(x) + beta w_j1(x), as in vol(); each row's value is
+    // linear in its node variances, so a unit row gives each weight
+    double x = std::min(std::max(std::log(K), log_strikes_.front()), log_strikes_.back());
+    size_t i = strike_index_.locate(log_strikes_, x);
+    double t = (x - log_strikes_[i]) / (log_strikes_[i + 1] - log_strikes_[i]);
+    size_t j0, j1;
+    double alpha, beta;
+    if (nt == 1 || T <= maturities_.front()) {
+        j0 = j1 = 0;
+        alpha = 1.0 / maturities_.front();
+        beta = 0.0;
+    } else if (T >= maturities_.back()) {
+        j0 = j1 = nt - 1;
+        alpha = 1.0 / maturities_.back();
+        beta = 0.0;
+    } else {
+        j0 = maturity_index_.locate(maturities_, T);
+        j1 = j0 + 1;
+        double lambda = (T - maturities_[j0]) / (maturities_[j1] - maturities_[j0]);
+        alpha = (1 - lambda) / T;
+        beta = lambda / T;
+    }
+
+    // A cell reads at most the nodes i - 1 .. i + 2
+    std::vector<double> unit(nk, 0.0);
+    size_t first = i > 0 ? i - 1 : 0;
+    size_t last = std::min(i + 2, nk - 1);
+    for (size_t n = first; n <= last; ++n) {
+        unit[n] = 1.0;
+        double c[4];
+        cell_coeffs(unit.data(), i, c);
+        double weight = hermite(c, t);
+        unit[n] = 0.0;
+
+        // dvol / dw = weight * (alpha or beta) / (2 vol), dw / dvol_node = 2 vol_node T_j
+        const size_t rows[] = {j0, j1};
+        const double scales[] = {alpha, beta};
+        for (int r = 0; r < 2; ++r) {
+            if (scales[r] == 0.0) {
+                continue;
+            }
+            size_t j = rows[r];
+            grad[j * nk + n] += weight * scales[r] / (2 * v) * 2 * node_vol(j, n) * maturities_[j];
+        }
+    }
+}
+
+double VolSurface::local_vol(double K, double T, double S0, double r) const {
+    const size_t nt = maturities_.size();
+    const double x = std::log(K);
+    T = std::max(T, 1e-6);
+
+    // Total variance at (x, T), its x derivatives, and dw/dT at fixed K
+    double w, wx, wxx, wT;
+    if (nt == 1 || T <= maturities_.front() || T >= maturities_.back()) {
+        size_t j = (nt == 1 || T <= maturities_.front()) ? 0 : nt - 1;
+        double wj = row_variance(j, x, &wx, &wxx);
+        double scale = T / maturities_[j];
+        w = wj * scale;
+        wx *= scale;
+        wxx *= scale;
+        wT = wj / maturities_[j];
+    } else {
+        size_t j = maturity_index_.locate(maturities_, T);
+        double dT = maturities_[j + 1] - maturities_[j];
+        double lambda = (T - maturities_[j]) / dT;
+        double wx0, wxx0, wx1, wxx1;
+        double w0 = row_variance(j, x, &wx0, &wxx0);
+        double w1 = row_variance(j + 1, x, &wx1, &wxx1);
+        w = (1 - lambda) * w0 + lambda * w1;
+        wx = (1 - lambda) * wx0 + lambda * wx1;
+        wxx = (1 - lambda) * wxx0 + lambda * wxx1;
+        wT = (w1 - w0) / dT;
+    }
+
+    // Dupire in log-moneyness y = log(K / F(T)); at fixed y the strike
+    // drifts with the forward, so dw/dT|y = dw/dT|K + r dw/dx
+    double y = x - std::log(S0) - r * T;
+    double wTy = wT + r * wx;
+    double den = 1 - y / w * wx + 0.25 * (-0.25 - 1 / w + y * y / (w * w)) * wx * wx + 0.5 * wxx;
+    double var = den > 0 ? wTy / den : 0.0;
+    return std::sqrt(std::max(var, kMinLocalVariance));
+}
+
+void VolSurface::update(size_t maturity, size_t strike, size_t rows, size_t cols, const double* vols) {
+    const size_t nk = strikes_.size();
+    if (maturity + rows > maturities_.size() || strike + cols > nk) {
+        throw std::invalid_argument("VolSurface::update: block outside the grid");
+    }
+    if (rows == 0 || cols == 0) {
+        return;
+    }
+    for (size_t r = 0; r < rows; ++r) {
+        size_t j = maturity + r;
+        for (size_t c = 0; c < cols; ++c) {
+            double v = vols[r * cols + c];
+            variance_[j * nk + strike + c] = v * v * maturities_[j];
+        }
+    }
+
+    // A node feeds its own two cells; with cubic interpolation its slope
+    // also reaches one cell further on each side
+    size_t reach = interpolation_ == Interpolation::Cubic ? 2 : 1;
+    size_t first_cell = strike >= reach ? strike - reach : 0;
+    size_t end_cell = std::min(strike + cols + reach - 1, nk - 1);
+    for (size_t r = 0; r < rows; ++r) {
+        rebuild_cells(maturity + r, first_cell, end_cell);
+    }
+}
+
+void VolSurface::set_svi_slice(size_t maturity, const SviSlice& slice, double forward) {
+    const size_t nk = strikes_.size();
+    if (maturity >= maturities_.size()) {
+        throw std::invalid_argument("VolSurface::set_svi_slice: maturity index outside the grid");
+    }
+    for (size_t i = 0; i < nk; ++i) {
+        variance_[maturity * nk + i] = std::max(slice.total_variance(std::log(strikes_[i] / forward)), 0.0);
+    }
+    rebuild_cells(maturity, 0, nk - 1);
+}
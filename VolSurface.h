@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Minimal 64-byte aligned allocator so grid rows and coefficient blocks
+// start on cache-line boundaries
+template <typename T>
+struct CacheAlignedAllocator {
+    typedef T value_type;
+    CacheAlignedAllocator() = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        size_t bytes = (n * sizeof(T) + 63) / 64 * 64;
+        void* p = std::aligned_alloc(64, bytes == 0 ? 64 : bytes);
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t) { std::free(p); }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+// Raw SVI total variance slice: w(k) = a + b (rho (k - m) + sqrt((k - m)^2 + sigma^2))
+// in log-moneyness k = log(K / F)
+struct SviSlice {
+    double a;
+    double b;
+    double rho;
+    double m;
+    double sigma;
+
+    double total_variance(double k) const;
+};
+
+// Implied volatility surface on a strike x maturity grid, independent of
+// any GUI. Nodes hold total variance w = vol^2 T; between strikes w is
+// interpolated in log-strike (linearly, or by local cubic Hermite), between
+// maturities linearly in w, which keeps calendar spreads consistent.
+// Outside the grid vol is held flat. Interpolation coefficients are
+// precomputed per cell in one flat aligned array, and cells are located
+// through uniform lookup tables, so a query costs O(1).
+class VolSurface {
+public:
+    enum class Interpolation {
+        Bilinear,   // linear in log-strike
+        Cubic       // local cubic Hermite in log-strike
+    };
+
+    // vols is maturities x strikes, row-major: vols[j * strikes.size() + i]
+    // is the vol at strikes[i], maturities[j]. Both axes must be strictly
+    // increasing and positive with at least two strikes; throws
+    // std::invalid_argument otherwise.
+    VolSurface(std::vector<double> strikes, std::vector<double> maturities,
+               const std::vector<double>& vols, Interpolation interpolation = Interpolation::Bilinear);
+
+    size_t num_strikes() const { return strikes_.size(); }
+    size_t num_maturities() const { return maturities_.size(); }
+    const std::vector<double>& strikes() const { return strikes_; }
+    const std::vector<double>& maturities() const { return maturities_; }
+    double node_vol(size_t maturity, size_t strike) const;
+
+    double total_variance(double K, double T) const;
+    double vol(double K, double T) const;
+
+    // Batched lookup, vectorized over queries: out[i] = vol(K[i], T[i])
+    void vol(const double* K, const double* T, double* out, size_t n) const;
+
+    // Derivatives of vol(K, T) in every node vol, in the layout of the
+    // constructor's vols; only the nodes of the bracketing cells (and, for
+    // Cubic, their neighbours) are non-zero. grad is resized to fit.
+    void vol_gradient(double K, double T, std::vector<double>& grad) const;
+
+    // Dupire local volatility at spot level K and time T for a spot S0 and
+    // rate r, from the interpolated total variance and its derivatives.
+    // Bilinear rows have no curvature between nodes, so use Cubic here.
+    double local_vol(double K, double T, double S0, double r) const;
+
+    // Replaces the rows x cols block of node vols starting at (maturity,
+    // strike), row-major in vols, and recomputes only the coefficients of
+    // the cells the change reaches
+    void update(size_t maturity, size_t strike, size_t rows, size_t cols, const double* vols);
+
+    // Fills maturity row j from an SVI slice around forward F
+    void set_svi_slice(size_t maturity, const SviSlice& slice, double forward);
+
+private:
+    // O(1) bracket lookup on a strictly increasing axis: bins of a uniform
+    // grid over the axis point to the node at or below their start
+    struct AxisIndex {
+        void build(const std::vector<double>& x);
+        // i with x[i] <= v < x[i+1], clamped to [0, x.size() - 2]
+        size_t locate(const std::vector<double>& x, double v) const;
+
+        double origin = 0.0;
+        double inv_width = 0.0;
+        std::vector<unsigned> bins;
+    };
+
+    // Total variance of maturity row j at log-strike x, with optional
+    // derivatives in x
+    double row_variance(size_t j, double x, double* dw = nullptr, double* d2w = nullptr) const;
+    void rebuild_cells(size_t j, size_t first_cell, size_t end_cell);
+
+    // Coefficients of cell i of a row of total variances w
+    void cell_coeffs(const double* w, size_t i, double* c) const;
+
+    std::vector<double> strikes_;
+    std::vector<double> maturities_;
+    std::vector<double> log_strikes_;
+    Interpolation interpolation_;
+    std::vector<double, CacheAlignedAllocator<double>> variance_;   // [maturity][strike]
+    std::vector<double, CacheAlignedAllocator<double>> coeffs_;     // [maturity][cell][4]
+    AxisIndex strike_index_;
+    AxisIndex maturity_index_;
+};
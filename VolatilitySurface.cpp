@@ -1,4 +1,5 @@
-#include "volatility_surface.h"
+#include "VolatilitySurface.h"
+#include "VolSurface.h"
 #include <GL/gl.h>
 #include <GL/glu.h>
 #include <cmath>
@@ -14,37 +15,26 @@ VolatilitySurfacePanel::VolatilitySurfacePanel(wxWindow* parent)
     Bind(wxEVT_MOUSEWHEEL, &VolatilitySurfacePanel::OnMouseWheel, this);
 }
 
-void VolatilitySurfacePanel::UpdateSurface(double S, double K, double T, double v) {
-    strikes_ = GenerateRange(K * 0.7f, K * 1.3f, 20);
-    maturities_ = GenerateRange(T * 0.5f, T * 1.5f, 20);
-    vols_ = GenerateVolSurface(strikes_, maturities_, S, K, T, v);
+void VolatilitySurfacePanel::UpdateSurface(std::vector<float> strikes, std::vector<float> maturities,
+                                           std::vector<std::vector<float>> vols) {
+    strikes_ = std::move(strikes);
+    maturities_ = std::move(maturities);
+    vols_ = std::move(vols);
     Refresh();
 }
 
-std::vector<float> VolatilitySurfacePanel::GenerateRange(float start, float end, size_t points) {
-    std::vector<float> range(points);
-    float step = (end - start) / (points - 1);
-    std::generate(range.begin(), range.end(), 
-        [=, n = 0]() mutable { return start + (n++) * step; });
-    return range;
-}
-
-std::vector<std::vector<float>> VolatilitySurfacePanel::GenerateVolSurface(
-    const std::vector<float>& strikes,
-    const std::vector<float>& maturities,
-    double S, double K, double T, double v) {
-    
-    std::vector<std::vector<float>> surface(strikes.size(), 
-        std::vector<float>(maturities.size()));
-        
-    for (size_t i = 0; i < strikes.size(); ++i) {
-        for (size_t j = 0; j < maturities.size(); ++j) {
-            float moneyness = std::log(strikes[i] / S);
-            float timeEffect = std::sqrt(maturities[j] / T);
-            surface[i][j] = v * (1.0f + 0.2f * moneyness * moneyness) * timeEffect;
+void VolatilitySurfacePanel::UpdateSurface(const VolSurface& surface) {
+    const size_t nk = surface.num_strikes();
+    const size_t nt = surface.num_maturities();
+    std::vector<float> strikes(surface.strikes().begin(), surface.strikes().end());
+    std::vector<float> maturities(surface.maturities().begin(), surface.maturities().end());
+    std::vector<std::vector<float>> vols(nk, std::vector<float>(nt));
+    for (size_t i = 0; i < nk; ++i) {
+        for (size_t j = 0; j < nt; ++j) {
+            vols[i][j] = static_cast<float>(surface.node_vol(j, i));
         }
     }
-    return surface;
+    UpdateSurface(std::move(strikes), std::move(maturities), std::move(vols));
 }
 
 void VolatilitySurfacePanel::OnPaint(wxPaintEvent&) {
@@ -62,7 +52,7 @@ void VolatilitySurfacePanel::OnPaint(wxPaintEvent&) {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
     // Draw surface
-    for (size_t i = 0; i < strikes_.size() - 1; ++i) {
+    for (size_t i = 0; i + 1 < strikes_.size(); ++i) {
         glBegin(GL_TRIANGLE_STRIP);
         for (size_t j = 0; j < maturities_.size(); ++j) {
             float x1 = 2.0f * i / strikes_.size() - 1.0f;
@@ -90,3 +80,23 @@ void VolatilitySurfacePanel::OnPaint(wxPaintEvent&) {
     glEnd();
     
     glFlush();
+    SwapBuffers();
+}
+
+void VolatilitySurfacePanel::OnSize(wxSizeEvent& evt) {
+    if (IsShownOnScreen()) {
+        SetCurrent(*context_);
+        wxSize size = GetClientSize();
+        glViewport(0, 0, size.x, size.y);
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        gluPerspective(45.0, size.y > 0 ? static_cast<double>(size.x) / size.y : 1.0, 0.1, 100.0);
+        glMatrixMode(GL_MODELVIEW);
+    }
+    evt.Skip();
+}
+
+void VolatilitySurfacePanel::OnMouseWheel(wxMouseEvent& evt) {
+    rotation_ += evt.GetWheelRotation() > 0 ? 5.0f : -5.0f;
+    Refresh();
+}
@@ -3,10 +3,18 @@
 #include <memory>
 #include <vector>
 
+class VolSurface;
+
 class VolatilitySurfacePanel : public wxGLCanvas {
 public:
     explicit VolatilitySurfacePanel(wxWindow* parent);
-    void UpdateSurface(double S, double K, double T, double v);
+
+    // Shows vols[i][j], the implied vol at strikes[i] and maturities[j]
+    void UpdateSurface(std::vector<float> strikes, std::vector<float> maturities,
+                       std::vector<std::vector<float>> vols);
+
+    // Shows the node vols of a surface
+    void UpdateSurface(const VolSurface& surface);
 
 private:
     std::unique_ptr<wxGLContext> context_;
@@ -18,10 +26,4 @@ private:
     void OnPaint(wxPaintEvent& evt);
     void OnSize(wxSizeEvent& evt);
     void OnMouseWheel(wxMouseEvent& evt);
-    
-    std::vector<float> GenerateRange(float start, float end, size_t points);
-    std::vector<std::vector<float>> GenerateVolSurface(
-        const std::vector<float>& strikes,
-        const std::vector<float>& maturities,
-        double S, double K, double T, double v);
 };
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Headless batch pricer build script (no wxWidgets)
+
+COMPILER=g++
+STD_VERSION=c++17
+OPTIMIZATION_FLAGS="-O3 -march=native -fopenmp"
+
+echo "Compiling..."
+$COMPILER -std=$STD_VERSION $OPTIMIZATION_FLAGS \
+    PricerCli.cpp Portfolio.cpp FinanceMonteCarlo.cpp McProfile.cpp BlackScholesBatch.cpp CounterRng.cpp \
+    SobolSequence.cpp ImpliedVolatility.cpp VolSurface.cpp PricingService.cpp ShardedMonteCarlo.cpp \
+    PathMonteCarlo.cpp AmericanMonteCarlo.cpp BrownianBridge.cpp CrankNicolson.cpp \
+    SimdKernels.cpp SimdKernelsScalar.cpp SimdKernelsSse2.cpp SimdKernelsAvx2.cpp SimdKernelsAvx512.cpp \
+    -o mc_pricer
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed. Please check the error messages above."
+    exit 1
+fi
+echo "Compilation successful! Run ./mc_pricer <portfolio> <output>"
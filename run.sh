@@ -5,12 +5,17 @@
 COMPILER=g++
 STD_VERSION=c++17
 WXCONFIG=wx-config
-OPTIMIZATION_FLAGS="-O3 -fopenmp"
+OPTIMIZATION_FLAGS="-O3 -march=native -fopenmp"
 
 # Compile the code
 echo "Compiling..."
 $COMPILER -std=$STD_VERSION $OPTIMIZATION_FLAGS \
-    MonteCarloGUI.cpp FinanceMonteCarlo.cpp \
+    main.cpp MonteCarloFrame.cpp VolatilitySurface.cpp \
+    FinanceMonteCarlo.cpp McProfile.cpp BlackScholesBatch.cpp CounterRng.cpp \
+    SobolSequence.cpp BrownianBridge.cpp PathMonteCarlo.cpp BumpMonteCarlo.cpp AadTape.cpp AadMonteCarlo.cpp \
+    CrankNicolson.cpp BasketMonteCarlo.cpp HestonMonteCarlo.cpp ImpliedVolatility.cpp VolSurface.cpp \
+    LocalVolMonteCarlo.cpp ScenarioEngine.cpp SimdKernels.cpp SimdKernelsScalar.cpp SimdKernelsSse2.cpp \
+    SimdKernelsAvx2.cpp SimdKernelsAvx512.cpp \
     `$WXCONFIG --cxxflags --libs` \
     -o MonteCarloGUI
 